@@ -0,0 +1,47 @@
+#include "arena.h"
+
+#include <algorithm>
+
+Arena::Arena(Arena&& other) noexcept
+    : head(std::exchange(other.head, nullptr)), cursor(std::exchange(other.cursor, nullptr)),
+      limit(std::exchange(other.limit, nullptr)), nextBlockSize(other.nextBlockSize),
+      blocks(std::exchange(other.blocks, 0)), reserved(std::exchange(other.reserved, 0)) {
+}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        release();
+        head = std::exchange(other.head, nullptr);
+        cursor = std::exchange(other.cursor, nullptr);
+        limit = std::exchange(other.limit, nullptr);
+        nextBlockSize = other.nextBlockSize;
+        blocks = std::exchange(other.blocks, 0);
+        reserved = std::exchange(other.reserved, 0);
+    }
+    return *this;
+}
+
+void Arena::grow(const size_t minimum) {
+    // blocks double in size, so a tree of n bytes takes O(log n) heap allocations
+    const size_t capacity = std::max(nextBlockSize, minimum);
+    nextBlockSize = std::max(nextBlockSize, capacity) * 2;
+
+    auto* block = static_cast<Block*>(::operator new(sizeof(Block) + capacity));
+    block->next = head;
+    block->capacity = capacity;
+    head = block;
+    cursor = reinterpret_cast<char*>(block + 1);
+    limit = cursor + capacity;
+    ++blocks;
+    reserved += capacity;
+}
+
+void Arena::release() {
+    while (head != nullptr) {
+        Block* next = head->next;
+        ::operator delete(head);
+        head = next;
+    }
+    cursor = nullptr;
+    limit = nullptr;
+}
@@ -0,0 +1,106 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// bump allocator, everything allocated from it is released at once when the arena goes away
+// destructors are never run, so objects placed in an arena must not own other resources
+class Arena {
+private:
+    struct Block {
+        Block* next;
+        size_t capacity;
+    };
+
+    Block* head = nullptr;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextBlockSize;
+    size_t blocks = 0;
+    size_t reserved = 0;
+
+    void grow(size_t minimum);
+    void release();
+
+public:
+    static constexpr size_t defaultBlockSize = 64 * 1024;
+
+    explicit Arena(size_t firstBlockSize = defaultBlockSize) : nextBlockSize(firstBlockSize) {}
+    ~Arena() { release(); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+
+    void* allocate(const size_t size, const size_t alignment) {
+        auto aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            grow(size + alignment);
+            aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <class T>
+    T* allocateArray(const size_t count) {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    std::string_view copyString(const std::string_view text) {
+        if (text.empty()) {
+            return {};
+        }
+        char* data = allocateArray<char>(text.size());
+        std::memcpy(data, text.data(), text.size());
+        return {data, text.size()};
+    }
+
+    // number of blocks taken from the heap and their total size
+    [[nodiscard]] size_t blockCount() const { return blocks; }
+    [[nodiscard]] size_t bytesReserved() const { return reserved; }
+};
+
+// fixed size array living in an arena
+template <class T>
+class ArenaList {
+private:
+    T* items = nullptr;
+    uint32_t count = 0;
+
+public:
+    ArenaList() = default;
+    ArenaList(T* items, const size_t count) : items(items), count(static_cast<uint32_t>(count)) {}
+
+    // copies [first, last) into the arena
+    static ArenaList copy(Arena& arena, const T* first, const T* last) {
+        const auto size = static_cast<size_t>(last - first);
+        if (size == 0) {
+            return {};
+        }
+        T* items = arena.allocateArray<T>(size);
+        std::memcpy(items, first, size * sizeof(T));
+        return {items, size};
+    }
+
+    [[nodiscard]] size_t size() const { return count; }
+    [[nodiscard]] bool empty() const { return count == 0; }
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    T& operator[](const size_t index) const { return items[index]; }
+};
+
+#endif //ARENA_H
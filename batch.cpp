@@ -0,0 +1,53 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <system_error>
+
+#include "lexer.h"
+#include "sourcefile.h"
+
+BatchResult parseFiles(const std::vector<std::string>& paths, ThreadPool& pool, const size_t nestingLimit) {
+    BatchResult batch;
+    batch.files.resize(paths.size());
+    std::vector<Interner> interners(paths.size());
+
+    // biggest first, so a large file picked up last does not leave the other threads idle at the end
+    std::vector<uintmax_t> sizes(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        std::error_code error;
+        const uintmax_t size = std::filesystem::file_size(paths[i], error);
+        sizes[i] = error ? 0 : size;
+    }
+    std::vector<size_t> order(paths.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::stable_sort(order, [&](const size_t a, const size_t b) { return sizes[a] > sizes[b]; });
+
+    pool.forEach(order, [&](const size_t index) {
+        BatchFile& file = batch.files[index];
+        file.path = paths[index];
+        try {
+            const SourceFile source(file.path);
+            Lexer lexer(source.text());
+            Parser parser(lexer);
+            parser.limitNesting(nestingLimit);
+            file.result = parser.parse();
+            // the tree holds arena copies of every name, the mapping can go once parsing is done
+            interners[index] = lexer.takeSymbols();
+        } catch (const std::exception& error) {
+            file.result = ParseResult();
+            file.error = error.what();
+        }
+    });
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const Interner& local = interners[i];
+        std::vector<uint32_t>& symbols = batch.files[i].symbols;
+        symbols.resize(local.size());
+        for (uint32_t symbol = 0; symbol < local.size(); ++symbol) {
+            symbols[symbol] = batch.symbols.intern(local.name(symbol));
+        }
+    }
+    return batch;
+}
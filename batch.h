@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "interner.h"
+#include "parser.h"
+#include "threadpool.h"
+
+// one input of parseFiles()
+struct BatchFile {
+    std::string path;
+    ParseResult result;             // empty when error is set, syntax errors are in result.diagnostics
+    std::string error;              // empty unless the file could not be read
+    // the file's own symbol ids (VariableNode::symbol and friends) mapped to ids in BatchResult::symbols
+    std::vector<uint32_t> symbols;
+};
+
+struct BatchResult {
+    std::vector<BatchFile> files;   // in the order the paths were given
+    Interner symbols;               // every identifier of every file
+};
+
+// lexes and parses every file on the pool, the largest files are started first
+// each file gets its own arena and interner while it is parsed, so workers share nothing;
+// the interners are merged afterwards in path order, so ids and diagnostics do not depend on scheduling
+BatchResult parseFiles(const std::vector<std::string>& paths, ThreadPool& pool,
+                       size_t nestingLimit = Parser::defaultNestingLimit);
+
+#endif //BATCH_H
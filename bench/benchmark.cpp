@@ -0,0 +1,387 @@
+// lexer and parser benchmark over generated corpora, results are written as JSON
+//   CuelBench [--size BYTES] [--repeat N] [--seed N] [--depth N] [--chain N] [--string-length N]
+//             [--shape NAME]... [--out FILE] [--dump NAME]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+#include "corpus.h"
+#include "../flatast.h"
+#include "../lexer.h"
+#include "../parser.h"
+#include "../scanner.h"
+#include "../tokenize.h"
+
+// every heap allocation of the process goes through these, so a phase's allocations are the
+// difference of the counters around it
+namespace {
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocatedBytes{0};
+}
+
+void* operator new(const size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+constexpr int formatVersion = 1;
+
+struct BenchOptions {
+    CorpusOptions corpus;
+    size_t repeat = 5;
+    std::vector<CorpusShape> shapes;
+    std::string out;
+    std::string dump;
+};
+
+struct AllocationCount {
+    size_t count = 0;
+    size_t bytes = 0;
+
+    static AllocationCount now() {
+        return {allocations.load(std::memory_order_relaxed), allocatedBytes.load(std::memory_order_relaxed)};
+    }
+
+    AllocationCount operator-(const AllocationCount& other) const {
+        return {count - other.count, bytes - other.bytes};
+    }
+};
+
+// the fastest of the repeats, and what the last repeat allocated
+struct Measurement {
+    double seconds = 0;
+    AllocationCount allocated;
+};
+
+template <class Function>
+Measurement measure(const size_t repeat, Function&& function) {
+    Measurement result;
+    result.seconds = 1e300;
+    for (size_t i = 0; i < repeat; ++i) {
+        const AllocationCount before = AllocationCount::now();
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto end = std::chrono::steady_clock::now();
+        result.allocated = AllocationCount::now() - before;
+        result.seconds = std::min(result.seconds, std::chrono::duration<double>(end - start).count());
+    }
+    return result;
+}
+
+// high water mark of the resident set in KiB, 0 when the platform does not say
+size_t peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:")) {
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return 0;
+#endif
+}
+
+// lets each shape report its own peak where the kernel supports it (Linux), otherwise peaks only grow
+void resetPeakRss() {
+#ifndef _WIN32
+    if (std::FILE* file = std::fopen("/proc/self/clear_refs", "w")) {
+        std::fputs("5", file);
+        std::fclose(file);
+    }
+#endif
+}
+
+// minimal JSON writer, keys and values are plain ascii
+class Json {
+private:
+    std::string out;
+    bool first = true;
+
+    void separator() {
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+    }
+
+    void key(const std::string_view name) {
+        separator();
+        out += '"';
+        out += name;
+        out += "\":";
+    }
+
+public:
+    void open(const std::string_view name = {}) {
+        if (name.empty()) {
+            separator();
+        } else {
+            key(name);
+        }
+        out += '{';
+        first = true;
+    }
+
+    void openArray(const std::string_view name) {
+        key(name);
+        out += '[';
+        first = true;
+    }
+
+    void close() { out += '}'; first = false; }
+    void closeArray() { out += ']'; first = false; }
+
+    void field(const std::string_view name, const std::string_view value) {
+        key(name);
+        out += '"';
+        out += value;
+        out += '"';
+    }
+
+    void field(const std::string_view name, const char* value) { field(name, std::string_view(value)); }
+
+    void field(const std::string_view name, const size_t value) {
+        key(name);
+        out += std::to_string(value);
+    }
+
+    void field(const std::string_view name, const double value) {
+        key(name);
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        out += buffer;
+    }
+
+    [[nodiscard]] const std::string& text() const { return out; }
+};
+
+double perSecond(const double amount, const double seconds) {
+    return seconds > 0 ? amount / seconds : 0;
+}
+
+double ratio(const double amount, const double count) {
+    return count > 0 ? amount / count : 0;
+}
+
+void runShape(const BenchOptions& options, const CorpusShape shape, Json& json) {
+    CorpusOptions corpusOptions = options.corpus;
+    corpusOptions.shape = shape;
+    const std::string source = generateCorpus(corpusOptions);
+    const double megabytes = static_cast<double>(source.size()) / (1024.0 * 1024.0);
+
+    resetPeakRss();
+
+    size_t tokenCount = 0;
+    const Measurement lexing = measure(options.repeat, [&] {
+        const TokenBuffer tokens = tokenize(source);
+        tokenCount = tokens.size();
+    });
+
+    // parsing alone, from a token buffer lexed up front
+    const TokenBuffer tokens = tokenize(source);
+    size_t nodeCount = 0;
+    const Measurement parsing = measure(options.repeat, [&] {
+        Parser parser(tokens);
+        const ParseResult result = parser.parse();
+        static_cast<void>(result);
+    });
+    {
+        Parser parser(tokens);
+        const ParseResult result = parser.parse();
+        // a literal and its value node count as one
+        nodeCount = flatten(result).nodes.size();
+    }
+
+    // what the driver does, the parser pulling tokens through a lexer window
+    const Measurement streaming = measure(options.repeat, [&] {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        const ParseResult result = parser.parse();
+        static_cast<void>(result);
+    });
+
+    const auto tokenTotal = static_cast<double>(tokenCount);
+    const auto nodeTotal = static_cast<double>(nodeCount);
+
+    json.open();
+    json.field("shape", corpusShapeName(shape));
+    json.field("bytes", source.size());
+    json.field("tokens", tokenCount);
+    json.field("nodes", nodeCount);
+
+    json.open("tokenize");
+    json.field("seconds", lexing.seconds);
+    json.field("mbPerSecond", perSecond(megabytes, lexing.seconds));
+    json.field("tokensPerSecond", perSecond(tokenTotal, lexing.seconds));
+    json.field("allocations", lexing.allocated.count);
+    json.field("allocatedBytes", lexing.allocated.bytes);
+    json.field("allocationsPerToken", ratio(static_cast<double>(lexing.allocated.count), tokenTotal));
+    json.close();
+
+    json.open("parse");
+    json.field("seconds", parsing.seconds);
+    json.field("mbPerSecond", perSecond(megabytes, parsing.seconds));
+    json.field("tokensPerSecond", perSecond(tokenTotal, parsing.seconds));
+    json.field("nodesPerSecond", perSecond(nodeTotal, parsing.seconds));
+    json.field("allocations", parsing.allocated.count);
+    json.field("allocatedBytes", parsing.allocated.bytes);
+    json.field("allocationsPerNode", ratio(static_cast<double>(parsing.allocated.count), nodeTotal));
+    json.close();
+
+    json.open("streamingParse");
+    json.field("seconds", streaming.seconds);
+    json.field("mbPerSecond", perSecond(megabytes, streaming.seconds));
+    json.field("tokensPerSecond", perSecond(tokenTotal, streaming.seconds));
+    json.field("allocations", streaming.allocated.count);
+    json.field("allocatedBytes", streaming.allocated.bytes);
+    json.field("allocationsPerNode", ratio(static_cast<double>(streaming.allocated.count), nodeTotal));
+    json.close();
+
+    json.field("peakRssKb", peakRssKb());
+    json.close();
+
+    std::cerr << corpusShapeName(shape) << ": " << source.size() << " bytes, "
+              << perSecond(megabytes, lexing.seconds) << " MB/s lex, "
+              << perSecond(megabytes, parsing.seconds) << " MB/s parse\n";
+}
+
+size_t parseCount(const std::string_view option, const char* value) {
+    char* end = nullptr;
+    const unsigned long long count = std::strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+        throw std::runtime_error("Invalid number for " + std::string(option) + ": " + value);
+    }
+    return static_cast<size_t>(count);
+}
+
+CorpusShape parseShape(const char* name) {
+    const std::optional<CorpusShape> shape = corpusShapeFromName(name);
+    if (!shape) {
+        throw std::runtime_error("Unknown corpus shape: " + std::string(name));
+    }
+    return *shape;
+}
+
+BenchOptions parseArguments(const int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (i + 1 == argc) {
+            throw std::runtime_error("Missing value after " + std::string(argument));
+        }
+        const char* value = argv[++i];
+        if (argument == "--size") {
+            options.corpus.size = parseCount(argument, value);
+        } else if (argument == "--repeat") {
+            options.repeat = std::max<size_t>(parseCount(argument, value), 1);
+        } else if (argument == "--seed") {
+            options.corpus.seed = parseCount(argument, value);
+        } else if (argument == "--depth") {
+            options.corpus.depth = static_cast<uint32_t>(parseCount(argument, value));
+        } else if (argument == "--chain") {
+            options.corpus.chain = static_cast<uint32_t>(parseCount(argument, value));
+        } else if (argument == "--string-length") {
+            options.corpus.stringLength = static_cast<uint32_t>(parseCount(argument, value));
+        } else if (argument == "--shape") {
+            options.shapes.push_back(parseShape(value));
+        } else if (argument == "--out") {
+            options.out = value;
+        } else if (argument == "--dump") {
+            options.dump = value;
+        } else {
+            throw std::runtime_error("Unknown option: " + std::string(argument));
+        }
+    }
+    if (options.shapes.empty()) {
+        for (int shape = 0; shape < CORPUS_SHAPE_COUNT; ++shape) {
+            options.shapes.push_back(static_cast<CorpusShape>(shape));
+        }
+    }
+    return options;
+}
+
+}
+
+int main(const int argc, char** argv) {
+    try {
+        const BenchOptions options = parseArguments(argc, argv);
+
+        if (!options.dump.empty()) {
+            CorpusOptions corpusOptions = options.corpus;
+            corpusOptions.shape = parseShape(options.dump.c_str());
+            const std::string source = generateCorpus(corpusOptions);
+            std::fwrite(source.data(), 1, source.size(), stdout);
+            return 0;
+        }
+
+        Json json;
+        json.open();
+        json.field("formatVersion", static_cast<size_t>(formatVersion));
+        json.field("scanner", scannerName());
+        json.open("corpus");
+        json.field("size", options.corpus.size);
+        json.field("seed", static_cast<size_t>(options.corpus.seed));
+        json.field("depth", static_cast<size_t>(options.corpus.depth));
+        json.field("chain", static_cast<size_t>(options.corpus.chain));
+        json.field("stringLength", static_cast<size_t>(options.corpus.stringLength));
+        json.close();
+        json.field("repeat", options.repeat);
+        json.openArray("results");
+        for (const CorpusShape shape : options.shapes) {
+            runShape(options, shape, json);
+        }
+        json.closeArray();
+        json.close();
+
+        if (options.out.empty()) {
+            std::cout << json.text() << '\n';
+        } else {
+            std::ofstream file(options.out, std::ios::binary);
+            file << json.text() << '\n';
+            if (!file) {
+                throw std::runtime_error("Cannot write " + options.out);
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << "CuelBench: " << error.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include "corpus.h"
+
+#include <iterator>
+#include <utility>
+
+namespace {
+
+// splitmix64, small and fully specified so corpora match across standard libraries
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(const uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // in [0, bound)
+    uint32_t below(const uint32_t bound) {
+        return static_cast<uint32_t>(next() % bound);
+    }
+};
+
+constexpr std::string_view arithmeticOperators[] = {" + ", " - ", " * ", " & ", " | ", " ^ ", " << ", " >> "};
+constexpr std::string_view comparisonOperators[] = {" == ", " != ", " < ", " > ", " <= ", " >= "};
+
+class Generator {
+private:
+    const CorpusOptions& options;
+    Random random;
+    std::string out;
+    uint32_t names = 0;
+
+    // only the variables of the prologue are used in expressions, so every program resolves
+    std::string_view operand() {
+        switch (random.below(4)) {
+        case 0: return "a";
+        case 1: return "b";
+        default: return {};
+        }
+    }
+
+    void leaf() {
+        const std::string_view name = operand();
+        if (name.empty()) {
+            out += std::to_string(random.below(1000));
+        } else {
+            out += name;
+        }
+    }
+
+    void declarationName() {
+        out += "v";
+        out += std::to_string(names++);
+    }
+
+    // ((((a + 1) * b) - 7) ...), left nested so the parser climbs back through every level
+    void nested() {
+        out += "var ";
+        declarationName();
+        out += " = ";
+        out.append(options.depth, '(');
+        leaf();
+        for (uint32_t level = 0; level < options.depth; ++level) {
+            out += arithmeticOperators[random.below(std::size(arithmeticOperators))];
+            leaf();
+            out += ')';
+        }
+        out += ";\n";
+    }
+
+    void condition() {
+        out += 'a';
+        out += comparisonOperators[random.below(std::size(comparisonOperators))];
+        out += std::to_string(random.below(100));
+    }
+
+    void ifChain() {
+        out += "if (";
+        condition();
+        out += ") {\n    b = b + 1;\n}";
+        for (uint32_t branch = 0; branch < options.chain; ++branch) {
+            out += " elseif (";
+            condition();
+            out += ") {\n    b = ";
+            out += std::to_string(branch);
+            out += ";\n}";
+        }
+        out += " else {\n    b = 0;\n}\n";
+    }
+
+    void declaration() {
+        out += "var ";
+        declarationName();
+        out += " = ";
+        leaf();
+        if (random.below(2) == 0) {
+            out += arithmeticOperators[random.below(std::size(arithmeticOperators))];
+            leaf();
+        }
+        out += ";\n";
+    }
+
+    void string() {
+        out += "var ";
+        declarationName();
+        out += " = \"";
+        const uint32_t length = options.stringLength / 2 + random.below(options.stringLength + 1);
+        for (uint32_t i = 0; i < length; ++i) {
+            const uint32_t pick = random.below(32);
+            out += pick < 26 ? static_cast<char>('a' + pick) : ' ';
+        }
+        out += "\";\n";
+    }
+
+    void loop() {
+        out += "while (a < ";
+        out += std::to_string(random.below(100));
+        out += ") {\n    a = a + 1;\n    if (a == b) {\n        break;\n    }\n}\n";
+    }
+
+    void statement(const CorpusShape shape) {
+        switch (shape) {
+        case CORPUS_NESTED: nested(); break;
+        case CORPUS_IF_CHAIN: ifChain(); break;
+        case CORPUS_DECLARATIONS: declaration(); break;
+        case CORPUS_STRINGS: string(); break;
+        default:
+            switch (random.below(6)) {
+            case 0: nested(); break;
+            case 1: ifChain(); break;
+            case 2: string(); break;
+            case 3: loop(); break;
+            default: declaration(); break;
+            }
+            break;
+        }
+    }
+
+public:
+    explicit Generator(const CorpusOptions& options) : options(options), random(options.seed) {}
+
+    std::string run() {
+        out.reserve(options.size + 4096);
+        out += "// generated ";
+        out += corpusShapeName(options.shape);
+        out += " corpus, seed ";
+        out += std::to_string(options.seed);
+        out += "\nvar a = 1;\nvar b = 2;\n";
+        while (out.size() < options.size) {
+            statement(options.shape);
+        }
+        out += "return b;\n";
+        return std::move(out);
+    }
+};
+
+}
+
+std::string generateCorpus(const CorpusOptions& options) {
+    Generator generator(options);
+    return generator.run();
+}
+
+const char* corpusShapeName(const CorpusShape shape) {
+    switch (shape) {
+    case CORPUS_NESTED: return "nested";
+    case CORPUS_IF_CHAIN: return "ifchain";
+    case CORPUS_DECLARATIONS: return "declarations";
+    case CORPUS_STRINGS: return "strings";
+    case CORPUS_MIXED: return "mixed";
+    default: return "unknown";
+    }
+}
+
+std::optional<CorpusShape> corpusShapeFromName(const std::string_view name) {
+    for (int shape = 0; shape < CORPUS_SHAPE_COUNT; ++shape) {
+        if (name == corpusShapeName(static_cast<CorpusShape>(shape))) {
+            return static_cast<CorpusShape>(shape);
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,36 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// what the generated program is made of
+enum CorpusShape {
+    CORPUS_NESTED,        // declarations initialized with deeply parenthesized expressions
+    CORPUS_IF_CHAIN,      // long if/elseif/else chains
+    CORPUS_DECLARATIONS,  // many short var declarations
+    CORPUS_STRINGS,       // declarations of long string literals
+    CORPUS_MIXED,         // all of the above plus while loops, picked at random per statement
+    CORPUS_SHAPE_COUNT
+};
+
+struct CorpusOptions {
+    CorpusShape shape = CORPUS_MIXED;
+    size_t size = 8 * 1024 * 1024;  // generation stops at the first statement boundary past this many bytes
+    uint64_t seed = 1;
+    uint32_t depth = 64;            // parentheses around each nested expression
+    uint32_t chain = 32;            // elseif branches per chain
+    uint32_t stringLength = 256;    // average string literal length
+};
+
+// builds a program that lexes and parses cleanly, the same options always give the same bytes
+// on every platform (it uses its own random generator, not <random> distributions)
+std::string generateCorpus(const CorpusOptions& options);
+
+const char* corpusShapeName(CorpusShape shape);
+std::optional<CorpusShape> corpusShapeFromName(std::string_view name);
+
+#endif //CORPUS_H
@@ -0,0 +1,522 @@
+#include "cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+// CUEL_BUILD_ID, generated by the CMake build from its sources (cmake/BuildId.cmake)
+#if __has_include("buildid.h")
+#include "buildid.h"
+#endif
+
+namespace {
+
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t rotl(const uint64_t value, const int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t read64(const unsigned char* bytes) {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+uint32_t read32(const unsigned char* bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+uint64_t round(uint64_t accumulator, const uint64_t input) {
+    accumulator += input * prime2;
+    return rotl(accumulator, 31) * prime1;
+}
+
+uint64_t mergeRound(uint64_t accumulator, const uint64_t value) {
+    accumulator ^= round(0, value);
+    return accumulator * prime1 + prime4;
+}
+
+constexpr char magic[8] = {'C', 'U', 'E', 'L', 'B', 'C', '\r', '\n'};
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+// everything in front of the arrays of an entry, offsets are from the start of the file
+// and 8 byte aligned so the arrays can be used in place
+struct EntryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint16_t instructionSize;
+    uint16_t valueSize;
+    uint32_t localCount;
+    uint32_t globalCount;
+    uint32_t maxStack;
+    uint64_t buildId;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t entryHash;         // of the whole entry, with this field zero
+    uint64_t codeOffset;
+    uint64_t codeCount;
+    uint64_t constantOffset;
+    uint64_t constantCount;
+    uint64_t integerOffset;
+    uint64_t integerCount;
+    uint64_t jumpTableOffset;
+    uint64_t jumpTableCount;
+    uint64_t stringEndOffset;
+    uint64_t stringCount;
+    uint64_t charOffset;
+    uint64_t charCount;
+};
+
+static_assert(std::is_trivially_copyable_v<Instruction> && std::is_trivially_copyable_v<Value>,
+              "cache entries hold instructions and values as raw bytes");
+static_assert(alignof(Instruction) <= 8 && alignof(Value) <= 8);
+
+// memcpy that accepts the null data() of an empty array
+void copyBytes(char* destination, const void* source, const size_t size) {
+    if (size > 0) {
+        std::memcpy(destination, source, size);
+    }
+}
+
+uint64_t alignUp(const uint64_t offset) {
+    return (offset + 7) & ~uint64_t{7};
+}
+
+// true when count elements of size bytes at offset lie inside a file of fileSize bytes
+bool fits(const uint64_t offset, const uint64_t count, const uint64_t size, const uint64_t fileSize) {
+    return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+}
+
+// true when every constant the vm may look up in the integer table or the program's strings has an
+// entry there; integer() and StringHeap read anything that is not inline through these tables
+bool constantsFit(const ProgramView& program) {
+    for (const Value& value : program.constants) {
+        if (value.type() == VALUE_NUMBER && !value.isNumber() && value.wideNumber() >= program.integers.size()) {
+            return false;
+        }
+        if (value.type() == VALUE_STRING &&
+            (value.isShortString() ? value.shortLength() > Value::shortStringSize
+                                   : value.string() >= program.stringEnds.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// adds where the switch instruction can jump to targets, false when its table does not lie inside
+// jumpTables or names a label that is not a string constant
+bool switchTargets(const ProgramView& program, const Instruction& instruction, std::vector<int64_t>& targets) {
+    if (instruction.operand >= program.jumpTables.size()) {
+        return false;
+    }
+    const int64_t* const table = program.jumpTables.data() + instruction.operand;
+    const uint64_t size = program.jumpTables.size() - instruction.operand;
+    targets.push_back(table[0]);
+    switch (instruction.op) {
+    case OP_SWITCH_DENSE: {
+        if (size < 3 || table[2] < 0 || static_cast<uint64_t>(table[2]) > size - 3) {
+            return false;
+        }
+        targets.insert(targets.end(), table + 3, table + 3 + table[2]);
+        return true;
+    }
+    case OP_SWITCH_SPARSE: {
+        if (size < 2 || table[1] < 0 || static_cast<uint64_t>(table[1]) > (size - 2) / 2) {
+            return false;
+        }
+        const int64_t* const labels = table + 2;
+        for (int64_t i = 1; i < table[1]; ++i) {
+            if (labels[i - 1] >= labels[i]) {
+                return false;
+            }
+        }
+        targets.insert(targets.end(), labels + table[1], labels + 2 * table[1]);
+        return true;
+    }
+    default: {
+        if (size < 3 || table[1] < 0 || table[2] < 0 || static_cast<uint64_t>(table[1]) >= size ||
+            static_cast<uint64_t>(table[2]) >= size) {
+            return false;
+        }
+        const uint64_t buckets = static_cast<uint64_t>(table[1]) + 1;
+        const uint64_t slots = static_cast<uint64_t>(table[2]) + 1;
+        if (3 + buckets + 2 * slots > size) {
+            return false;
+        }
+        for (const int64_t* slot = table + 3 + buckets; slot != table + 3 + buckets + 2 * slots; slot += 2) {
+            if (slot[0] < 0) {
+                continue;
+            }
+            if (static_cast<uint64_t>(slot[0]) >= program.constants.size() ||
+                program.constants[slot[0]].type() != VALUE_STRING) {
+                return false;
+            }
+            targets.push_back(slot[1]);
+        }
+        return true;
+    }
+    }
+}
+
+// true when running the program keeps the vm inside its tables: every instruction it can reach has a
+// known opcode and operands that index what they refer to, no jump leaves the code, execution
+// cannot run off its end, and the stack never goes below empty or above maxStack
+// the typed opcodes trust checkTypes() about their operands, which cannot be checked here; the
+// entry hash stands in for that
+bool verify(const ProgramView& program) {
+    if (!constantsFit(program)) {
+        return false;
+    }
+    // stack depth in front of every instruction reached so far, each path there has to agree on it
+    constexpr uint32_t unreached = UINT32_MAX;
+    std::vector<uint32_t> depths(program.code.size(), unreached);
+    std::vector<uint32_t> pending;
+    const auto reach = [&](const int64_t target, const uint32_t depth) {
+        if (target < 0 || static_cast<uint64_t>(target) >= program.code.size()) {
+            return false;
+        }
+        if (depths[target] == unreached) {
+            depths[target] = depth;
+            pending.push_back(static_cast<uint32_t>(target));
+        }
+        return depths[target] == depth;
+    };
+
+    if (!reach(0, 0)) {
+        return false;
+    }
+    std::vector<int64_t> targets;
+    while (!pending.empty()) {
+        const uint32_t index = pending.back();
+        pending.pop_back();
+        const Instruction instruction = program.code[index];
+        const uint32_t depth = depths[index];
+        uint32_t popped = 0;
+        uint32_t pushed = 0;
+        bool next = true;
+        targets.clear();
+
+        switch (instruction.op) {
+        case OP_CONSTANT:
+            if (instruction.operand >= program.constants.size()) {
+                return false;
+            }
+            pushed = 1;
+            break;
+        case OP_LOAD_LOCAL:
+        case OP_LOAD_GLOBAL:
+            if (instruction.operand >= (instruction.op == OP_LOAD_LOCAL ? program.localCount : program.globalCount)) {
+                return false;
+            }
+            pushed = 1;
+            break;
+        case OP_STORE_LOCAL:
+        case OP_STORE_GLOBAL:
+            if (instruction.operand >= (instruction.op == OP_STORE_LOCAL ? program.localCount : program.globalCount)) {
+                return false;
+            }
+            popped = 1;
+            break;
+        case OP_TRUE:
+        case OP_FALSE:
+            pushed = 1;
+            break;
+        case OP_POP:
+            popped = 1;
+            break;
+        case OP_DUP:
+            popped = 1;
+            pushed = 2;
+            break;
+        case OP_TO_BOOLEAN:
+            popped = 1;
+            pushed = 1;
+            break;
+        case OP_CHECK_TYPE:
+            if (instruction.operand > VARIABLE_GENERIC) {
+                return false;
+            }
+            popped = 1;
+            pushed = 1;
+            break;
+        case OP_JUMP:
+            targets.push_back(instruction.operand);
+            next = false;
+            break;
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_FALSE_BOOLEAN:
+            targets.push_back(instruction.operand);
+            popped = 1;
+            break;
+        case OP_JUMP_IF_FALSE_OR_POP:
+        case OP_JUMP_IF_TRUE_OR_POP:
+            // the jump keeps the value, falling through pops it
+            if (depth == 0 || !reach(instruction.operand, depth)) {
+                return false;
+            }
+            popped = 1;
+            break;
+        case OP_SWITCH_DENSE:
+        case OP_SWITCH_SPARSE:
+        case OP_SWITCH_STRING:
+            if (!switchTargets(program, instruction, targets)) {
+                return false;
+            }
+            popped = 1;
+            next = false;
+            break;
+        case OP_RETURN:
+            popped = 1;
+            next = false;
+            break;
+        case OP_HALT:
+            next = false;
+            break;
+        default:
+            if (instruction.op >= OP_COUNT) {
+                return false;
+            }
+            // the binary operators
+            popped = 2;
+            pushed = 1;
+            break;
+        }
+
+        if (depth < popped || depth - popped + pushed > program.maxStack) {
+            return false;
+        }
+        const uint32_t after = depth - popped + pushed;
+        for (const int64_t target : targets) {
+            if (!reach(target, after)) {
+                return false;
+            }
+        }
+        if (next && !reach(int64_t{index} + 1, after)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = bytes + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        // four independent lanes keep the multipliers busy
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        const unsigned char* const limit = end - 32;
+        do {
+            v1 = round(v1, read64(bytes));
+            v2 = round(v2, read64(bytes + 8));
+            v3 = round(v3, read64(bytes + 16));
+            v4 = round(v4, read64(bytes + 24));
+            bytes += 32;
+        } while (bytes <= limit);
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += static_cast<uint64_t>(size);
+
+    for (; bytes + 8 <= end; bytes += 8) {
+        hash ^= round(0, read64(bytes));
+        hash = rotl(hash, 27) * prime1 + prime4;
+    }
+    if (bytes + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(bytes)) * prime1;
+        hash = rotl(hash, 23) * prime2 + prime3;
+        bytes += 4;
+    }
+    for (; bytes < end; ++bytes) {
+        hash ^= *bytes * prime5;
+        hash = rotl(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+CacheKey cacheKey(const std::string_view source) {
+    return {hashBytes(source.data(), source.size()), source.size()};
+}
+
+namespace {
+
+// identifies the build, so any change to the compiler or the vm gets entries of its own even when
+// formatVersion stays; the hash of the sources when the build generated one, otherwise when this
+// file was compiled
+#ifdef CUEL_BUILD_ID
+constexpr std::string_view buildStamp = CUEL_BUILD_ID;
+#else
+constexpr std::string_view buildStamp = __DATE__ " " __TIME__;
+#endif
+
+// hash of an entry, header is its header with entryHash still zero and payload everything behind it
+uint64_t entryHash(const EntryHeader& header, const std::string_view payload) {
+    return hashBytes(payload.data(), payload.size(), hashBytes(&header, sizeof(header)));
+}
+
+}
+
+ScriptCache::ScriptCache(const std::string& directory) : directory(directory), buildId(hashBytes(buildStamp.data(), buildStamp.size())) {
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        throw std::runtime_error("Cannot create cache directory " + directory + ": " + error.message());
+    }
+}
+
+std::filesystem::path ScriptCache::entryPath(const CacheKey& key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.cuelc", static_cast<unsigned long long>(key.hash));
+    return directory / name;
+}
+
+std::optional<CachedProgram> ScriptCache::load(const CacheKey& key) const {
+    SourceFile file;
+    try {
+        file = SourceFile(entryPath(key).string());
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    const std::string_view bytes = file.text();
+    if (bytes.size() < sizeof(EntryHeader)) {
+        return std::nullopt;
+    }
+    EntryHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != formatVersion ||
+        header.byteOrder != byteOrderMark || header.instructionSize != sizeof(Instruction) ||
+        header.valueSize != sizeof(Value) || header.buildId != buildId || header.sourceHash != key.hash ||
+        header.sourceSize != key.size) {
+        return std::nullopt;
+    }
+
+    // a damaged entry fails the hash, and one that still passes cannot send the vm out of its tables
+    EntryHeader unhashed = header;
+    unhashed.entryHash = 0;
+    if (entryHash(unhashed, bytes.substr(sizeof(EntryHeader))) != header.entryHash) {
+        return std::nullopt;
+    }
+    const uint64_t fileSize = bytes.size();
+    if (!fits(header.codeOffset, header.codeCount, sizeof(Instruction), fileSize) ||
+        !fits(header.constantOffset, header.constantCount, sizeof(Value), fileSize) ||
+        !fits(header.integerOffset, header.integerCount, sizeof(int64_t), fileSize) ||
+        !fits(header.jumpTableOffset, header.jumpTableCount, sizeof(int64_t), fileSize) ||
+        !fits(header.stringEndOffset, header.stringCount, sizeof(uint32_t), fileSize) ||
+        !fits(header.charOffset, header.charCount, 1, fileSize)) {
+        return std::nullopt;
+    }
+
+    ProgramView view;
+    view.code = {reinterpret_cast<const Instruction*>(bytes.data() + header.codeOffset), header.codeCount};
+    view.constants = {reinterpret_cast<const Value*>(bytes.data() + header.constantOffset), header.constantCount};
+    view.integers = {reinterpret_cast<const int64_t*>(bytes.data() + header.integerOffset), header.integerCount};
+    view.jumpTables = {reinterpret_cast<const int64_t*>(bytes.data() + header.jumpTableOffset), header.jumpTableCount};
+    view.stringEnds = {reinterpret_cast<const uint32_t*>(bytes.data() + header.stringEndOffset), header.stringCount};
+    view.chars = bytes.substr(header.charOffset, header.charCount);
+    view.localCount = header.localCount;
+    view.globalCount = header.globalCount;
+    view.maxStack = header.maxStack;
+
+    uint32_t previous = 0;
+    for (const uint32_t stringEnd : view.stringEnds) {
+        if (stringEnd < previous || stringEnd > view.chars.size()) {
+            return std::nullopt;
+        }
+        previous = stringEnd;
+    }
+    if (!verify(view)) {
+        return std::nullopt;
+    }
+    return CachedProgram(std::move(file), view);
+}
+
+bool ScriptCache::store(const CacheKey& key, const ProgramView& program) const {
+    EntryHeader header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = formatVersion;
+    header.byteOrder = byteOrderMark;
+    header.instructionSize = sizeof(Instruction);
+    header.valueSize = sizeof(Value);
+    header.localCount = program.localCount;
+    header.globalCount = program.globalCount;
+    header.maxStack = program.maxStack;
+    header.buildId = buildId;
+    header.sourceHash = key.hash;
+    header.sourceSize = key.size;
+    header.codeOffset = alignUp(sizeof(EntryHeader));
+    header.codeCount = program.code.size();
+    header.constantOffset = alignUp(header.codeOffset + program.code.size_bytes());
+    header.constantCount = program.constants.size();
+    header.integerOffset = alignUp(header.constantOffset + program.constants.size_bytes());
+    header.integerCount = program.integers.size();
+    header.jumpTableOffset = alignUp(header.integerOffset + program.integers.size_bytes());
+    header.jumpTableCount = program.jumpTables.size();
+    header.stringEndOffset = alignUp(header.jumpTableOffset + program.jumpTables.size_bytes());
+    header.stringCount = program.stringEnds.size();
+    header.charOffset = alignUp(header.stringEndOffset + program.stringEnds.size_bytes());
+    header.charCount = program.chars.size();
+
+    // one buffer and one write, the gaps between the arrays stay zero
+    std::string entry(header.charOffset + header.charCount, '\0');
+    copyBytes(entry.data() + header.codeOffset, program.code.data(), program.code.size_bytes());
+    copyBytes(entry.data() + header.constantOffset, program.constants.data(), program.constants.size_bytes());
+    copyBytes(entry.data() + header.integerOffset, program.integers.data(), program.integers.size_bytes());
+    copyBytes(entry.data() + header.jumpTableOffset, program.jumpTables.data(), program.jumpTables.size_bytes());
+    copyBytes(entry.data() + header.stringEndOffset, program.stringEnds.data(), program.stringEnds.size_bytes());
+    copyBytes(entry.data() + header.charOffset, program.chars.data(), program.chars.size());
+    // the header goes in last, it holds the hash of the whole entry
+    header.entryHash = entryHash(header, std::string_view(entry).substr(sizeof(header)));
+    std::memcpy(entry.data(), &header, sizeof(header));
+
+    const std::filesystem::path path = entryPath(key);
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(std::random_device()());
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+        if (!out) {
+            out.close();
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
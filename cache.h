@@ -0,0 +1,65 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "compiler.h"
+#include "sourcefile.h"
+
+// 64 bit xxHash of data, fast enough that hashing a script costs about as much as reading it
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+// what a cache entry is looked up by, the size makes a collision between scripts even less likely
+struct CacheKey {
+    uint64_t hash = 0;
+    uint64_t size = 0;
+};
+
+CacheKey cacheKey(std::string_view source);
+
+// a cache entry mapped from disk, program() points straight into the mapping
+class CachedProgram {
+private:
+    SourceFile file;
+    ProgramView view;
+
+public:
+    CachedProgram(SourceFile file, const ProgramView& view) : file(std::move(file)), view(view) {}
+
+    // valid as long as the CachedProgram is, moving it keeps the mapping where it is
+    [[nodiscard]] const ProgramView& program() const { return view; }
+};
+
+// directory of compiled programs, one file per source keyed by its hash
+// an entry is the Program's arrays written out as they are behind a small header, so loading one
+// is an mmap, a hash of the entry and one pass over its code that checks every operand and jump;
+// entries are written to a temporary file and renamed into place, so processes sharing a directory
+// never see half an entry
+// formatVersion has to go up whenever the layout of an entry changes, entries of another build of
+// the interpreter are never loaded
+class ScriptCache {
+private:
+    std::filesystem::path directory;
+    uint64_t buildId;
+
+    [[nodiscard]] std::filesystem::path entryPath(const CacheKey& key) const;
+
+public:
+    static constexpr uint32_t formatVersion = 7;
+
+    // creates the directory if it is missing, throws std::runtime_error when that fails
+    explicit ScriptCache(const std::string& directory);
+
+    // nullopt when there is no entry, it was written for another source, version or build, or it
+    // is damaged
+    [[nodiscard]] std::optional<CachedProgram> load(const CacheKey& key) const;
+    // false when the entry could not be written, the cache only ever saves time
+    bool store(const CacheKey& key, const ProgramView& program) const;
+};
+
+#endif //CACHE_H
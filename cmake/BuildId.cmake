@@ -0,0 +1,16 @@
+# writes OUTPUT, a header defining CUEL_BUILD_ID as a hash of SOURCES (relative to SOURCE_DIR)
+# run at build time by the CuelCore target; OUTPUT is only touched when the hash changes, so an
+# unchanged tree does not recompile what includes it
+#   cmake -DSOURCE_DIR=... -DOUTPUT=... "-DSOURCES=a.cpp;a.h;..." -P BuildId.cmake
+
+set(hashes "")
+foreach (source IN LISTS SOURCES)
+    file(SHA256 "${SOURCE_DIR}/${source}" hash)
+    string(APPEND hashes "${source} ${hash}\n")
+endforeach ()
+string(SHA256 id "${hashes}")
+string(SUBSTRING "${id}" 0 16 id)
+
+file(WRITE "${OUTPUT}.tmp" "// generated by cmake/BuildId.cmake, do not edit\n#define CUEL_BUILD_ID \"${id}\"\n")
+configure_file("${OUTPUT}.tmp" "${OUTPUT}" COPYONLY)
+file(REMOVE "${OUTPUT}.tmp")
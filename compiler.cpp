@@ -0,0 +1,736 @@
+#include "compiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "cache.h"
+#include "typecheck.h"
+
+namespace {
+
+// how many values an instruction leaves on the stack minus how many it takes,
+// for the conditional jumps this is the effect when the jump is not taken
+int stackEffect(const OpCode op) {
+    switch (op) {
+    case OP_CONSTANT:
+    case OP_TRUE:
+    case OP_FALSE:
+    case OP_DUP:
+    case OP_LOAD_LOCAL:
+    case OP_LOAD_GLOBAL:
+        return 1;
+    case OP_POP:
+    case OP_STORE_LOCAL:
+    case OP_STORE_GLOBAL:
+    case OP_ADD:
+    case OP_SUBTRACT:
+    case OP_MULTIPLY:
+    case OP_DIVIDE:
+    case OP_MODULUS:
+    case OP_EQUAL:
+    case OP_NOT_EQUAL:
+    case OP_GREATER:
+    case OP_LESS:
+    case OP_GREATER_EQUAL:
+    case OP_LESS_EQUAL:
+    case OP_BITWISE_AND:
+    case OP_BITWISE_OR:
+    case OP_BITWISE_XOR:
+    case OP_LEFT_SHIFT:
+    case OP_RIGHT_SHIFT:
+    case OP_ADD_INTEGER:
+    case OP_SUBTRACT_INTEGER:
+    case OP_MULTIPLY_INTEGER:
+    case OP_DIVIDE_INTEGER:
+    case OP_MODULUS_INTEGER:
+    case OP_EQUAL_INTEGER:
+    case OP_NOT_EQUAL_INTEGER:
+    case OP_GREATER_INTEGER:
+    case OP_LESS_INTEGER:
+    case OP_GREATER_EQUAL_INTEGER:
+    case OP_LESS_EQUAL_INTEGER:
+    case OP_ADD_FLOAT:
+    case OP_SUBTRACT_FLOAT:
+    case OP_MULTIPLY_FLOAT:
+    case OP_DIVIDE_FLOAT:
+    case OP_GREATER_FLOAT:
+    case OP_LESS_FLOAT:
+    case OP_GREATER_EQUAL_FLOAT:
+    case OP_LESS_EQUAL_FLOAT:
+    case OP_JUMP_IF_FALSE:
+    case OP_JUMP_IF_FALSE_BOOLEAN:
+    case OP_JUMP_IF_FALSE_OR_POP:
+    case OP_JUMP_IF_TRUE_OR_POP:
+    case OP_SWITCH_DENSE:
+    case OP_SWITCH_SPARSE:
+    case OP_SWITCH_STRING:
+    case OP_RETURN:
+        return -1;
+    default:
+        return 0;
+    }
+}
+
+OpCode binaryOpCode(const TokenType operation) {
+    switch (operation) {
+    case TOK_ADDITION:
+    case TOK_ADDITION_ASSIGNMENT:       return OP_ADD;
+    case TOK_SUBTRACTION:
+    case TOK_SUBTRACTION_ASSIGNMENT:    return OP_SUBTRACT;
+    case TOK_MULTIPLICATION:
+    case TOK_MULTIPLICATION_ASSIGNMENT: return OP_MULTIPLY;
+    case TOK_DIVISION:
+    case TOK_DIVISION_ASSIGNMENT:       return OP_DIVIDE;
+    case TOK_MODULUS:
+    case TOK_MODULUS_ASSIGNMENT:        return OP_MODULUS;
+    case TOK_EQUAL:                     return OP_EQUAL;
+    case TOK_NOT_EQUAL:                 return OP_NOT_EQUAL;
+    case TOK_GREATER:                   return OP_GREATER;
+    case TOK_LESS:                      return OP_LESS;
+    case TOK_GREATER_EQUAL:             return OP_GREATER_EQUAL;
+    case TOK_LESS_EQUAL:                return OP_LESS_EQUAL;
+    case TOK_BITWISE_AND:               return OP_BITWISE_AND;
+    case TOK_BITWISE_OR:                return OP_BITWISE_OR;
+    case TOK_BITWISE_XOR:               return OP_BITWISE_XOR;
+    case TOK_LEFT_SHIFT:                return OP_LEFT_SHIFT;
+    case TOK_RIGHT_SHIFT:               return OP_RIGHT_SHIFT;
+    default:
+        throw std::runtime_error("Unsupported operator: " + tokenTypeToString(operation));
+    }
+}
+
+// the unchecked instruction for op when both operands are known to be integers or both floats,
+// op itself otherwise
+OpCode specialize(const OpCode op, const StaticType left, const StaticType right) {
+    if (left == TYPE_INTEGER && right == TYPE_INTEGER) {
+        switch (op) {
+        case OP_ADD:           return OP_ADD_INTEGER;
+        case OP_SUBTRACT:      return OP_SUBTRACT_INTEGER;
+        case OP_MULTIPLY:      return OP_MULTIPLY_INTEGER;
+        case OP_DIVIDE:        return OP_DIVIDE_INTEGER;
+        case OP_MODULUS:       return OP_MODULUS_INTEGER;
+        case OP_EQUAL:         return OP_EQUAL_INTEGER;
+        case OP_NOT_EQUAL:     return OP_NOT_EQUAL_INTEGER;
+        case OP_GREATER:       return OP_GREATER_INTEGER;
+        case OP_LESS:          return OP_LESS_INTEGER;
+        case OP_GREATER_EQUAL: return OP_GREATER_EQUAL_INTEGER;
+        case OP_LESS_EQUAL:    return OP_LESS_EQUAL_INTEGER;
+        default:               return op;
+        }
+    }
+    if (left == TYPE_FLOAT && right == TYPE_FLOAT) {
+        switch (op) {
+        case OP_ADD:           return OP_ADD_FLOAT;
+        case OP_SUBTRACT:      return OP_SUBTRACT_FLOAT;
+        case OP_MULTIPLY:      return OP_MULTIPLY_FLOAT;
+        case OP_DIVIDE:        return OP_DIVIDE_FLOAT;
+        case OP_GREATER:       return OP_GREATER_FLOAT;
+        case OP_LESS:          return OP_LESS_FLOAT;
+        case OP_GREATER_EQUAL: return OP_GREATER_EQUAL_FLOAT;
+        case OP_LESS_EQUAL:    return OP_LESS_EQUAL_FLOAT;
+        default:               return op;
+        }
+    }
+    return op;
+}
+
+// the tables below leave the targets open, the compiler fills them in once the bodies are placed:
+// targets gets where the target of each label goes and defaults where the default target does
+
+// appends the table of a switch on integer labels, a jump table when at least half of the values
+// between the lowest and the highest label are labels and a sorted array to search otherwise
+OpCode integerTable(std::vector<int64_t>& tables, const std::vector<int64_t>& labels,
+                    std::vector<size_t>& targets, std::vector<size_t>& defaults) {
+    std::vector<int64_t> sorted(labels);
+    std::ranges::sort(sorted);
+    if (const auto duplicate = std::ranges::adjacent_find(sorted); duplicate != sorted.end()) {
+        throw std::runtime_error("Duplicate case label: " + std::to_string(*duplicate));
+    }
+    const size_t start = tables.size();
+    defaults.push_back(start);
+    const int64_t low = sorted.front();
+    const uint64_t range = static_cast<uint64_t>(sorted.back()) - static_cast<uint64_t>(low);
+
+    if (range / 2 < sorted.size()) {
+        const size_t count = range + 1;
+        tables.insert(tables.end(), {0, low, static_cast<int64_t>(count)});
+        tables.resize(start + 3 + count, -1);
+        for (const int64_t label : labels) {
+            const size_t entry = start + 3 + (static_cast<uint64_t>(label) - static_cast<uint64_t>(low));
+            tables[entry] = 0;
+            targets.push_back(entry);
+        }
+        for (size_t entry = start + 3; entry < tables.size(); ++entry) {
+            if (tables[entry] == -1) {
+                defaults.push_back(entry);
+            }
+        }
+        return OP_SWITCH_DENSE;
+    }
+
+    const size_t count = sorted.size();
+    tables.insert(tables.end(), {0, static_cast<int64_t>(count)});
+    tables.insert(tables.end(), sorted.begin(), sorted.end());
+    tables.resize(start + 2 + 2 * count, 0);
+    for (const int64_t label : labels) {
+        const auto position = static_cast<size_t>(std::ranges::lower_bound(sorted, label) - sorted.begin());
+        targets.push_back(start + 2 + count + position);
+    }
+    return OP_SWITCH_SPARSE;
+}
+
+// appends the table of a switch on string labels, a perfect hash: labels are spread over twice as
+// many slots, and each bucket of about four labels gets the first seed that puts all of them in
+// free slots; the table doubles whenever some bucket finds no such seed
+OpCode stringTable(std::vector<int64_t>& tables, const std::vector<std::string_view>& labels,
+                   const std::vector<uint32_t>& constants, std::vector<size_t>& targets, std::vector<size_t>& defaults) {
+    std::vector<std::string_view> sorted(labels);
+    std::ranges::sort(sorted);
+    if (const auto duplicate = std::ranges::adjacent_find(sorted); duplicate != sorted.end()) {
+        throw std::runtime_error("Duplicate case label: \"" + std::string(*duplicate) + "\"");
+    }
+
+    constexpr uint64_t seedLimit = 1 << 12;
+    const size_t count = labels.size();
+    std::vector<uint64_t> hashes(count);
+    std::ranges::transform(labels, hashes.begin(), caseHash);
+    const size_t firstSize = std::bit_ceil(2 * count);
+
+    for (size_t size = firstSize; size <= 16 * firstSize; size *= 2) {
+        const size_t bucketCount = std::max<size_t>(size / 8, 1);
+        std::vector<std::vector<size_t>> buckets(bucketCount);
+        for (size_t i = 0; i < count; ++i) {
+            buckets[(hashes[i] >> 32) & (bucketCount - 1)].push_back(i);
+        }
+        // the fullest buckets go first, while most slots are still free
+        std::vector<size_t> order(bucketCount);
+        for (size_t i = 0; i < bucketCount; ++i) {
+            order[i] = i;
+        }
+        std::ranges::stable_sort(order, std::greater(), [&](const size_t bucket) { return buckets[bucket].size(); });
+
+        std::vector<int64_t> seeds(bucketCount, 0);
+        std::vector<int64_t> slots(size, -1);   // label index in each slot
+        std::vector<size_t> taken;
+        bool placed = true;
+        for (const size_t bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            uint64_t seed = 0;
+            for (; seed < seedLimit; ++seed) {
+                taken.clear();
+                for (const size_t label : buckets[bucket]) {
+                    const size_t slot = caseSlot(hashes[label], seed) & (size - 1);
+                    if (slots[slot] != -1 || std::ranges::find(taken, slot) != taken.end()) {
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+                if (taken.size() == buckets[bucket].size()) {
+                    break;
+                }
+            }
+            if (seed == seedLimit) {
+                placed = false;
+                break;
+            }
+            seeds[bucket] = static_cast<int64_t>(seed);
+            for (size_t i = 0; i < taken.size(); ++i) {
+                slots[taken[i]] = static_cast<int64_t>(buckets[bucket][i]);
+            }
+        }
+        if (!placed) {
+            continue;
+        }
+
+        const size_t start = tables.size();
+        defaults.push_back(start);
+        tables.insert(tables.end(), {0, static_cast<int64_t>(bucketCount - 1), static_cast<int64_t>(size - 1)});
+        tables.insert(tables.end(), seeds.begin(), seeds.end());
+        const size_t first = tables.size();
+        targets.resize(targets.size() + count);
+        for (size_t slot = 0; slot < size; ++slot) {
+            if (slots[slot] == -1) {
+                tables.insert(tables.end(), {-1, 0});
+                continue;
+            }
+            const auto label = static_cast<size_t>(slots[slot]);
+            tables.insert(tables.end(), {constants[label], 0});
+            targets[targets.size() - count + label] = first + 2 * slot + 1;
+        }
+        return OP_SWITCH_STRING;
+    }
+    throw std::runtime_error("Cannot build a hash table for the case labels");
+}
+
+}
+
+uint64_t caseHash(const std::string_view text) {
+    return hashBytes(text.data(), text.size());
+}
+
+std::string opCodeToString(const OpCode op) {
+    switch (op) {
+    case OP_CONSTANT: return "OP_CONSTANT";
+    case OP_TRUE: return "OP_TRUE";
+    case OP_FALSE: return "OP_FALSE";
+    case OP_POP: return "OP_POP";
+    case OP_DUP: return "OP_DUP";
+    case OP_LOAD_LOCAL: return "OP_LOAD_LOCAL";
+    case OP_STORE_LOCAL: return "OP_STORE_LOCAL";
+    case OP_LOAD_GLOBAL: return "OP_LOAD_GLOBAL";
+    case OP_STORE_GLOBAL: return "OP_STORE_GLOBAL";
+    case OP_ADD: return "OP_ADD";
+    case OP_SUBTRACT: return "OP_SUBTRACT";
+    case OP_MULTIPLY: return "OP_MULTIPLY";
+    case OP_DIVIDE: return "OP_DIVIDE";
+    case OP_MODULUS: return "OP_MODULUS";
+    case OP_EQUAL: return "OP_EQUAL";
+    case OP_NOT_EQUAL: return "OP_NOT_EQUAL";
+    case OP_GREATER: return "OP_GREATER";
+    case OP_LESS: return "OP_LESS";
+    case OP_GREATER_EQUAL: return "OP_GREATER_EQUAL";
+    case OP_LESS_EQUAL: return "OP_LESS_EQUAL";
+    case OP_BITWISE_AND: return "OP_BITWISE_AND";
+    case OP_BITWISE_OR: return "OP_BITWISE_OR";
+    case OP_BITWISE_XOR: return "OP_BITWISE_XOR";
+    case OP_LEFT_SHIFT: return "OP_LEFT_SHIFT";
+    case OP_RIGHT_SHIFT: return "OP_RIGHT_SHIFT";
+    case OP_ADD_INTEGER: return "OP_ADD_INTEGER";
+    case OP_SUBTRACT_INTEGER: return "OP_SUBTRACT_INTEGER";
+    case OP_MULTIPLY_INTEGER: return "OP_MULTIPLY_INTEGER";
+    case OP_DIVIDE_INTEGER: return "OP_DIVIDE_INTEGER";
+    case OP_MODULUS_INTEGER: return "OP_MODULUS_INTEGER";
+    case OP_EQUAL_INTEGER: return "OP_EQUAL_INTEGER";
+    case OP_NOT_EQUAL_INTEGER: return "OP_NOT_EQUAL_INTEGER";
+    case OP_GREATER_INTEGER: return "OP_GREATER_INTEGER";
+    case OP_LESS_INTEGER: return "OP_LESS_INTEGER";
+    case OP_GREATER_EQUAL_INTEGER: return "OP_GREATER_EQUAL_INTEGER";
+    case OP_LESS_EQUAL_INTEGER: return "OP_LESS_EQUAL_INTEGER";
+    case OP_ADD_FLOAT: return "OP_ADD_FLOAT";
+    case OP_SUBTRACT_FLOAT: return "OP_SUBTRACT_FLOAT";
+    case OP_MULTIPLY_FLOAT: return "OP_MULTIPLY_FLOAT";
+    case OP_DIVIDE_FLOAT: return "OP_DIVIDE_FLOAT";
+    case OP_GREATER_FLOAT: return "OP_GREATER_FLOAT";
+    case OP_LESS_FLOAT: return "OP_LESS_FLOAT";
+    case OP_GREATER_EQUAL_FLOAT: return "OP_GREATER_EQUAL_FLOAT";
+    case OP_LESS_EQUAL_FLOAT: return "OP_LESS_EQUAL_FLOAT";
+    case OP_TO_BOOLEAN: return "OP_TO_BOOLEAN";
+    case OP_CHECK_TYPE: return "OP_CHECK_TYPE";
+    case OP_JUMP: return "OP_JUMP";
+    case OP_JUMP_IF_FALSE: return "OP_JUMP_IF_FALSE";
+    case OP_JUMP_IF_FALSE_BOOLEAN: return "OP_JUMP_IF_FALSE_BOOLEAN";
+    case OP_JUMP_IF_FALSE_OR_POP: return "OP_JUMP_IF_FALSE_OR_POP";
+    case OP_JUMP_IF_TRUE_OR_POP: return "OP_JUMP_IF_TRUE_OR_POP";
+    case OP_SWITCH_DENSE: return "OP_SWITCH_DENSE";
+    case OP_SWITCH_SPARSE: return "OP_SWITCH_SPARSE";
+    case OP_SWITCH_STRING: return "OP_SWITCH_STRING";
+    case OP_RETURN: return "OP_RETURN";
+    case OP_HALT: return "OP_HALT";
+    default: return "UNIMPLEMENTED";
+    }
+}
+
+std::string disassemble(const ProgramView& program) {
+    std::string out;
+    for (size_t i = 0; i < program.code.size(); ++i) {
+        const Instruction& instruction = program.code[i];
+        out += std::to_string(i) + "\t" + opCodeToString(instruction.op) + " " + std::to_string(instruction.operand) + "\n";
+    }
+    return out;
+}
+
+size_t Compiler::emit(const OpCode op, const uint32_t operand) {
+    program.code.push_back({op, operand});
+    stackDepth = static_cast<uint32_t>(static_cast<int>(stackDepth) + stackEffect(op));
+    program.maxStack = std::max(program.maxStack, stackDepth);
+    return program.code.size() - 1;
+}
+
+void Compiler::patchJump(const size_t index) {
+    program.code[index].operand = here();
+}
+
+uint32_t Compiler::addNumber(const uint32_t id) {
+    uint32_t& constant = numberConstants[id];
+    if (constant == UINT32_MAX) {
+        constant = static_cast<uint32_t>(program.constants.size());
+        const Number& number = result->numbers[id];
+        if (number.kind == NUMBER_FLOAT) {
+            program.constants.push_back(Value::fromFloat(number.real));
+        } else if (Value::fitsInline(number.integer)) {
+            program.constants.push_back(Value::fromNumber(number.integer));
+        } else {
+            program.integers.push_back(number.integer);
+            program.constants.push_back(Value::fromWideNumber(static_cast<uint32_t>(program.integers.size() - 1)));
+        }
+    }
+    return constant;
+}
+
+uint32_t Compiler::addString(const std::string_view value) {
+    const auto [it, inserted] = stringConstants.try_emplace(value, static_cast<uint32_t>(program.constants.size()));
+    if (inserted && value.size() <= Value::shortStringSize) {
+        program.constants.push_back(Value::fromShortString(value));
+    } else if (inserted) {
+        program.chars.append(value);
+        program.stringEnds.push_back(static_cast<uint32_t>(program.chars.size()));
+        program.constants.push_back(Value::fromString(static_cast<uint32_t>(program.stringEnds.size() - 1)));
+    }
+    return it->second;
+}
+
+void Compiler::emitLoad(const VariableNode* variable) {
+    switch (variable->scope) {
+    case SCOPE_LOCAL:
+        emit(OP_LOAD_LOCAL, variable->slot);
+        break;
+    case SCOPE_GLOBAL:
+        emit(OP_LOAD_GLOBAL, variable->slot);
+        break;
+    default:
+        throw std::runtime_error("Unresolved variable: " + std::string(variable->name));
+    }
+}
+
+void Compiler::emitStore(const ASTNode* target, const StaticType value) {
+    const auto* variable = target->as<VariableNode>();
+    if (variable == nullptr) {
+        throw std::runtime_error("Only variables can be assigned to");
+    }
+    if (!fitsDeclared(value, variable->declared)) {
+        emit(OP_CHECK_TYPE, variable->declared);
+    }
+    switch (variable->scope) {
+    case SCOPE_LOCAL:
+        emit(OP_STORE_LOCAL, variable->slot);
+        break;
+    case SCOPE_GLOBAL:
+        emit(OP_STORE_GLOBAL, variable->slot);
+        break;
+    default:
+        throw std::runtime_error("Unresolved variable: " + std::string(variable->name));
+    }
+}
+
+void Compiler::compileBlock(const ASTNode* node) {
+    if (const auto* block = node->as<BlockStatementNode>()) {
+        for (const ASTNode* statement : block->statements) {
+            compileStatement(statement);
+        }
+    } else {
+        compileStatement(node);
+    }
+}
+
+size_t Compiler::emitJumpIfFalse(const ASTNode* condition) {
+    compileExpression(condition);
+    return emit(typeOf(condition, *result) == TYPE_BOOLEAN ? OP_JUMP_IF_FALSE_BOOLEAN : OP_JUMP_IF_FALSE);
+}
+
+void Compiler::compileIf(const IfStatementNode* node) {
+    std::vector<size_t> exits;
+
+    size_t next = emitJumpIfFalse(node->condition);
+    compileBlock(node->body);
+
+    for (const ASTNode* branch : node->elseifBodies) {
+        const auto* elseif = static_cast<const ElseIfStatementNode*>(branch);
+        exits.push_back(emit(OP_JUMP));
+        patchJump(next);
+        next = emitJumpIfFalse(elseif->condition);
+        compileBlock(elseif->body);
+    }
+
+    if (node->elseBody != nullptr) {
+        exits.push_back(emit(OP_JUMP));
+        patchJump(next);
+        compileBlock(node->elseBody);
+    } else {
+        patchJump(next);
+    }
+
+    for (const size_t exit : exits) {
+        patchJump(exit);
+    }
+}
+
+void Compiler::compileWhile(const WhileStatementNode* node) {
+    loops.push_back({here(), {}});
+
+    // while (true) needs no test, it only ends through break or return
+    const auto* literal = node->condition->as<LiteralNode>();
+    const bool alwaysTrue = literal != nullptr && literal->type == LITERAL_TRUE;
+    size_t exit = 0;
+    if (!alwaysTrue) {
+        exit = emitJumpIfFalse(node->condition);
+    }
+    compileBlock(node->body);
+    emit(OP_JUMP, static_cast<uint32_t>(loops.back().start));
+
+    if (!alwaysTrue) {
+        patchJump(exit);
+    }
+    for (const size_t jump : loops.back().breaks) {
+        patchJump(jump);
+    }
+    loops.pop_back();
+}
+
+void Compiler::compileSwitch(const SwitchStatementNode* node) {
+    compileExpression(node->value);
+
+    // the table goes in before the bodies, so the tables of switches nested in them come after it
+    std::vector<size_t> targets;
+    std::vector<size_t> defaults;
+    if (node->cases.empty()) {
+        emit(OP_POP);
+    } else {
+        const auto table = static_cast<uint32_t>(program.jumpTables.size());
+        const LiteralType kind = static_cast<const SwitchCaseNode*>(node->cases[0])->label->type;
+        const auto invalid = [] { return std::runtime_error("Case labels must be all integers or all strings"); };
+        if (kind != LITERAL_NUMBER && kind != LITERAL_STRING) {
+            throw invalid();
+        }
+        std::vector<int64_t> integers;
+        std::vector<std::string_view> strings;
+        std::vector<uint32_t> constants;
+        for (const ASTNode* item : node->cases) {
+            const LiteralNode* label = static_cast<const SwitchCaseNode*>(item)->label;
+            if (label->type != kind) {
+                throw invalid();
+            }
+            if (kind == LITERAL_STRING) {
+                strings.push_back(static_cast<const StringNode*>(label->value)->value);
+                constants.push_back(addString(strings.back()));
+                continue;
+            }
+            const Number& number = result->numbers[static_cast<const NumberNode*>(label->value)->constant];
+            if (number.kind != NUMBER_INTEGER) {
+                throw invalid();
+            }
+            integers.push_back(number.integer);
+        }
+        const OpCode op = kind == LITERAL_STRING
+                              ? stringTable(program.jumpTables, strings, constants, targets, defaults)
+                              : integerTable(program.jumpTables, integers, targets, defaults);
+        emit(op, table);
+    }
+
+    // no case falls through, each one but the last jumps to the end
+    loops.push_back({here(), {}, true});
+    for (size_t i = 0; i < node->cases.size(); ++i) {
+        program.jumpTables[targets[i]] = here();
+        compileBlock(static_cast<const SwitchCaseNode*>(node->cases[i])->body);
+        if (i + 1 < node->cases.size() || node->defaultBody != nullptr) {
+            loops.back().breaks.push_back(emit(OP_JUMP));
+        }
+    }
+    for (const size_t entry : defaults) {
+        program.jumpTables[entry] = here();
+    }
+    if (node->defaultBody != nullptr) {
+        compileBlock(node->defaultBody);
+    }
+    for (const size_t jump : loops.back().breaks) {
+        patchJump(jump);
+    }
+    loops.pop_back();
+}
+
+void Compiler::compileStatement(const ASTNode* node) {
+    switch (node->kind) {
+    case STATEMENT_EMPTY:
+        break;
+
+    case STATEMENT_BLOCK:
+        compileBlock(node);
+        break;
+
+    case STATEMENT_VARIABLE_DECLARATION: {
+        const auto* declaration = static_cast<const VariableDeclarationStatementNode*>(node);
+        compileExpression(declaration->value);
+        emitStore(declaration->variable, typeOf(declaration->value, *result));
+        break;
+    }
+
+    case STATEMENT_GLOBAL_DECLARATION: {
+        const auto* declaration = static_cast<const GlobalDeclarationStatementNode*>(node);
+        compileExpression(declaration->value);
+        emitStore(declaration->variable, typeOf(declaration->value, *result));
+        break;
+    }
+
+    case STATEMENT_ASSIGNMENT: {
+        const auto* assignment = static_cast<const AssignmentStatementNode*>(node);
+        compileExpression(assignment->value);
+        emitStore(assignment->variable, typeOf(assignment->value, *result));
+        break;
+    }
+
+    case STATEMENT_IF:
+        compileIf(static_cast<const IfStatementNode*>(node));
+        break;
+
+    case STATEMENT_WHILE:
+        compileWhile(static_cast<const WhileStatementNode*>(node));
+        break;
+
+    case STATEMENT_SWITCH:
+        compileSwitch(static_cast<const SwitchStatementNode*>(node));
+        break;
+
+    case STATEMENT_BREAK:
+        if (loops.empty()) {
+            throw std::runtime_error("break outside of a loop or switch");
+        }
+        loops.back().breaks.push_back(emit(OP_JUMP));
+        break;
+
+    case STATEMENT_CONTINUE: {
+        const auto loop = std::ranges::find(loops.rbegin(), loops.rend(), false, &Loop::isSwitch);
+        if (loop == loops.rend()) {
+            throw std::runtime_error("continue outside of a loop");
+        }
+        emit(OP_JUMP, static_cast<uint32_t>(loop->start));
+        break;
+    }
+
+    case STATEMENT_RETURN: {
+        const auto* statement = static_cast<const ReturnStatementNode*>(node);
+        if (statement->expressions == nullptr) {
+            emit(OP_HALT);
+        } else {
+            compileExpression(statement->expressions);
+            emit(OP_RETURN);
+        }
+        break;
+    }
+
+    case STATEMENT_FUNCTION_CALL:
+        throw std::runtime_error("Function calls are not supported yet");
+
+    default:
+        // expression statement, its value is thrown away
+        compileExpression(node);
+        emit(OP_POP);
+        break;
+    }
+}
+
+void Compiler::compileLiteral(const LiteralNode* node) {
+    switch (node->type) {
+    case LITERAL_NUMBER:
+        emit(OP_CONSTANT, addNumber(static_cast<const NumberNode*>(node->value)->constant));
+        break;
+    case LITERAL_STRING:
+        emit(OP_CONSTANT, addString(static_cast<const StringNode*>(node->value)->value));
+        break;
+    case LITERAL_TRUE:
+        emit(OP_TRUE);
+        break;
+    case LITERAL_FALSE:
+        emit(OP_FALSE);
+        break;
+    }
+}
+
+void Compiler::compileBinary(const BinaryOperationNode* node) {
+    switch (node->operation) {
+    case TOK_AND: {
+        compileExpression(node->left);
+        const size_t end = emit(OP_JUMP_IF_FALSE_OR_POP);
+        compileExpression(node->right);
+        if (typeOf(node->right, *result) != TYPE_BOOLEAN) {
+            emit(OP_TO_BOOLEAN);
+        }
+        patchJump(end);
+        return;
+    }
+
+    case TOK_OR: {
+        compileExpression(node->left);
+        const size_t end = emit(OP_JUMP_IF_TRUE_OR_POP);
+        compileExpression(node->right);
+        if (typeOf(node->right, *result) != TYPE_BOOLEAN) {
+            emit(OP_TO_BOOLEAN);
+        }
+        patchJump(end);
+        return;
+    }
+
+    case TOK_ASSIGNMENT:
+        // assignments inside expressions leave the assigned value behind
+        compileExpression(node->right);
+        emit(OP_DUP);
+        emitStore(node->left, node->type);
+        return;
+
+    case TOK_ADDITION_ASSIGNMENT:
+    case TOK_SUBTRACTION_ASSIGNMENT:
+    case TOK_MULTIPLICATION_ASSIGNMENT:
+    case TOK_DIVISION_ASSIGNMENT:
+    case TOK_MODULUS_ASSIGNMENT:
+        compileExpression(node->left);
+        compileExpression(node->right);
+        emit(specialize(binaryOpCode(node->operation), typeOf(node->left, *result), typeOf(node->right, *result)));
+        emit(OP_DUP);
+        emitStore(node->left, node->type);
+        return;
+
+    default:
+        compileExpression(node->left);
+        compileExpression(node->right);
+        emit(specialize(binaryOpCode(node->operation), typeOf(node->left, *result), typeOf(node->right, *result)));
+        return;
+    }
+}
+
+void Compiler::compileExpression(const ASTNode* node) {
+    switch (node->kind) {
+    case NODE_LITERAL:
+        compileLiteral(static_cast<const LiteralNode*>(node));
+        break;
+
+    case NODE_VARIABLE:
+        emitLoad(static_cast<const VariableNode*>(node));
+        break;
+
+    case EXPRESSION_BINARY_OPERATION:
+        compileBinary(static_cast<const BinaryOperationNode*>(node));
+        break;
+
+    case EXPRESSION_MEMBER_ACCESS:
+    case EXPRESSION_FUNCTION_CALL:
+        throw std::runtime_error("Member access and function calls are not supported yet");
+
+    default:
+        throw std::runtime_error("Unexpected node in expression: " + std::to_string(node->kind));
+    }
+}
+
+Program Compiler::compile(const ParseResult& result) {
+    if (!result.resolved) {
+        throw std::runtime_error("Program has not been resolved");
+    }
+    if (!result.typed) {
+        throw std::runtime_error("Program has not been type checked");
+    }
+
+    program = Program();
+    program.localCount = result.localCount;
+    program.globalCount = result.globalCount;
+    this->result = &result;
+    numberConstants.assign(result.numbers.size(), UINT32_MAX);
+    stringConstants.clear();
+    loops.clear();
+    stackDepth = 0;
+
+    for (const ASTNode* statement : result.statements) {
+        compileBlock(statement);
+    }
+    emit(OP_HALT);
+    return std::move(program);
+}
@@ -0,0 +1,195 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "parser.h"
+#include "value.h"
+
+// stack effects are noted as (popped -> pushed)
+enum OpCode : uint8_t {
+    OP_CONSTANT,              // (-> constants[operand])
+    OP_TRUE,                  // (-> true)
+    OP_FALSE,                 // (-> false)
+    OP_POP,                   // (a ->)
+    OP_DUP,                   // (a -> a a)
+    OP_LOAD_LOCAL,            // (-> locals[operand])
+    OP_STORE_LOCAL,           // (a ->) locals[operand] = a
+    OP_LOAD_GLOBAL,           // (-> globals[operand])
+    OP_STORE_GLOBAL,          // (a ->) globals[operand] = a
+
+    // binary operators (a b -> a op b)
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULUS,
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_GREATER,
+    OP_LESS,
+    OP_GREATER_EQUAL,
+    OP_LESS_EQUAL,
+    OP_BITWISE_AND,
+    OP_BITWISE_OR,
+    OP_BITWISE_XOR,
+    OP_LEFT_SHIFT,
+    OP_RIGHT_SHIFT,
+
+    // the same operators for two integers or two floats, emitted where checkTypes() proved the
+    // operand types, so the vm skips the type checks and writes results in place
+    OP_ADD_INTEGER,
+    OP_SUBTRACT_INTEGER,
+    OP_MULTIPLY_INTEGER,
+    OP_DIVIDE_INTEGER,
+    OP_MODULUS_INTEGER,
+    OP_EQUAL_INTEGER,
+    OP_NOT_EQUAL_INTEGER,
+    OP_GREATER_INTEGER,
+    OP_LESS_INTEGER,
+    OP_GREATER_EQUAL_INTEGER,
+    OP_LESS_EQUAL_INTEGER,
+    OP_ADD_FLOAT,
+    OP_SUBTRACT_FLOAT,
+    OP_MULTIPLY_FLOAT,
+    OP_DIVIDE_FLOAT,
+    OP_GREATER_FLOAT,
+    OP_LESS_FLOAT,
+    OP_GREATER_EQUAL_FLOAT,
+    OP_LESS_EQUAL_FLOAT,
+
+    OP_TO_BOOLEAN,            // (a -> truthiness of a)
+    OP_CHECK_TYPE,            // (a -> a) throws unless a fits the VariableType in operand
+    OP_JUMP,                  // ip = operand
+    OP_JUMP_IF_FALSE,         // (a ->) jumps when a is falsy
+    OP_JUMP_IF_FALSE_BOOLEAN, // (a ->) jumps when a is false, a is known to be a boolean
+    OP_JUMP_IF_FALSE_OR_POP,  // falsy a is replaced by false and jumps, otherwise a is popped (for &&)
+    OP_JUMP_IF_TRUE_OR_POP,   // truthy a is replaced by true and jumps, otherwise a is popped (for ||)
+
+    // (a ->) jump to the case a matches, through the table at jumpTables[operand], or to its default;
+    // integer labels also match floats of the same value, like ==
+    OP_SWITCH_DENSE,          // default, lowest label, count, then the targets of lowest label + i
+    OP_SWITCH_SPARSE,         // default, count, then count labels in ascending order and their targets
+    OP_SWITCH_STRING,         // default, bucket mask, slot mask, a seed per bucket, then the slots,
+                              // each the constant index of its label (-1 when empty) and its target
+    OP_RETURN,                // (a ->) ends the program with a
+    OP_HALT,                  // ends the program without a value
+
+    OP_COUNT
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t operand;
+};
+
+// hash of a string case label or of a value looked up in an OP_SWITCH_STRING table
+[[nodiscard]] uint64_t caseHash(std::string_view text);
+
+// a bucket of the table is picked by the hash and its seed spreads the bucket's labels over slots
+// without collisions, so a lookup compares against at most one label
+[[nodiscard]] inline uint64_t caseSlot(uint64_t hash, const uint64_t seed) {
+    hash ^= seed * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// read only view of a compiled program, over a Program or over a cache entry mapped from disk
+struct ProgramView {
+    std::span<const Instruction> code;
+    std::span<const Value> constants;
+    std::span<const int64_t> integers;      // wide integer constants index these
+    std::span<const int64_t> jumpTables;    // switch instructions index these
+    std::span<const uint32_t> stringEnds;   // string i is chars[stringEnds[i - 1], stringEnds[i])
+    std::string_view chars;
+    uint32_t localCount = 0;
+    uint32_t globalCount = 0;
+    uint32_t maxStack = 0;
+
+    [[nodiscard]] std::string_view string(const uint32_t index) const {
+        const uint32_t start = index == 0 ? 0 : stringEnds[index - 1];
+        return chars.substr(start, stringEnds[index] - start);
+    }
+};
+
+// compiled program, everything the vm needs to run it
+// every member is an array of trivially copyable values (like FlatAST), so it can be written out
+// as it is and used again straight from a mapping, see ScriptCache
+class Program {
+public:
+    std::vector<Instruction> code;
+    std::vector<Value> constants;
+    std::vector<int64_t> integers;      // integer constants too wide to store in a Value
+    std::vector<int64_t> jumpTables;    // tables of the switch instructions, one after the other
+    std::vector<uint32_t> stringEnds;   // string constants too long to store inline index these
+    std::string chars;
+    uint32_t localCount = 0;
+    uint32_t globalCount = 0;
+    uint32_t maxStack = 0;               // deepest the value stack gets
+
+    [[nodiscard]] ProgramView view() const {
+        return {code, constants, integers, jumpTables, stringEnds, chars, localCount, globalCount, maxStack};
+    }
+};
+
+std::string opCodeToString(OpCode op);
+// one instruction per line, for debugging
+std::string disassemble(const ProgramView& program);
+
+// lowers a parsed program into bytecode
+class Compiler {
+private:
+    // a loop or a switch, break leaves the innermost one and continue goes to the innermost loop
+    struct Loop {
+        size_t start;
+        std::vector<size_t> breaks;
+        bool isSwitch = false;
+    };
+
+    Program program;
+    const ParseResult* result = nullptr;
+    // constant index of each entry of the number pool, the pool already holds every value once
+    std::vector<uint32_t> numberConstants;
+    std::unordered_map<std::string_view, uint32_t> stringConstants;
+    std::vector<Loop> loops;
+    uint32_t stackDepth = 0;
+
+    size_t emit(OpCode op, uint32_t operand = 0);
+    // points the jump at index to the next instruction
+    void patchJump(size_t index);
+    [[nodiscard]] uint32_t here() const { return static_cast<uint32_t>(program.code.size()); }
+
+    // constant index of the pool entry id
+    uint32_t addNumber(uint32_t id);
+    uint32_t addString(std::string_view value);
+
+    void emitLoad(const VariableNode* variable);
+    // value is the type of the value being stored, a declared variable checks values that may not fit
+    void emitStore(const ASTNode* target, StaticType value);
+    // compiles condition and a jump taken when it is false, returns the jump
+    size_t emitJumpIfFalse(const ASTNode* condition);
+
+    void compileStatement(const ASTNode* node);
+    void compileBlock(const ASTNode* node);
+    void compileIf(const IfStatementNode* node);
+    void compileWhile(const WhileStatementNode* node);
+    void compileSwitch(const SwitchStatementNode* node);
+    void compileExpression(const ASTNode* node);
+    void compileLiteral(const LiteralNode* node);
+    void compileBinary(const BinaryOperationNode* node);
+
+public:
+    // the result must have gone through resolve() and checkTypes()
+    Program compile(const ParseResult& result);
+};
+
+#endif //COMPILER_H
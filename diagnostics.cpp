@@ -0,0 +1,74 @@
+#include "diagnostics.h"
+
+std::string Diagnostics::message(const Diagnostic& diagnostic, const std::string_view source) {
+    const auto found = static_cast<TokenType>(diagnostic.found);
+    std::string message;
+    switch (diagnostic.code) {
+    case DIAG_UNEXPECTED_TOKEN:
+        message = found == TOK_EOF ? "Unexpected end of file" : "Unexpected token: " + tokenTypeToString(found);
+        message += ", expected: " + tokenTypeToString(static_cast<TokenType>(diagnostic.expected));
+        break;
+    case DIAG_EXPECTED_EXPRESSION:
+        message = found == TOK_EOF ? "Unexpected end of file" : "Unexpected token: " + tokenTypeToString(found);
+        message += ", expected an expression";
+        break;
+    case DIAG_EXPECTED_STATEMENT:
+        message = "Unexpected token: " + tokenTypeToString(found) + ", expected a statement";
+        break;
+    case DIAG_INVALID_NUMBER:
+        message = "Invalid number";
+        break;
+    case DIAG_INVALID_ESCAPE:
+        message = "Invalid escape sequence";
+        break;
+    case DIAG_UNMATCHED_BRACE:
+        message = "Unmatched '}'";
+        break;
+    case DIAG_INVALID_CASE_LABEL:
+        message = "Case labels must be all integer or all string literals";
+        break;
+    case DIAG_DUPLICATE_DEFAULT:
+        message = "Switch already has a default";
+        break;
+    case DIAG_CASE_OUTSIDE_SWITCH:
+        message = tokenTypeToString(found) + " outside of a switch";
+        break;
+    case DIAG_NOT_IMPLEMENTED:
+        message = tokenTypeToString(found) + " is not implemented";
+        break;
+    case DIAG_NESTING_TOO_DEEP:
+        message = "Nesting too deep";
+        break;
+    }
+
+    if (diagnostic.offset + diagnostic.length <= source.size() && diagnostic.length > 0) {
+        message += " | String: ";
+        message += source.substr(diagnostic.offset, diagnostic.length);
+    }
+    return message;
+}
+
+std::string Diagnostics::format(const Diagnostic& diagnostic, const std::string_view source) {
+    return message(diagnostic, source) + " Position: " + std::to_string(diagnostic.offset);
+}
+
+std::string Diagnostics::formatAll(const std::string_view source, const std::string_view prefix) const {
+    std::string out;
+    for (const Diagnostic& diagnostic : records) {
+        out += prefix;
+        out += format(diagnostic, source);
+        out += '\n';
+    }
+    return out;
+}
+
+std::string Diagnostics::formatAll(const SourceManager& sources, const uint32_t file) const {
+    std::string out;
+    for (const Diagnostic& diagnostic : records) {
+        out += sources.describe(sources.location(file, diagnostic.offset));
+        out += ": ";
+        out += message(diagnostic, sources.text(file));
+        out += '\n';
+    }
+    return out;
+}
@@ -0,0 +1,66 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sourceloc.h"
+#include "tokenize.h"
+
+enum DiagnosticCode : uint8_t {
+    DIAG_UNEXPECTED_TOKEN,      // found where expected had to be
+    DIAG_EXPECTED_EXPRESSION,   // found cannot start an expression
+    DIAG_EXPECTED_STATEMENT,    // found cannot start a statement
+    DIAG_INVALID_NUMBER,        // a number literal the lexer could not decode
+    DIAG_INVALID_ESCAPE,        // a backslash in a string literal followed by something that is no escape
+    DIAG_UNMATCHED_BRACE,       // a '}' with no block to close
+    DIAG_INVALID_CASE_LABEL,    // a case label that is no integer or string literal, or not of the kind of the first one
+    DIAG_DUPLICATE_DEFAULT,     // a second default in one switch
+    DIAG_CASE_OUTSIDE_SWITCH,   // a case or default that is not directly inside a switch
+    DIAG_NOT_IMPLEMENTED,       // syntax the parser knows about but does not support yet (for loops)
+    DIAG_NESTING_TOO_DEEP       // a body or bracket past Parser::limitNesting()
+};
+
+// one problem found while parsing, kept as plain data and only turned into text on request
+// token is the index in the whole token stream, offset and length locate its text in the source
+// (SourceManager::location() turns offset into a SourceLoc)
+struct Diagnostic {
+    DiagnosticCode code;
+    uint8_t expected;   // TokenType, for DIAG_UNEXPECTED_TOKEN
+    uint8_t found;      // TokenType of the offending token
+    uint32_t token;
+    uint32_t offset;
+    uint32_t length;
+};
+
+static_assert(sizeof(Diagnostic) == 16, "diagnostics stay small enough to collect thousands cheaply");
+
+// every diagnostic of one parse, in source order
+class Diagnostics {
+private:
+    std::vector<Diagnostic> records;
+
+public:
+    void report(const Diagnostic& diagnostic) { records.push_back(diagnostic); }
+    void clear() { records.clear(); }
+
+    [[nodiscard]] bool empty() const { return records.empty(); }
+    [[nodiscard]] size_t size() const { return records.size(); }
+    [[nodiscard]] const Diagnostic& operator[](const size_t index) const { return records[index]; }
+    [[nodiscard]] const Diagnostic& back() const { return records.back(); }
+    [[nodiscard]] std::vector<Diagnostic>::const_iterator begin() const { return records.begin(); }
+    [[nodiscard]] std::vector<Diagnostic>::const_iterator end() const { return records.end(); }
+
+    // what went wrong, source is the text the tokens were lexed from and the token text is left out without it
+    [[nodiscard]] static std::string message(const Diagnostic& diagnostic, std::string_view source = {});
+    // the message followed by the byte offset
+    [[nodiscard]] static std::string format(const Diagnostic& diagnostic, std::string_view source = {});
+    // every diagnostic on its own line, each one prefixed with prefix
+    [[nodiscard]] std::string formatAll(std::string_view source = {}, std::string_view prefix = {}) const;
+    // every diagnostic on its own line as "name:line:column: message", file is the source the tokens came from
+    [[nodiscard]] std::string formatAll(const SourceManager& sources, uint32_t file) const;
+};
+
+#endif //DIAGNOSTICS_H
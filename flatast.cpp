@@ -0,0 +1,188 @@
+#include "flatast.h"
+
+#include <stdexcept>
+
+namespace {
+
+class Flattener {
+private:
+    FlatAST& flat;
+    // child indices of the lists being built, nested lists stack on top of each other
+    std::vector<uint32_t> scratch;
+
+    uint32_t addNode(const NodeType kind, const uint8_t op, const uint32_t lhs, const uint32_t rhs, const uint32_t payload,
+                     const uint16_t flags = 0) {
+        flat.nodes.push_back({static_cast<uint8_t>(kind), op, flags, lhs, rhs, payload});
+        return static_cast<uint32_t>(flat.nodes.size() - 1);
+    }
+
+    uint32_t addString(const std::string_view text) {
+        flat.chars.append(text);
+        flat.stringEnds.push_back(static_cast<uint32_t>(flat.chars.size()));
+        return static_cast<uint32_t>(flat.stringEnds.size() - 1);
+    }
+
+    // children are flattened first, then written out as one contiguous list
+    uint32_t addList(const NodeList& children, const ASTNode* last = nullptr) {
+        const size_t start = scratch.size();
+        for (const ASTNode* child : children) {
+            const uint32_t index = add(child);
+            scratch.push_back(index);
+        }
+        if (last != nullptr) {
+            const uint32_t index = add(last);
+            scratch.push_back(index);
+        }
+        const auto offset = static_cast<uint32_t>(flat.lists.size());
+        flat.lists.push_back(static_cast<uint32_t>(scratch.size() - start));
+        flat.lists.insert(flat.lists.end(), scratch.begin() + static_cast<ptrdiff_t>(start), scratch.end());
+        scratch.resize(start);
+        return offset;
+    }
+
+    uint32_t addOptional(const ASTNode* node) {
+        return node == nullptr ? FlatAST::none : add(node);
+    }
+
+public:
+    explicit Flattener(FlatAST& flat) : flat(flat) {}
+
+    uint32_t add(const ASTNode* node) {
+        switch (node->kind) {
+        case NODE_VARIABLE:
+            return addNode(NODE_VARIABLE, 0, FlatAST::none, FlatAST::none, addString(static_cast<const VariableNode*>(node)->name));
+
+        case NODE_LITERAL: {
+            const auto* literal = static_cast<const LiteralNode*>(node);
+            uint32_t payload = 0;
+            switch (literal->value->kind) {
+            case NODE_NUMBER:
+                payload = static_cast<const NumberNode*>(literal->value)->constant;
+                break;
+            case NODE_STRING:
+                payload = addString(static_cast<const StringNode*>(literal->value)->value);
+                break;
+            case NODE_BOOLEAN:
+                payload = static_cast<const BooleanNode*>(literal->value)->value ? 1 : 0;
+                break;
+            default:
+                throw std::runtime_error("Unexpected literal value node");
+            }
+            return addNode(NODE_LITERAL, static_cast<uint8_t>(literal->type), FlatAST::none, FlatAST::none, payload);
+        }
+
+        case EXPRESSION_FUNCTION_CALL: {
+            const auto* call = static_cast<const FunctionCallNode*>(node);
+            const uint32_t object = add(call->object);
+            return addNode(EXPRESSION_FUNCTION_CALL, 0, object, FlatAST::none, addList(call->arguments));
+        }
+
+        case EXPRESSION_MEMBER_ACCESS: {
+            const auto* access = static_cast<const MemberAccessNode*>(node);
+            const uint32_t object = add(access->object);
+            return addNode(EXPRESSION_MEMBER_ACCESS, 0, object, FlatAST::none, addString(access->member));
+        }
+
+        case EXPRESSION_BINARY_OPERATION: {
+            const auto* binary = static_cast<const BinaryOperationNode*>(node);
+            const uint32_t left = add(binary->left);
+            const uint32_t right = add(binary->right);
+            return addNode(EXPRESSION_BINARY_OPERATION, static_cast<uint8_t>(binary->operation), left, right, FlatAST::none);
+        }
+
+        case STATEMENT_BLOCK:
+            return addNode(STATEMENT_BLOCK, 0, FlatAST::none, FlatAST::none, addList(static_cast<const BlockStatementNode*>(node)->statements));
+
+        case STATEMENT_ASSIGNMENT: {
+            const auto* assignment = static_cast<const AssignmentStatementNode*>(node);
+            const uint32_t variable = add(assignment->variable);
+            const uint32_t value = add(assignment->value);
+            return addNode(STATEMENT_ASSIGNMENT, 0, variable, value, FlatAST::none);
+        }
+
+        case STATEMENT_VARIABLE_DECLARATION: {
+            const auto* declaration = static_cast<const VariableDeclarationStatementNode*>(node);
+            const uint32_t variable = add(declaration->variable);
+            const uint32_t value = add(declaration->value);
+            return addNode(STATEMENT_VARIABLE_DECLARATION, static_cast<uint8_t>(declaration->declared), variable, value, FlatAST::none);
+        }
+
+        case STATEMENT_GLOBAL_DECLARATION: {
+            const auto* declaration = static_cast<const GlobalDeclarationStatementNode*>(node);
+            const uint32_t variable = add(declaration->variable);
+            const uint32_t value = add(declaration->value);
+            return addNode(STATEMENT_GLOBAL_DECLARATION, static_cast<uint8_t>(declaration->declared), variable, value, FlatAST::none);
+        }
+
+        case STATEMENT_IF: {
+            const auto* statement = static_cast<const IfStatementNode*>(node);
+            const uint32_t condition = add(statement->condition);
+            const uint32_t body = add(statement->body);
+            const uint32_t branches = addList(statement->elseifBodies, statement->elseBody);
+            return addNode(STATEMENT_IF, 0, condition, body, branches, statement->elseBody != nullptr ? FLAT_HAS_ELSE : 0);
+        }
+
+        case STATEMENT_ELSE_IF: {
+            const auto* statement = static_cast<const ElseIfStatementNode*>(node);
+            const uint32_t condition = add(statement->condition);
+            const uint32_t body = add(statement->body);
+            return addNode(STATEMENT_ELSE_IF, 0, condition, body, FlatAST::none);
+        }
+
+        case STATEMENT_ELSE:
+            return addNode(STATEMENT_ELSE, 0, add(static_cast<const ElseStatementNode*>(node)->body), FlatAST::none, FlatAST::none);
+
+        case STATEMENT_WHILE: {
+            const auto* statement = static_cast<const WhileStatementNode*>(node);
+            const uint32_t condition = add(statement->condition);
+            const uint32_t body = add(statement->body);
+            return addNode(STATEMENT_WHILE, 0, condition, body, FlatAST::none);
+        }
+
+        case STATEMENT_SWITCH: {
+            const auto* statement = static_cast<const SwitchStatementNode*>(node);
+            const uint32_t value = add(statement->value);
+            const uint32_t cases = addList(statement->cases, statement->defaultBody);
+            return addNode(STATEMENT_SWITCH, 0, value, FlatAST::none, cases, statement->defaultBody != nullptr ? FLAT_HAS_ELSE : 0);
+        }
+
+        case STATEMENT_CASE: {
+            const auto* statement = static_cast<const SwitchCaseNode*>(node);
+            const uint32_t label = add(statement->label);
+            const uint32_t body = add(statement->body);
+            return addNode(STATEMENT_CASE, 0, label, body, FlatAST::none);
+        }
+
+        case STATEMENT_RETURN:
+            return addNode(STATEMENT_RETURN, 0, addOptional(static_cast<const ReturnStatementNode*>(node)->expressions), FlatAST::none, FlatAST::none);
+
+        case STATEMENT_FUNCTION_CALL: {
+            const auto* call = static_cast<const FunctionCallStatementNode*>(node);
+            const uint32_t object = add(call->object);
+            return addNode(STATEMENT_FUNCTION_CALL, 0, object, FlatAST::none, addList(call->arguments));
+        }
+
+        case STATEMENT_EMPTY:
+        case STATEMENT_BREAK:
+        case STATEMENT_CONTINUE:
+            return addNode(node->kind, 0, FlatAST::none, FlatAST::none, FlatAST::none);
+
+        default:
+            throw std::runtime_error("Unexpected node kind: " + std::to_string(node->kind));
+        }
+    }
+
+    void addRoot(const NodeList& statements) {
+        flat.root = addList(statements);
+    }
+};
+
+}
+
+FlatAST flatten(const ParseResult& result) {
+    FlatAST flat;
+    flat.numbers = result.numbers.values();
+    Flattener flattener(flat);
+    flattener.addRoot(result.statements);
+    return flat;
+}
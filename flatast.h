@@ -0,0 +1,72 @@
+#ifndef FLATAST_H
+#define FLATAST_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+
+// one node of a FlatAST, what lhs/rhs/payload hold depends on kind:
+//   NODE_VARIABLE                    payload = name string
+//   NODE_LITERAL                     op = LiteralType, payload = number index, string index or 0/1 for booleans
+//   EXPRESSION_FUNCTION_CALL         lhs = object, payload = argument list
+//   EXPRESSION_MEMBER_ACCESS         lhs = object, payload = member string
+//   EXPRESSION_BINARY_OPERATION      lhs, rhs, op = TokenType
+//   STATEMENT_BLOCK                  payload = statement list
+//   STATEMENT_ASSIGNMENT             lhs = variable, rhs = value
+//   STATEMENT_VARIABLE_DECLARATION   lhs = variable, rhs = value, op = VariableType (same for
+//                                    STATEMENT_GLOBAL_DECLARATION)
+//   STATEMENT_IF                     lhs = condition, rhs = body, payload = list of elseif nodes then the else body
+//                                    when flags has FLAT_HAS_ELSE
+//   STATEMENT_ELSE_IF                lhs = condition, rhs = body
+//   STATEMENT_WHILE                  lhs = condition, rhs = body
+//   STATEMENT_SWITCH                 lhs = value, payload = list of case nodes then the default body
+//                                    when flags has FLAT_HAS_ELSE
+//   STATEMENT_CASE                   lhs = label, rhs = body
+//   STATEMENT_RETURN                 lhs = expression
+// children are indices into FlatAST::nodes, lists are offsets into FlatAST::lists
+struct FlatNode {
+    uint8_t kind;
+    uint8_t op;
+    uint16_t flags;
+    uint32_t lhs;
+    uint32_t rhs;
+    uint32_t payload;
+};
+
+enum FlatNodeFlags : uint16_t {
+    FLAT_HAS_ELSE = 1 << 0,
+};
+
+// contiguous, index based copy of a parsed program
+// every member is an array of trivially copyable values, so the tree can be copied or written out
+// with one memcpy per array and stays valid wherever it is loaded
+class FlatAST {
+public:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    std::vector<FlatNode> nodes;    // children come before their parents
+    std::vector<uint32_t> lists;    // child lists, each one is a count followed by that many node indices
+    std::vector<Number> numbers;    // the program's number pool, literals index it
+    std::vector<uint32_t> stringEnds; // string i is chars[stringEnds[i - 1], stringEnds[i])
+    std::string chars;
+    uint32_t root = none;           // list of the top level statements
+
+    [[nodiscard]] NodeType kind(const uint32_t node) const { return static_cast<NodeType>(nodes[node].kind); }
+
+    [[nodiscard]] std::span<const uint32_t> list(const uint32_t offset) const {
+        return {lists.data() + offset + 1, lists[offset]};
+    }
+
+    [[nodiscard]] std::string_view string(const uint32_t index) const {
+        const uint32_t start = index == 0 ? 0 : stringEnds[index - 1];
+        return std::string_view(chars).substr(start, stringEnds[index] - start);
+    }
+};
+
+FlatAST flatten(const ParseResult& result);
+
+#endif //FLATAST_H
@@ -0,0 +1,286 @@
+#include "incremental.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr size_t none = SIZE_MAX;
+
+// tokens are lexed in small batches while looking for the point where old and new tokens line up
+constexpr size_t relexBatch = 64;
+
+// replaces target[first, last) with [from, to)
+template <class T>
+void splice(std::vector<T>& target, const size_t first, const size_t last, const T* from, const T* to) {
+    const auto count = static_cast<size_t>(to - from);
+    const size_t removed = last - first;
+    if (count > removed) {
+        target.insert(target.begin() + static_cast<ptrdiff_t>(last), count - removed, T{});
+    } else {
+        target.erase(target.begin() + static_cast<ptrdiff_t>(first + count), target.begin() + static_cast<ptrdiff_t>(last));
+    }
+    std::copy(from, to, target.begin() + static_cast<ptrdiff_t>(first));
+}
+
+uint32_t shifted(const size_t value, const ptrdiff_t shift) {
+    return static_cast<uint32_t>(static_cast<ptrdiff_t>(value) + shift);
+}
+
+}
+
+Document::Document(std::string source) : text(std::move(source)) {
+    lexed = tokenize(text);
+    relexed = lexed.size();
+    reparsed = lexed.size();
+    parseAll();
+}
+
+std::vector<std::unique_ptr<Document::Block>> Document::buildBlocks(std::vector<BlockSpan>& spans) {
+    // spans come children first, so the blocks on the stack that fit inside a span are its children
+    std::vector<std::unique_ptr<Block>> stack;
+    for (BlockSpan& span : spans) {
+        auto block = std::make_unique<Block>(Block{span.block, span.first, span.end, std::move(span.starts), nullptr, {}});
+        size_t firstChild = stack.size();
+        while (firstChild > 0 && stack[firstChild - 1]->first >= block->first && stack[firstChild - 1]->end <= block->end) {
+            --firstChild;
+        }
+        for (size_t i = firstChild; i < stack.size(); ++i) {
+            stack[i]->parent = block.get();
+            block->children.push_back(std::move(stack[i]));
+        }
+        stack.resize(firstChild);
+        stack.push_back(std::move(block));
+    }
+    return stack;
+}
+
+void Document::shiftBlocks(Block& block, const uint32_t from, const ptrdiff_t shift) {
+    if (block.end < from) {
+        return;
+    }
+    if (block.first >= from) {
+        block.first = shifted(block.first, shift);
+    }
+    block.end = shifted(block.end, shift);
+    for (uint32_t& start : block.starts) {
+        if (start >= from) {
+            start = shifted(start, shift);
+        }
+    }
+    for (const std::unique_ptr<Block>& child : block.children) {
+        shiftBlocks(*child, from, shift);
+    }
+}
+
+void Document::parseAll() {
+    parsed = false;
+    root.reset();
+    tree = ParseResult();
+
+    std::vector<BlockSpan> spans;
+    Parser parser(lexed);
+    parser.recordSpans(&spans);
+    tree = parser.parse();
+
+    // parse() puts the whole program in one top level block
+    std::vector<std::unique_ptr<Block>> blocks = buildBlocks(spans);
+    if (tree.statements.size() == 1 && blocks.size() == 1 && blocks[0]->node == tree.statements[0]) {
+        root = std::move(blocks[0]);
+    }
+    compactAt = std::max<size_t>(4 * tree.arena.bytesReserved(), 1024 * 1024);
+    // with syntax errors the layouts do not match the tokens, the next edit parses everything again
+    parsed = !tree.hasErrors();
+}
+
+void Document::relex(const TextEdit& edit, size_t& first, size_t& oldEnd, size_t& newCount) {
+    const std::vector<uint32_t>& offsets = lexed.offsets;
+
+    // the last token starting in front of the edit may grow into it, and so may every token touching
+    // the one behind it ("2." becomes one number when a digit follows), so lexing restarts at the first
+    // token after whitespace or a comment (lexing from there does not depend on anything before it)
+    const auto before = std::ranges::lower_bound(offsets, static_cast<uint32_t>(edit.offset));
+    first = before == offsets.begin() ? 0 : static_cast<size_t>(before - offsets.begin()) - 1;
+    while (first > 0 && offsets[first - 1] + lexed.lengths[first - 1] == offsets[first]) {
+        --first;
+    }
+    const size_t restart = before == offsets.begin() ? 0 : offsets[first];
+
+    const ptrdiff_t delta = static_cast<ptrdiff_t>(edit.inserted.size()) - static_cast<ptrdiff_t>(edit.removed);
+    const size_t insertedEnd = edit.offset + edit.inserted.size();
+    text.replace(edit.offset, edit.removed, edit.inserted);
+
+    TokenBuffer fresh;
+    fresh.source = text;
+    std::swap(fresh.symbols, lexed.symbols);
+    std::swap(fresh.numbers, lexed.numbers);
+
+    // once a new token starts where an old one did (behind the edit), everything after it lexes the same
+    // old tokens from candidate on start behind the removed text
+    size_t candidate = static_cast<size_t>(std::ranges::lower_bound(offsets, static_cast<uint32_t>(edit.offset + edit.removed)) - offsets.begin());
+    const size_t eof = lexed.size() - 1;
+    oldEnd = eof;
+    newCount = none;
+    size_t position = restart;
+    size_t limit = 0;
+    while (newCount == none) {
+        const size_t from = fresh.size();
+        limit += relexBatch;
+        position = lexTokens(fresh, position, true, limit);
+        for (size_t t = from; t < fresh.size(); ++t) {
+            const size_t at = fresh.offsets[t];
+            if (at < insertedEnd) {
+                continue;
+            }
+            const auto oldAt = static_cast<size_t>(static_cast<ptrdiff_t>(at) - delta);
+            while (candidate < eof && offsets[candidate] < oldAt) {
+                ++candidate;
+            }
+            if (candidate < eof && offsets[candidate] == oldAt) {
+                oldEnd = candidate;
+                newCount = t;
+                break;
+            }
+        }
+        if (newCount == none && position >= text.size()) {
+            // relexed up to the end, only the EOF token is kept
+            newCount = fresh.size();
+        }
+    }
+    std::swap(fresh.symbols, lexed.symbols);
+    std::swap(fresh.numbers, lexed.numbers);
+    relexed = fresh.size();
+
+    // payloads of the replaced tokens go, the ones behind them move with their tokens
+    std::vector<TokenBuffer::Payload>& payloads = lexed.payloads;
+    const size_t payloadFirst = static_cast<size_t>(std::ranges::lower_bound(payloads, offsets[first], {}, &TokenBuffer::Payload::offset) - payloads.begin());
+    const size_t payloadEnd = static_cast<size_t>(std::ranges::lower_bound(payloads, offsets[oldEnd], {}, &TokenBuffer::Payload::offset) - payloads.begin());
+    for (size_t i = payloadEnd; i < payloads.size(); ++i) {
+        payloads[i].offset = shifted(payloads[i].offset, delta);
+    }
+    if (newCount < fresh.size()) {
+        const uint32_t cut = fresh.offsets[newCount];
+        std::erase_if(fresh.payloads, [cut](const TokenBuffer::Payload& payload) { return payload.offset >= cut; });
+    }
+    splice(payloads, payloadFirst, payloadEnd, fresh.payloads.data(), fresh.payloads.data() + fresh.payloads.size());
+
+    for (size_t i = oldEnd; i < lexed.size(); ++i) {
+        lexed.offsets[i] = shifted(lexed.offsets[i], delta);
+    }
+    splice(lexed.kinds, first, oldEnd, fresh.kinds.data(), fresh.kinds.data() + newCount);
+    splice(lexed.offsets, first, oldEnd, fresh.offsets.data(), fresh.offsets.data() + newCount);
+    splice(lexed.lengths, first, oldEnd, fresh.lengths.data(), fresh.lengths.data() + newCount);
+    lexed.source = text;
+}
+
+bool Document::reparse(const size_t first, const size_t oldEnd, const size_t newCount) {
+    const ptrdiff_t shift = static_cast<ptrdiff_t>(newCount) - static_cast<ptrdiff_t>(oldEnd - first);
+
+    // old token indices of the damage, a pure insertion damages the statement holding the token behind it
+    size_t lo = first;
+    size_t hi = std::max(oldEnd, first + 1) - 1;
+
+    // innermost block whose statements cover the damage
+    Block* block = root.get();
+    while (true) {
+        const auto next = std::ranges::upper_bound(block->children, lo, {}, [](const std::unique_ptr<Block>& child) { return child->first; });
+        if (next == block->children.begin()) {
+            break;
+        }
+        Block* child = std::prev(next)->get();
+        if (child->first > lo || hi >= child->end || child->starts.empty()) {
+            break;
+        }
+        block = child;
+    }
+
+    // statement i covers tokens [startOf(i), endOf(i))
+    for (; block != nullptr; block = block->parent) {
+        const std::vector<uint32_t>& starts = block->starts;
+        if (starts.empty() || lo < block->first || hi >= block->end) {
+            continue;
+        }
+        const auto startOf = [&](const size_t i) -> size_t { return i == 0 ? block->first : starts[i]; };
+        const auto endOf = [&](const size_t i) -> size_t { return i + 1 < starts.size() ? starts[i + 1] : block->end; };
+        const auto statementAt = [&](const size_t token) {
+            const auto it = std::ranges::upper_bound(starts, static_cast<uint32_t>(token));
+            return it == starts.begin() ? size_t{0} : static_cast<size_t>(it - starts.begin()) - 1;
+        };
+        const size_t a = statementAt(lo);
+        const size_t b = statementAt(hi);
+        const size_t rangeFirst = startOf(a);
+        const size_t rangeEnd = endOf(b);
+
+        std::vector<BlockSpan> spans;
+        std::vector<ASTNode*> statements;
+        std::vector<uint32_t> newStarts;
+        Parser parser(lexed);
+        parser.recordSpans(&spans);
+        if (!parser.parseRange(tree, rangeFirst, shifted(rangeEnd, shift), statements, newStarts)) {
+            // the change reaches past these statements (or does not parse on its own), try the enclosing block
+            lo = rangeFirst;
+            hi = rangeEnd - 1;
+            continue;
+        }
+        reparsed = shifted(rangeEnd, shift) - rangeFirst;
+
+        // statements a..b get replaced, the rest of the block is reused as it is
+        const NodeList old = block->node->statements;
+        std::vector<ASTNode*> list(old.begin(), old.begin() + a);
+        list.insert(list.end(), statements.begin(), statements.end());
+        list.insert(list.end(), old.begin() + b + 1, old.end());
+        if (list.empty()) {
+            // a program without statements has no top level block at all
+            if (block == root.get()) {
+                return false;
+            }
+            list.push_back(tree.arena.make<EmptyStatementNode>());
+        }
+        block->node->statements = NodeList::copy(tree.arena, list.data(), list.data() + list.size());
+
+        // drop the layouts of the replaced statements, move everything behind the change, then add the new layouts
+        std::erase_if(block->children, [&](const std::unique_ptr<Block>& child) {
+            return child->first >= rangeFirst && child->first < rangeEnd;
+        });
+        shiftBlocks(*root, static_cast<uint32_t>(oldEnd), shift);
+        // text inserted in front of the block's first statement belongs to the block, not to what is behind it
+        if (a == 0) {
+            block->first = static_cast<uint32_t>(rangeFirst);
+        }
+        std::vector<uint32_t> merged(block->starts.begin(), block->starts.begin() + static_cast<ptrdiff_t>(a));
+        merged.insert(merged.end(), newStarts.begin(), newStarts.end());
+        merged.insert(merged.end(), block->starts.begin() + static_cast<ptrdiff_t>(b + 1), block->starts.end());
+        block->starts = std::move(merged);
+        for (std::unique_ptr<Block>& child : buildBlocks(spans)) {
+            child->parent = block;
+            block->children.push_back(std::move(child));
+        }
+        std::ranges::sort(block->children, {}, [](const std::unique_ptr<Block>& child) { return child->first; });
+        return true;
+    }
+    return false;
+}
+
+void Document::edit(const TextEdit& edit) {
+    if (edit.offset > text.size() || edit.removed > text.size() - edit.offset) {
+        throw std::out_of_range("Edit outside of the source: offset " + std::to_string(edit.offset) +
+                                ", removed " + std::to_string(edit.removed));
+    }
+    if (text.size() - edit.removed + edit.inserted.size() > UINT32_MAX) {
+        throw std::runtime_error("Source too large after edit");
+    }
+
+    size_t first = 0;
+    size_t oldEnd = 0;
+    size_t newCount = 0;
+    relex(edit, first, oldEnd, newCount);
+
+    tree.resolved = false;
+    tree.typed = false;
+    if (parsed && root != nullptr && tree.arena.bytesReserved() <= compactAt && reparse(first, oldEnd, newCount)) {
+        return;
+    }
+    reparsed = lexed.size();
+    parseAll();
+}
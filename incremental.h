@@ -0,0 +1,83 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+#include "tokenize.h"
+
+// replaces removed bytes at offset with inserted
+struct TextEdit {
+    size_t offset;
+    size_t removed;
+    std::string_view inserted;
+};
+
+// a source that stays lexed and parsed while it is edited, for editors and hot reload
+// an edit re-lexes from the start of the run of touching tokens in front of it until the new tokens
+// line up with old ones again, then re-parses only the statements of the innermost block that cover
+// the changed tokens
+// every other statement, and every BlockStatementNode under it, is kept as it is; tokens behind the
+// edit only have their offsets shifted
+class Document {
+private:
+    // token layout of one BlockStatementNode, see BlockSpan
+    struct Block {
+        BlockStatementNode* node;
+        uint32_t first;
+        uint32_t end;
+        std::vector<uint32_t> starts;
+        Block* parent = nullptr;
+        std::vector<std::unique_ptr<Block>> children; // sorted by position
+    };
+
+    std::string text;
+    TokenBuffer lexed;
+    ParseResult tree;
+    std::unique_ptr<Block> root;    // the top level block, null when the program has none
+    bool parsed = false;
+    // replaced nodes stay in the arena, once it grows past this the whole tree is parsed again
+    size_t compactAt = 0;
+    size_t relexed = 0;
+    size_t reparsed = 0;
+
+    static std::vector<std::unique_ptr<Block>> buildBlocks(std::vector<BlockSpan>& spans);
+    static void shiftBlocks(Block& block, uint32_t from, ptrdiff_t shift);
+
+    void parseAll();
+    // re-lexes around the edit, old tokens [first, oldEnd) were replaced by newCount new ones
+    void relex(const TextEdit& edit, size_t& first, size_t& oldEnd, size_t& newCount);
+    // false when no block could take the change and the whole tree has to be parsed
+    bool reparse(size_t first, size_t oldEnd, size_t newCount);
+
+public:
+    // syntax errors do not throw, they end up in result().diagnostics like with Parser::parse()
+    explicit Document(std::string source);
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    // applies the edit and brings tokens and tree up to date
+    // after a syntax error isParsed() is false and the tree only holds the statements that parsed
+    // until an edit fixes it, the text and tokens are always up to date
+    void edit(const TextEdit& edit);
+
+    [[nodiscard]] std::string_view source() const { return text; }
+    [[nodiscard]] const TokenBuffer& tokens() const { return lexed; }
+    // false while the source has syntax errors
+    [[nodiscard]] bool isParsed() const { return parsed; }
+    // the tree is re-resolved and re-checked by the caller after an edit, edit() clears ParseResult::resolved
+    // and ParseResult::typed
+    [[nodiscard]] ParseResult& result() { return tree; }
+
+    // how many tokens the last edit lexed and how many it parsed
+    [[nodiscard]] size_t lastRelexed() const { return relexed; }
+    [[nodiscard]] size_t lastReparsed() const { return reparsed; }
+};
+
+#endif //INCREMENTAL_H
@@ -0,0 +1,12 @@
+#include "interner.h"
+
+uint32_t Interner::intern(const std::string_view name) {
+    if (const auto it = ids.find(name); it != ids.end()) {
+        return it->second;
+    }
+    const std::string_view stored = storage.copyString(name);
+    const auto symbol = static_cast<uint32_t>(names.size());
+    ids.emplace(stored, symbol);
+    names.push_back(stored);
+    return symbol;
+}
@@ -0,0 +1,30 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+
+// maps identifier text to dense symbol ids, the same text always gets the same id
+// ids count up from 0, so later passes can index plain arrays with them
+class Interner {
+private:
+    Arena storage{4 * 1024};
+    std::unordered_map<std::string_view, uint32_t> ids; // keys point into storage
+    std::vector<std::string_view> names;
+
+public:
+    Interner() = default;
+    Interner(Interner&&) noexcept = default;
+    Interner& operator=(Interner&&) noexcept = default;
+
+    uint32_t intern(std::string_view name);
+
+    [[nodiscard]] std::string_view name(const uint32_t symbol) const { return names[symbol]; }
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(names.size()); }
+};
+
+#endif //INTERNER_H
@@ -0,0 +1,63 @@
+#include "lexer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Lexer::Lexer(const std::string_view source) : inputDone(true) {
+    if (source.size() > UINT32_MAX) {
+        throw std::runtime_error("Source too large: " + std::to_string(source.size()) + " bytes");
+    }
+    window.source = source;
+}
+
+Lexer::Lexer(std::istream& input, const size_t chunkSize) : input(&input), chunkSize(std::max<size_t>(chunkSize, 1)) {
+}
+
+void Lexer::readChunk() {
+    // release the text in front of both the oldest buffered token and the lexing position
+    size_t keep = scanned;
+    if (!window.empty()) {
+        keep = std::min<size_t>(keep, window.offsets[0] - window.sourceBase);
+    }
+    buffer.erase(0, keep);
+    window.sourceBase += keep;
+    scanned -= keep;
+
+    const size_t oldSize = buffer.size();
+    buffer.resize(oldSize + chunkSize);
+    input->read(buffer.data() + oldSize, static_cast<std::streamsize>(chunkSize));
+    const auto count = static_cast<size_t>(input->gcount());
+    buffer.resize(oldSize + count);
+    if (count < chunkSize) {
+        inputDone = true;
+    }
+
+    if (window.sourceBase + buffer.size() > UINT32_MAX) {
+        throw std::runtime_error("Source too large: more than " + std::to_string(UINT32_MAX) + " bytes");
+    }
+    window.source = buffer;
+}
+
+void Lexer::fill(const size_t count) {
+    if (window.size() >= count || finished) {
+        return;
+    }
+
+    const size_t target = std::max(count, window.size() + batchTokens);
+    while (window.size() < target) {
+        scanned = lexTokens(window, scanned, inputDone, target);
+        if (window.size() >= target) {
+            break;
+        }
+        if (inputDone) {
+            window.push(TOK_EOF, window.sourceBase + window.source.size(), 0);
+            finished = true;
+            break;
+        }
+        readChunk();
+    }
+}
+
+void Lexer::discard(const size_t count) {
+    window.dropFront(std::min(count, window.size()));
+}
@@ -0,0 +1,54 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "tokenize.h"
+
+// pull based lexer, produces tokens into a small window on demand instead of tokenizing everything up front
+// the parser reads the window, discards what it consumed and asks for more
+class Lexer {
+private:
+    std::istream* input = nullptr;
+    size_t chunkSize = 0;
+    std::string buffer;     // holds the unconsumed tail of a streamed input
+
+    TokenBuffer window;
+    size_t scanned = 0;     // index into window.source where lexing resumes
+    bool inputDone = false; // the whole input is in window.source
+    bool finished = false;  // the EOF token was produced
+
+    void readChunk();
+
+public:
+    // tokens are lexed in batches of this size to amortize the window bookkeeping
+    static constexpr size_t batchTokens = 1024;
+
+    // lex an in memory source, the caller keeps it alive
+    explicit Lexer(std::string_view source);
+
+    // lex a file or stdin, reading chunkSize bytes at a time
+    explicit Lexer(std::istream& input, size_t chunkSize = 64 * 1024);
+
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+
+    // the tokens lexed so far and not discarded yet, the last one is TOK_EOF once the input is exhausted
+    [[nodiscard]] const TokenBuffer& tokens() const { return window; }
+
+    [[nodiscard]] bool isFinished() const { return finished; }
+
+    // lexes until the window holds at least count tokens or the EOF token was produced
+    void fill(size_t count);
+
+    // forgets the first count tokens of the window, their text may be released
+    void discard(size_t count);
+
+    // hands over the identifiers interned so far, for when the tokens are no longer needed
+    Interner takeSymbols() { return std::move(window.symbols); }
+};
+
+#endif //LEXER_H
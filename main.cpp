@@ -1,43 +1,523 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "batch.h"
+#include "cache.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "optimizer.h"
+#include "parallellex.h"
 #include "tokenize.h"
 #include "parser.h"
+#include "resolver.h"
+#include "sourcefile.h"
+#include "sourceloc.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "typecheck.h"
+#include "vm.h"
 
-int main()
-{
-    /*
-var proje = (1 + 2) * 3;
-while (true) {
-    proje = proje + 1;
-    break;
+namespace {
+
+enum Mode {
+    MODE_LEX,   // tokenize only
+    MODE_PARSE, // tokenize and parse
+    MODE_RUN    // parse, compile and run
+};
+
+struct Options {
+    Mode mode = MODE_RUN;
+    bool dumpTokens = false;
+    bool disassemble = false;
+    bool parallelLex = false;
+    size_t jobs = 0;            // 0 uses every hardware thread
+    size_t maxNesting = Parser::defaultNestingLimit;
+    bool stats = false;
+    std::string trace;          // Chrome trace output file
+    std::string cache;          // compiled program cache directory, empty when caching is off
+    std::vector<std::string> files;
+};
+
+constexpr std::string_view usage =
+    "usage: Cuel [--lex | --parse | --run] [--tokens] [--disassemble] [--parallel-lex] [--jobs N]\n"
+    "            [--max-nesting N] [--stats] [--trace FILE] [--cache DIR] <file | -> ...\n"
+    "  --lex          only tokenize the input\n"
+    "  --parse        tokenize and parse the input\n"
+    "  --run          parse, compile and run the input (default)\n"
+    "  --tokens       print every token\n"
+    "  --disassemble  print the compiled bytecode (with --run)\n"
+    "  --parallel-lex split each file into chunks and lex them on all threads\n"
+    "  --jobs N       parse several files on N threads (default: one per core)\n"
+    "  --max-nesting N  report blocks and brackets nested deeper than N (default: 1000)\n"
+    "  --stats        print phase times and token, node and depth counts to stderr\n"
+    "  --trace FILE   write the phase times as Chrome trace event JSON\n"
+    "  --cache DIR    keep compiled programs in DIR and run unchanged files without parsing them\n"
+    "  -              read the program from stdin\n";
+
+// collects output and writes it in large blocks, so dumping millions of tokens does not
+// pay for a flush or a stream sentry per line
+class OutputBuffer {
+private:
+    static constexpr size_t flushSize = 64 * 1024;
+    std::string buffer;
+
+public:
+    OutputBuffer() { buffer.reserve(flushSize + 256); }
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    OutputBuffer& operator<<(const std::string_view text) {
+        buffer.append(text);
+        if (buffer.size() >= flushSize) {
+            flush();
+        }
+        return *this;
+    }
+
+    void flush() {
+        std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+        buffer.clear();
+    }
+};
+
+size_t parseCount(const std::string_view text, const std::string& what) {
+    size_t count = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::runtime_error("Invalid " + what + ": " + std::string(text));
+    }
+    return count;
+}
+
+Options parseArguments(const int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--lex") {
+            options.mode = MODE_LEX;
+        } else if (argument == "--parse") {
+            options.mode = MODE_PARSE;
+        } else if (argument == "--run") {
+            options.mode = MODE_RUN;
+        } else if (argument == "--tokens") {
+            options.dumpTokens = true;
+        } else if (argument == "--disassemble") {
+            options.disassemble = true;
+        } else if (argument == "--parallel-lex") {
+            options.parallelLex = true;
+        } else if (argument == "--stats") {
+            options.stats = true;
+        } else if (argument == "--trace") {
+            if (++i == argc) {
+                throw std::runtime_error("Missing file after --trace");
+            }
+            options.trace = argv[i];
+        } else if (argument == "--cache") {
+            if (++i == argc) {
+                throw std::runtime_error("Missing directory after --cache");
+            }
+            options.cache = argv[i];
+        } else if (argument == "--jobs" || argument == "-j") {
+            if (++i == argc) {
+                throw std::runtime_error("Missing thread count after " + std::string(argument));
+            }
+            options.jobs = parseCount(argv[i], "thread count");
+        } else if (argument == "--max-nesting") {
+            if (++i == argc) {
+                throw std::runtime_error("Missing depth after --max-nesting");
+            }
+            options.maxNesting = parseCount(argv[i], "nesting depth");
+        } else if (argument.size() > 1 && argument.starts_with('-')) {
+            throw std::runtime_error("Unknown option: " + std::string(argument));
+        } else {
+            options.files.emplace_back(argument);
+        }
+    }
+    if (options.files.empty()) {
+        throw std::runtime_error("No input files");
+    }
+    return options;
+}
+
+void dumpTokens(const TokenBuffer& tokens, OutputBuffer& out) {
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        out << "Token: " << tokens.text(i)
+            << " | Type: " << tokenTypeToString(tokens.type(i))
+            << " | Position: " << std::to_string(tokens.offsets[i]) << "\n";
+    }
+}
+
+// lexes everything the lexer has through its window, printing the tokens when out is given
+size_t lexAll(Lexer& lexer, OutputBuffer* out) {
+    size_t count = 0;
+    do {
+        lexer.fill(Lexer::batchTokens);
+        const TokenBuffer& tokens = lexer.tokens();
+        if (out != nullptr) {
+            dumpTokens(tokens, *out);
+        }
+        count += tokens.size();
+        lexer.discard(tokens.size());
+    } while (!lexer.isFinished());
+    return count;
 }
-return 0;
-     */
-    const std::string sourceCode = "var proje = (1 + 2) * 3; while (true) { proje = proje + 1; break; } return 0;";
-    // tokenize the source code
-    auto tokens = tokenize(sourceCode);
-    std::cout << "Input source: " + sourceCode << std::endl;
 
+size_t lexSource(const std::string_view source, OutputBuffer* out) {
+    Lexer lexer(source);
+    return lexAll(lexer, out);
+}
+
+size_t programBytes(const Program& program) {
+    return program.code.capacity() * sizeof(Instruction) + program.constants.capacity() * sizeof(Value) +
+           (program.integers.capacity() + program.jumpTables.capacity()) * sizeof(int64_t) +
+           program.stringEnds.capacity() * sizeof(uint32_t) + program.chars.capacity();
+}
+
+// where the program compiled from a source goes, cache is null when caching is off
+struct CacheSlot {
+    const ScriptCache* cache = nullptr;
+    CacheKey key;
+};
+
+void runProgram(const std::string& path, const ProgramView& program, const Options& options, OutputBuffer& out, Stats* stats) {
+    if (options.disassemble) {
+        out << disassemble(program);
+    }
+
+    StatsPhase phase(stats, "run", path);
+    VM vm(program);
+    const Value result = vm.run();
+    out << path << ": " << vm.toString(result) << "\n";
+}
+
+// hashes the source and runs its cached program, returns false and leaves slot ready for
+// storing the program when there is none
+bool runCached(const std::string& path, const std::string_view source, const Options& options, OutputBuffer& out,
+               Stats* stats, const ScriptCache* cache, CacheSlot& slot) {
+    if (cache == nullptr || options.mode != MODE_RUN || options.dumpTokens) {
+        return false;
+    }
+    std::optional<CachedProgram> cached;
+    {
+        StatsPhase phase(stats, "cache", path);
+        slot = {cache, cacheKey(source)};
+        cached = cache->load(slot.key);
+        phase.bytes(cached ? cached->program().code.size_bytes() : 0);
+    }
+    if (!cached) {
+        return false;
+    }
+    runProgram(path, cached->program(), options, out, stats);
+    return true;
+}
 
-    for (const auto& [value, type, position] : tokens) {
-        std::cout << "Token: " << value
-                  << " | Type: " << tokenTypeToString(type)
-                  << " | Position: " << position
-                  << std::endl;
+// everything after parsing, returns false when the source had syntax errors
+// source is only read to quote the offending tokens
+bool finishSource(const std::string& path, const std::string_view source, ParseResult& ast, const Options& options,
+                  OutputBuffer& out, Stats* stats, const CacheSlot& slot) {
+    if (stats != nullptr) {
+        stats->countNodes(ast);
+    }
+    if (ast.hasErrors()) {
+        SourceManager sources;
+        const uint32_t file = sources.addSource(path, source);
+        out.flush();
+        std::cerr << ast.diagnostics.formatAll(sources, file);
+        return false;
+    }
+    if (options.mode == MODE_PARSE) {
+        out << path << ": " << std::to_string(ast.statements.size()) << " statements\n";
+        return true;
     }
 
-    Parser parser(tokens);
-    auto ast = parser.parse();
+    {
+        StatsPhase phase(stats, "optimize", path);
+        optimize(ast);
+    }
+    {
+        StatsPhase phase(stats, "resolve", path);
+        resolve(ast);
+    }
+    {
+        StatsPhase phase(stats, "types", path);
+        checkTypes(ast);
+    }
 
-    return 0;
+    Compiler compiler;
+    Program program;
+    {
+        StatsPhase phase(stats, "compile", path);
+        program = compiler.compile(ast);
+        phase.bytes(programBytes(program));
+    }
+    if (slot.cache != nullptr && !slot.cache->store(slot.key, program.view())) {
+        out.flush();
+        std::cerr << path << ": cannot write to the cache\n";
+    }
+    runProgram(path, program.view(), options, out, stats);
+    return true;
 }
 
+// parses a token buffer lexed up front
+bool parseTokens(const std::string& path, const TokenBuffer& tokens, const Options& options, OutputBuffer& out, Stats* stats,
+                 const CacheSlot& slot) {
+    if (options.dumpTokens) {
+        dumpTokens(tokens, out);
+    }
+    if (stats != nullptr) {
+        stats->countTokens(tokens);
+    }
+    if (options.mode == MODE_LEX) {
+        out << path << ": " << std::to_string(tokens.size()) << " tokens\n";
+        return true;
+    }
+
+    ParseResult ast;
+    {
+        StatsPhase phase(stats, "parse", path);
+        Parser parser(tokens);
+        parser.limitNesting(options.maxNesting);
+        parser.collectStats(stats);
+        ast = parser.parse();
+        phase.bytes(ast.arena.bytesReserved());
+    }
+    return finishSource(path, tokens.source, ast, options, out, stats, slot);
+}
+
+// lexes the whole source at once with every thread of the pool, then parses the token buffer
+bool processSplitSource(const std::string& path, const std::string_view source, const Options& options,
+                        ThreadPool& pool, OutputBuffer& out, Stats* stats, const ScriptCache* cache) {
+    CacheSlot slot;
+    if (runCached(path, source, options, out, stats, cache, slot)) {
+        return true;
+    }
+    TokenBuffer tokens;
+    {
+        StatsPhase phase(stats, "tokenize", path);
+        tokens = tokenizeParallel(source, pool);
+        phase.bytes(tokens.bytesReserved());
+    }
+    return parseTokens(path, tokens, options, out, stats, slot);
+}
+
+bool processSource(const std::string& path, const std::string_view source, const Options& options, OutputBuffer& out,
+                   Stats* stats, const ScriptCache* cache) {
+    CacheSlot slot;
+    if (runCached(path, source, options, out, stats, cache, slot)) {
+        return true;
+    }
+    if (stats != nullptr) {
+        // lexing and parsing are kept apart so each gets its own time
+        TokenBuffer tokens;
+        {
+            StatsPhase phase(stats, "tokenize", path);
+            tokens = tokenize(source);
+            phase.bytes(tokens.bytesReserved());
+        }
+        return parseTokens(path, tokens, options, out, stats, slot);
+    }
+
+    if (options.mode == MODE_LEX || options.dumpTokens) {
+        const size_t count = lexSource(source, options.dumpTokens ? &out : nullptr);
+        if (options.mode == MODE_LEX) {
+            out << path << ": " << std::to_string(count) << " tokens\n";
+            return true;
+        }
+    }
+
+    // the parser pulls tokens from the lexer as it goes
+    Lexer lexer(source);
+    Parser parser(lexer);
+    parser.limitNesting(options.maxNesting);
+    ParseResult ast = parser.parse();
+    return finishSource(path, source, ast, options, out, nullptr, slot);
+}
+
+// lexes or parses a stream chunk by chunk, so a large pipe is never held in memory as a whole
+// the text is gone by the time the diagnostics are printed, so they only give byte offsets
+bool processStream(const std::string& path, std::istream& input, const Options& options, OutputBuffer& out) {
+    Lexer lexer(input);
+    if (options.mode == MODE_LEX) {
+        const size_t count = lexAll(lexer, options.dumpTokens ? &out : nullptr);
+        out << path << ": " << std::to_string(count) << " tokens\n";
+        return true;
+    }
+
+    Parser parser(lexer);
+    parser.limitNesting(options.maxNesting);
+    const ParseResult ast = parser.parse();
+    if (ast.hasErrors()) {
+        out.flush();
+        std::cerr << ast.diagnostics.formatAll({}, path + ": ");
+        return false;
+    }
+    out << path << ": " << std::to_string(ast.statements.size()) << " statements\n";
+    return true;
+}
+
+// parses every file in parallel, then finishes them one by one in the order they were given
+// with a cache every file is hashed and looked up on the pool first, and only the misses are parsed
+int processBatch(const Options& options, const ScriptCache* cache, OutputBuffer& out) {
+    ThreadPool pool(options.jobs);
+    const size_t count = options.files.size();
+    std::vector<std::optional<CachedProgram>> hits(count);
+    std::vector<CacheSlot> slots(count);
+    if (cache != nullptr && options.mode == MODE_RUN) {
+        std::vector<size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), size_t{0});
+        pool.forEach(indices, [&](const size_t index) {
+            try {
+                const SourceFile source(options.files[index]);
+                slots[index] = {cache, cacheKey(source.text())};
+                hits[index] = cache->load(slots[index].key);
+            } catch (const std::exception&) {
+                // parseFiles runs into the same error and reports it
+            }
+        });
+    }
+
+    std::vector<std::string> misses;
+    for (size_t i = 0; i < count; ++i) {
+        if (!hits[i]) {
+            misses.push_back(options.files[i]);
+        }
+    }
+    BatchResult batch = parseFiles(misses, pool, options.maxNesting);
+
+    int status = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (hits[i]) {
+            try {
+                runProgram(options.files[i], hits[i]->program(), options, out, nullptr);
+            } catch (const std::exception& error) {
+                out.flush();
+                std::cerr << options.files[i] << ": " << error.what() << "\n";
+                status = 1;
+            }
+            continue;
+        }
+        BatchFile& file = batch.files[next++];
+        try {
+            if (!file.error.empty()) {
+                throw std::runtime_error(file.error);
+            }
+            // a file with syntax errors is mapped again, only to quote the offending tokens
+            std::optional<SourceFile> source;
+            if (file.result.hasErrors()) {
+                source.emplace(file.path);
+            }
+            if (!finishSource(file.path, source ? source->text() : std::string_view(), file.result, options, out, nullptr,
+                              slots[i])) {
+                status = 1;
+            }
+        } catch (const std::exception& error) {
+            out.flush();
+            std::cerr << file.path << ": " << error.what() << "\n";
+            status = 1;
+        }
+    }
+    return status;
+}
+
+}
+
+int main(const int argc, char** argv)
+{
+    Options options;
+    try {
+        options = parseArguments(argc, argv);
+    } catch (const std::exception& error) {
+        std::cerr << "Cuel: " << error.what() << "\n" << usage;
+        return 2;
+    }
+
+    OutputBuffer out;
+    // stats are collected on one thread, so they turn the parallel batch off
+    std::optional<Stats> stats;
+    if (options.stats || !options.trace.empty()) {
+        stats.emplace();
+    }
+    const bool batch = options.files.size() > 1 && options.mode != MODE_LEX && !options.dumpTokens && !options.parallelLex &&
+                       !stats && std::ranges::find(options.files, "-") == options.files.end();
+    std::optional<ScriptCache> cache;
+    if (!options.cache.empty()) {
+        try {
+            cache.emplace(options.cache);
+        } catch (const std::exception& error) {
+            std::cerr << "Cuel: " << error.what() << "\n";
+            return 2;
+        }
+    }
+    const ScriptCache* scripts = cache ? &*cache : nullptr;
+    if (batch) {
+        return processBatch(options, scripts, out);
+    }
+
+    std::optional<ThreadPool> pool;
+    if (options.parallelLex) {
+        pool.emplace(options.jobs);
+    }
+    const auto process = [&](const std::string& path, const std::string_view source) {
+        Stats* collect = stats ? &*stats : nullptr;
+        return pool ? processSplitSource(path, source, options, *pool, out, collect, scripts)
+                    : processSource(path, source, options, out, collect, scripts);
+    };
+
+    // running hashes and quotes the whole text, and dumping tokens while parsing lexes it twice
+    const bool streamable = (options.mode == MODE_LEX || (options.mode == MODE_PARSE && !options.dumpTokens)) && !pool && !stats;
+    int status = 0;
+    for (const std::string& path : options.files) {
+        try {
+            if (path == "-" && streamable) {
+                if (!processStream("<stdin>", std::cin, options, out)) {
+                    status = 1;
+                }
+            } else if (path == "-") {
+                // a pipe cannot be mapped, read it into memory instead
+                const std::string source{std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>()};
+                if (!process("<stdin>", source)) {
+                    status = 1;
+                }
+            } else {
+                const SourceFile file(path);
+                if (!process(path, file.text())) {
+                    status = 1;
+                }
+            }
+        } catch (const std::exception& error) {
+            out.flush();
+            std::cerr << path << ": " << error.what() << "\n";
+            status = 1;
+        }
+    }
+
+    if (stats) {
+        out.flush();
+        if (options.stats) {
+            std::cerr << stats->report();
+        }
+        if (!options.trace.empty()) {
+            std::ofstream trace(options.trace, std::ios::binary);
+            trace << stats->chromeTrace();
+            if (!trace) {
+                std::cerr << "Cuel: cannot write " << options.trace << "\n";
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
 
-/*
-const int NUM_ITERATIONS = 1000000;
-Benchmarking Raw Pointer, Unique Pointer, and Shared Pointer
-Raw Pointer Time: 0.0355525 seconds
-Unique Pointer Time: 0.0790833 seconds
-Shared Pointer Time: 0.133362 seconds
- */
\ No newline at end of file
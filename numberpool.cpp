@@ -0,0 +1,45 @@
+#include "numberpool.h"
+
+#include <charconv>
+#include <system_error>
+
+std::optional<Number> parseNumber(const std::string_view text) {
+    const char* const first = text.data();
+    const char* const last = text.data() + text.size();
+
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        // from_chars takes the digits without the prefix, and the literal only counts as a whole
+        uint64_t value = 0;
+        const auto [end, error] = std::from_chars(first + 2, last, value, 16);
+        if (error != std::errc() || end != last) {
+            return std::nullopt;
+        }
+        // hex is a bit pattern, 0xFFFFFFFFFFFFFFFF is -1
+        return Number::fromInteger(static_cast<int64_t>(value));
+    }
+
+    if (text.find_first_of(".eE") == std::string_view::npos) {
+        int64_t value = 0;
+        const auto [end, error] = std::from_chars(first, last, value);
+        if (error != std::errc() || end != last) {
+            return std::nullopt;
+        }
+        return Number::fromInteger(value);
+    }
+
+    double value = 0;
+    const auto [end, error] = std::from_chars(first, last, value, std::chars_format::general);
+    if (error != std::errc() || end != last) {
+        return std::nullopt;
+    }
+    return Number::fromFloat(value);
+}
+
+uint32_t NumberPool::add(const Number& number) {
+    auto& ids = number.kind == NUMBER_FLOAT ? floats : integers;
+    const auto [it, inserted] = ids.try_emplace(number.bits(), static_cast<uint32_t>(numbers.size()));
+    if (inserted) {
+        numbers.push_back(number);
+    }
+    return it->second;
+}
@@ -0,0 +1,76 @@
+#ifndef NUMBERPOOL_H
+#define NUMBERPOOL_H
+
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum NumberKind : uint8_t {
+    NUMBER_INTEGER,
+    NUMBER_FLOAT
+};
+
+// value of a number literal, literals without '.' or an exponent are 64 bit integers
+struct Number {
+    NumberKind kind = NUMBER_INTEGER;
+    union {
+        int64_t integer = 0;
+        double real;
+    };
+
+    static Number fromInteger(const int64_t integer) {
+        Number number;
+        number.integer = integer;
+        return number;
+    }
+
+    static Number fromFloat(const double real) {
+        Number number;
+        number.kind = NUMBER_FLOAT;
+        number.real = real;
+        return number;
+    }
+
+    // the value as a double, integers are converted
+    [[nodiscard]] double toFloat() const { return kind == NUMBER_FLOAT ? real : static_cast<double>(integer); }
+
+    // 0.0 and -0.0 are different literals, both kinds compare by their bits
+    [[nodiscard]] uint64_t bits() const {
+        return kind == NUMBER_FLOAT ? std::bit_cast<uint64_t>(real) : static_cast<uint64_t>(integer);
+    }
+
+    friend bool operator==(const Number& a, const Number& b) { return a.kind == b.kind && a.bits() == b.bits(); }
+};
+
+// == in the language, 1 == 1.0; integers compare exactly, anything with a float in it as doubles
+inline bool numbersEqual(const Number& a, const Number& b) {
+    if (a.kind == NUMBER_INTEGER && b.kind == NUMBER_INTEGER) {
+        return a.integer == b.integer;
+    }
+    return a.toFloat() == b.toFloat();
+}
+
+// decodes a number literal with std::from_chars: decimal or 0x hex integers, decimals with a fraction
+// and/or an exponent; nullopt when text is not a complete literal or an integer does not fit 64 bits
+std::optional<Number> parseNumber(std::string_view text);
+
+// maps number literals to dense ids, the same value always gets the same id
+// ids count up from 0 and index values(), like Interner does for identifiers
+class NumberPool {
+private:
+    std::unordered_map<uint64_t, uint32_t> integers;    // keyed by Number::bits()
+    std::unordered_map<uint64_t, uint32_t> floats;
+    std::vector<Number> numbers;
+
+public:
+    uint32_t add(const Number& number);
+
+    [[nodiscard]] const Number& operator[](const uint32_t id) const { return numbers[id]; }
+    [[nodiscard]] const std::vector<Number>& values() const { return numbers; }
+    [[nodiscard]] uint32_t size() const { return static_cast<uint32_t>(numbers.size()); }
+};
+
+#endif //NUMBERPOOL_H
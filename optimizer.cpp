@@ -0,0 +1,518 @@
+#include "optimizer.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string_view stringContents(const LiteralNode* literal) {
+    return static_cast<const StringNode*>(literal->value)->value;
+}
+
+// arithmetic wraps around like it does in the vm
+int64_t wrap(const uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+// what the optimizer knows about the value of an expression before types are checked
+enum NumericKind {
+    NUMERIC_UNKNOWN,
+    NUMERIC_NUMBER,     // an integer or a float
+    NUMERIC_INTEGER
+};
+
+size_t countNodes(const ASTNode* node);
+
+size_t countNodes(const NodeList& nodes) {
+    size_t count = 0;
+    for (const ASTNode* node : nodes) {
+        count += countNodes(node);
+    }
+    return count;
+}
+
+size_t countNodes(const ASTNode* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+    switch (node->kind) {
+    case NODE_LITERAL:
+        return 1 + countNodes(static_cast<const LiteralNode*>(node)->value);
+    case EXPRESSION_FUNCTION_CALL: {
+        const auto* call = static_cast<const FunctionCallNode*>(node);
+        return 1 + countNodes(call->object) + countNodes(call->arguments);
+    }
+    case EXPRESSION_MEMBER_ACCESS:
+        return 1 + countNodes(static_cast<const MemberAccessNode*>(node)->object);
+    case EXPRESSION_BINARY_OPERATION: {
+        const auto* binary = static_cast<const BinaryOperationNode*>(node);
+        return 1 + countNodes(binary->left) + countNodes(binary->right);
+    }
+    case STATEMENT_BLOCK:
+        return 1 + countNodes(static_cast<const BlockStatementNode*>(node)->statements);
+    case STATEMENT_ASSIGNMENT: {
+        const auto* assignment = static_cast<const AssignmentStatementNode*>(node);
+        return 1 + countNodes(assignment->variable) + countNodes(assignment->value);
+    }
+    case STATEMENT_VARIABLE_DECLARATION: {
+        const auto* declaration = static_cast<const VariableDeclarationStatementNode*>(node);
+        return 1 + countNodes(declaration->variable) + countNodes(declaration->value);
+    }
+    case STATEMENT_GLOBAL_DECLARATION: {
+        const auto* declaration = static_cast<const GlobalDeclarationStatementNode*>(node);
+        return 1 + countNodes(declaration->variable) + countNodes(declaration->value);
+    }
+    case STATEMENT_IF: {
+        const auto* statement = static_cast<const IfStatementNode*>(node);
+        return 1 + countNodes(statement->condition) + countNodes(statement->body) +
+               countNodes(statement->elseifBodies) + countNodes(statement->elseBody);
+    }
+    case STATEMENT_ELSE_IF: {
+        const auto* statement = static_cast<const ElseIfStatementNode*>(node);
+        return 1 + countNodes(statement->condition) + countNodes(statement->body);
+    }
+    case STATEMENT_ELSE:
+        return 1 + countNodes(static_cast<const ElseStatementNode*>(node)->body);
+    case STATEMENT_WHILE: {
+        const auto* statement = static_cast<const WhileStatementNode*>(node);
+        return 1 + countNodes(statement->condition) + countNodes(statement->body);
+    }
+    case STATEMENT_SWITCH: {
+        const auto* statement = static_cast<const SwitchStatementNode*>(node);
+        return 1 + countNodes(statement->value) + countNodes(statement->cases) + countNodes(statement->defaultBody);
+    }
+    case STATEMENT_CASE: {
+        const auto* statement = static_cast<const SwitchCaseNode*>(node);
+        return 1 + countNodes(statement->label) + countNodes(statement->body);
+    }
+    case STATEMENT_RETURN:
+        return 1 + countNodes(static_cast<const ReturnStatementNode*>(node)->expressions);
+    case STATEMENT_FUNCTION_CALL: {
+        const auto* call = static_cast<const FunctionCallStatementNode*>(node);
+        return 1 + countNodes(call->object) + countNodes(call->arguments);
+    }
+    default:
+        return 1;
+    }
+}
+
+class Optimizer {
+private:
+    Arena& arena;
+    NumberPool& numbers;
+    // kept list entries, nested lists stack on top of each other
+    std::vector<ASTNode*> scratch;
+
+    [[nodiscard]] const Number& numberValue(const LiteralNode* literal) const {
+        return numbers[static_cast<const NumberNode*>(literal->value)->constant];
+    }
+
+    // same rules as the vm
+    [[nodiscard]] bool isTruthy(const LiteralNode* literal) const {
+        switch (literal->type) {
+        case LITERAL_NUMBER: return numberValue(literal).toFloat() != 0;
+        case LITERAL_STRING: return !stringContents(literal).empty();
+        case LITERAL_TRUE:   return true;
+        default:             return false;
+        }
+    }
+
+    // only integers, x + 0.0 turns an integer x into a float
+    [[nodiscard]] bool isInteger(const LiteralNode* literal, const int64_t value) const {
+        return literal != nullptr && literal->type == LITERAL_NUMBER && numberValue(literal) == Number::fromInteger(value);
+    }
+
+    ASTNode* makeNumber(const Number& value) {
+        return arena.make<LiteralNode>(LITERAL_NUMBER, arena.make<NumberNode>(numbers.add(value)));
+    }
+
+    ASTNode* makeBoolean(const bool value) {
+        return arena.make<LiteralNode>(value ? LITERAL_TRUE : LITERAL_FALSE, arena.make<BooleanNode>(value));
+    }
+
+    ASTNode* makeString(const std::string_view left, const std::string_view right) {
+        std::string text;
+        text.reserve(left.size() + right.size());
+        text += left;
+        text += right;
+        return arena.make<LiteralNode>(LITERAL_STRING, arena.make<StringNode>(arena.copyString(text)));
+    }
+
+    // literal result of left op right, nullptr when it has to be left to the vm
+    // (type errors, integer division by zero)
+    ASTNode* foldLiterals(const LiteralNode* left, const TokenType operation, const LiteralNode* right) {
+        switch (operation) {
+        case TOK_AND:
+            return makeBoolean(isTruthy(left) && isTruthy(right));
+        case TOK_OR:
+            return makeBoolean(isTruthy(left) || isTruthy(right));
+        default:
+            break;
+        }
+
+        const bool sameType = left->type == right->type ||
+                              (left->type != LITERAL_NUMBER && left->type != LITERAL_STRING &&
+                               right->type != LITERAL_NUMBER && right->type != LITERAL_STRING);
+        if (operation == TOK_EQUAL || operation == TOK_NOT_EQUAL) {
+            bool equal = false;
+            if (sameType) {
+                switch (left->type) {
+                case LITERAL_NUMBER: equal = numbersEqual(numberValue(left), numberValue(right)); break;
+                case LITERAL_STRING: equal = stringContents(left) == stringContents(right); break;
+                default:             equal = left->type == right->type; break;
+                }
+            }
+            return makeBoolean(operation == TOK_EQUAL ? equal : !equal);
+        }
+
+        if (left->type == LITERAL_STRING && right->type == LITERAL_STRING && operation == TOK_ADDITION) {
+            return makeString(stringContents(left), stringContents(right));
+        }
+
+        if (left->type != LITERAL_NUMBER || right->type != LITERAL_NUMBER) {
+            return nullptr;
+        }
+
+        const Number& leftNumber = numberValue(left);
+        const Number& rightNumber = numberValue(right);
+        if (leftNumber.kind == NUMBER_FLOAT || rightNumber.kind == NUMBER_FLOAT) {
+            // a float on either side makes it float arithmetic, the bitwise operators need integers
+            const double a = leftNumber.toFloat();
+            const double b = rightNumber.toFloat();
+            switch (operation) {
+            case TOK_ADDITION:       return makeNumber(Number::fromFloat(a + b));
+            case TOK_SUBTRACTION:    return makeNumber(Number::fromFloat(a - b));
+            case TOK_MULTIPLICATION: return makeNumber(Number::fromFloat(a * b));
+            case TOK_DIVISION:       return makeNumber(Number::fromFloat(a / b));
+            case TOK_MODULUS:        return makeNumber(Number::fromFloat(std::fmod(a, b)));
+            case TOK_GREATER:        return makeBoolean(a > b);
+            case TOK_LESS:           return makeBoolean(a < b);
+            case TOK_GREATER_EQUAL:  return makeBoolean(a >= b);
+            case TOK_LESS_EQUAL:     return makeBoolean(a <= b);
+            default:                 return nullptr;
+            }
+        }
+
+        const int64_t a = leftNumber.integer;
+        const int64_t b = rightNumber.integer;
+        const auto integer = [&](const int64_t value) { return makeNumber(Number::fromInteger(value)); };
+        switch (operation) {
+        case TOK_ADDITION:       return integer(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)));
+        case TOK_SUBTRACTION:    return integer(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)));
+        case TOK_MULTIPLICATION: return integer(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)));
+        case TOK_DIVISION:       return b == 0 ? nullptr : integer(b == -1 ? wrap(0 - static_cast<uint64_t>(a)) : a / b);
+        case TOK_MODULUS:        return b == 0 ? nullptr : integer(b == -1 ? 0 : a % b);
+        case TOK_GREATER:        return makeBoolean(a > b);
+        case TOK_LESS:           return makeBoolean(a < b);
+        case TOK_GREATER_EQUAL:  return makeBoolean(a >= b);
+        case TOK_LESS_EQUAL:     return makeBoolean(a <= b);
+        case TOK_BITWISE_AND:    return integer(a & b);
+        case TOK_BITWISE_OR:     return integer(a | b);
+        case TOK_BITWISE_XOR:    return integer(a ^ b);
+        case TOK_LEFT_SHIFT:     return integer(wrap(static_cast<uint64_t>(a) << (b & 63)));
+        case TOK_RIGHT_SHIFT:    return integer(a >> (b & 63));
+        default:                 return nullptr;
+        }
+    }
+
+    // what an expression evaluates to whenever it does not raise an error, as far as its shape tells
+    // variables are not typed yet, so they are unknown
+    [[nodiscard]] NumericKind numericKind(const ASTNode* node) const {
+        if (const auto* literal = node->as<LiteralNode>()) {
+            if (literal->type != LITERAL_NUMBER) {
+                return NUMERIC_UNKNOWN;
+            }
+            return numberValue(literal).kind == NUMBER_INTEGER ? NUMERIC_INTEGER : NUMERIC_NUMBER;
+        }
+        const auto* binary = node->as<BinaryOperationNode>();
+        if (binary == nullptr) {
+            return NUMERIC_UNKNOWN;
+        }
+        switch (binary->operation) {
+        case TOK_ADDITION:
+        case TOK_SUBTRACTION:
+        case TOK_MULTIPLICATION:
+        case TOK_DIVISION:
+        case TOK_MODULUS: {
+            // two integers stay integers, anything else numeric is a float; '+' also joins strings
+            const NumericKind left = numericKind(binary->left);
+            const NumericKind right = numericKind(binary->right);
+            if (left == NUMERIC_INTEGER && right == NUMERIC_INTEGER) {
+                return NUMERIC_INTEGER;
+            }
+            if (binary->operation != TOK_ADDITION || (left != NUMERIC_UNKNOWN && right != NUMERIC_UNKNOWN)) {
+                return NUMERIC_NUMBER;
+            }
+            return NUMERIC_UNKNOWN;
+        }
+        case TOK_BITWISE_AND:
+        case TOK_BITWISE_OR:
+        case TOK_BITWISE_XOR:
+        case TOK_LEFT_SHIFT:
+        case TOK_RIGHT_SHIFT:
+            return NUMERIC_INTEGER;
+        default:
+            return NUMERIC_UNKNOWN;
+        }
+    }
+
+    // x + 0, x * 1 and friends, only where x is known to be a value the identity holds for;
+    // anything else has to reach the vm, which raises the type errors
+    // x + 0 needs an integer, -0.0 + 0 is 0.0
+    ASTNode* foldIdentity(ASTNode* left, const TokenType operation, ASTNode* right) const {
+        const auto* leftLiteral = left->as<LiteralNode>();
+        const auto* rightLiteral = right->as<LiteralNode>();
+        const auto integer = [&](const ASTNode* node) { return numericKind(node) == NUMERIC_INTEGER; };
+        const auto number = [&](const ASTNode* node) { return numericKind(node) != NUMERIC_UNKNOWN; };
+        switch (operation) {
+        case TOK_ADDITION:
+        case TOK_BITWISE_OR:
+        case TOK_BITWISE_XOR:
+            if (isInteger(rightLiteral, 0) && integer(left)) return left;
+            if (isInteger(leftLiteral, 0) && integer(right)) return right;
+            return nullptr;
+        case TOK_MULTIPLICATION:
+            if (isInteger(rightLiteral, 1) && number(left)) return left;
+            if (isInteger(leftLiteral, 1) && number(right)) return right;
+            return nullptr;
+        case TOK_SUBTRACTION:
+            return isInteger(rightLiteral, 0) && number(left) ? left : nullptr;
+        case TOK_LEFT_SHIFT:
+        case TOK_RIGHT_SHIFT:
+            return isInteger(rightLiteral, 0) && integer(left) ? left : nullptr;
+        case TOK_DIVISION:
+            return isInteger(rightLiteral, 1) && number(left) ? left : nullptr;
+        default:
+            return nullptr;
+        }
+    }
+
+    ASTNode* binary(BinaryOperationNode* node) {
+        node->left = expression(node->left);
+        node->right = expression(node->right);
+
+        switch (node->operation) {
+        case TOK_ASSIGNMENT:
+        case TOK_ADDITION_ASSIGNMENT:
+        case TOK_SUBTRACTION_ASSIGNMENT:
+        case TOK_MULTIPLICATION_ASSIGNMENT:
+        case TOK_DIVISION_ASSIGNMENT:
+        case TOK_MODULUS_ASSIGNMENT:
+            return node;
+        default:
+            break;
+        }
+
+        const auto* left = node->left->as<LiteralNode>();
+        const auto* right = node->right->as<LiteralNode>();
+
+        // a constant left side decides whether the right side runs at all
+        if (left != nullptr && right == nullptr) {
+            if (node->operation == TOK_AND && !isTruthy(left)) {
+                return makeBoolean(false);
+            }
+            if (node->operation == TOK_OR && isTruthy(left)) {
+                return makeBoolean(true);
+            }
+        }
+
+        if (left != nullptr && right != nullptr) {
+            if (ASTNode* folded = foldLiterals(left, node->operation, right)) {
+                return folded;
+            }
+            return node;
+        }
+
+        if (ASTNode* operand = foldIdentity(node->left, node->operation, node->right)) {
+            return operand;
+        }
+        return node;
+    }
+
+    ASTNode* expression(ASTNode* node) {
+        switch (node->kind) {
+        case EXPRESSION_BINARY_OPERATION:
+            return binary(static_cast<BinaryOperationNode*>(node));
+        case EXPRESSION_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallNode*>(node);
+            call->object = expression(call->object);
+            for (ASTNode*& argument : call->arguments) {
+                argument = expression(argument);
+            }
+            return node;
+        }
+        case EXPRESSION_MEMBER_ACCESS: {
+            auto* access = static_cast<MemberAccessNode*>(node);
+            access->object = expression(access->object);
+            return node;
+        }
+        default:
+            return node;
+        }
+    }
+
+    // rewrites the statements in place and drops the empty ones
+    void statements(NodeList& list) {
+        size_t kept = 0;
+        for (ASTNode* item : list) {
+            ASTNode* result = statement(item);
+            if (result->kind != STATEMENT_EMPTY) {
+                list[kept++] = result;
+            }
+        }
+        list = NodeList(list.begin(), kept);
+    }
+
+    ASTNode* ifStatement(IfStatementNode* node) {
+        const size_t start = scratch.size();
+        bool haveFirst = false;
+        // a constant true condition turns its body into the else of what is left
+        ASTNode* elseBody = nullptr;
+        bool chainDecided = false;
+
+        auto branch = [&](ASTNode* condition, ASTNode* body, ElseIfStatementNode* elseif) {
+            condition = expression(condition);
+            if (const auto* literal = condition->as<LiteralNode>()) {
+                if (isTruthy(literal)) {
+                    elseBody = statement(body);
+                    chainDecided = true;
+                }
+                return;
+            }
+            body = statement(body);
+            if (!haveFirst) {
+                node->condition = condition;
+                node->body = body;
+                haveFirst = true;
+            } else {
+                elseif->condition = condition;
+                elseif->body = body;
+                scratch.push_back(elseif);
+            }
+        };
+
+        // the if itself becomes an elseif only when it is dropped, so it never needs a new node
+        branch(node->condition, node->body, nullptr);
+        for (ASTNode* item : node->elseifBodies) {
+            if (chainDecided) {
+                break;
+            }
+            auto* elseif = static_cast<ElseIfStatementNode*>(item);
+            if (!haveFirst) {
+                branch(elseif->condition, elseif->body, nullptr);
+            } else {
+                branch(elseif->condition, elseif->body, elseif);
+            }
+        }
+        if (!chainDecided && node->elseBody != nullptr) {
+            elseBody = statement(node->elseBody);
+        }
+
+        if (!haveFirst) {
+            scratch.resize(start);
+            return elseBody != nullptr ? elseBody : arena.make<EmptyStatementNode>();
+        }
+        node->elseifBodies = NodeList::copy(arena, scratch.data() + start, scratch.data() + scratch.size());
+        scratch.resize(start);
+        node->elseBody = elseBody;
+        return node;
+    }
+
+    ASTNode* statement(ASTNode* node) {
+        switch (node->kind) {
+        case STATEMENT_BLOCK:
+            statements(static_cast<BlockStatementNode*>(node)->statements);
+            return node;
+
+        case STATEMENT_ASSIGNMENT: {
+            auto* assignment = static_cast<AssignmentStatementNode*>(node);
+            assignment->value = expression(assignment->value);
+            return node;
+        }
+
+        case STATEMENT_VARIABLE_DECLARATION: {
+            auto* declaration = static_cast<VariableDeclarationStatementNode*>(node);
+            declaration->value = expression(declaration->value);
+            return node;
+        }
+
+        case STATEMENT_GLOBAL_DECLARATION: {
+            auto* declaration = static_cast<GlobalDeclarationStatementNode*>(node);
+            declaration->value = expression(declaration->value);
+            return node;
+        }
+
+        case STATEMENT_IF:
+            return ifStatement(static_cast<IfStatementNode*>(node));
+
+        case STATEMENT_WHILE: {
+            auto* loop = static_cast<WhileStatementNode*>(node);
+            loop->condition = expression(loop->condition);
+            if (const auto* literal = loop->condition->as<LiteralNode>(); literal != nullptr && !isTruthy(literal)) {
+                return arena.make<EmptyStatementNode>();
+            }
+            loop->body = statement(loop->body);
+            return node;
+        }
+
+        // a known value could pick its case here, but a break in that case would then leave the
+        // enclosing loop instead of the switch
+        case STATEMENT_SWITCH: {
+            auto* statement = static_cast<SwitchStatementNode*>(node);
+            statement->value = expression(statement->value);
+            for (ASTNode* item : statement->cases) {
+                auto* entry = static_cast<SwitchCaseNode*>(item);
+                entry->body = this->statement(entry->body);
+            }
+            if (statement->defaultBody != nullptr) {
+                statement->defaultBody = this->statement(statement->defaultBody);
+            }
+            return node;
+        }
+
+        case STATEMENT_RETURN: {
+            auto* statement = static_cast<ReturnStatementNode*>(node);
+            if (statement->expressions != nullptr) {
+                statement->expressions = expression(statement->expressions);
+            }
+            return node;
+        }
+
+        case STATEMENT_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallStatementNode*>(node);
+            call->object = expression(call->object);
+            for (ASTNode*& argument : call->arguments) {
+                argument = expression(argument);
+            }
+            return node;
+        }
+
+        case STATEMENT_EMPTY:
+        case STATEMENT_BREAK:
+        case STATEMENT_CONTINUE:
+            return node;
+
+        default:
+            // expression statement
+            return expression(node);
+        }
+    }
+
+public:
+    Optimizer(Arena& arena, NumberPool& numbers) : arena(arena), numbers(numbers) {}
+
+    void run(NodeList& list) {
+        statements(list);
+    }
+};
+
+}
+
+size_t optimize(ParseResult& result) {
+    const size_t before = countNodes(result.statements);
+    Optimizer optimizer(result.arena, result.numbers);
+    optimizer.run(result.statements);
+    const size_t after = countNodes(result.statements);
+    return before > after ? before - after : 0;
+}
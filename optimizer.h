@@ -0,0 +1,14 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <cstddef>
+
+#include "parser.h"
+
+// folds literal-only expressions, drops identities like x * 1 and x + 0, and removes
+// if/elseif branches and while loops whose condition is a constant
+// the tree is rewritten in place, new nodes come from the ParseResult arena
+// returns how many nodes the tree lost
+size_t optimize(ParseResult& result);
+
+#endif //OPTIMIZER_H
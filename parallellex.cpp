@@ -0,0 +1,146 @@
+#include "parallellex.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "scanner.h"
+
+namespace {
+
+constexpr size_t none = SIZE_MAX;
+
+// tokens of one chunk lexed under one assumed starting state
+struct ChunkLex {
+    TokenBuffer tokens;
+    // when started inside a string: one past the quote that closes it, none when the chunk never closes it
+    size_t stringEnd = none;
+    // start of a string that is still open at the end of the chunk, none when the chunk ends between tokens
+    size_t openString = none;
+
+    [[nodiscard]] bool endsInsideString(const bool startedInside) const {
+        return openString != none || (startedInside && stringEnd == none);
+    }
+};
+
+void lexChunk(ChunkLex& chunk, const std::string_view source, const size_t begin, const size_t end, const bool insideString) {
+    size_t from = begin;
+    if (insideString) {
+        // the chunk starts after a newline, so no backslash in front of it can escape a quote in it
+        const size_t quote = findStringEnd(source.data(), begin, end);
+        if (quote == end) {
+            return;
+        }
+        chunk.stringEnd = quote + 1;
+        from = quote + 1;
+    }
+
+    // every chunk but the last ends right after a newline, so a string is the only token that can run past it
+    TokenBuffer& tokens = chunk.tokens;
+    tokens.source = source.substr(0, end);
+    tokens.reserve((end - from) / 8 + 16);
+    const size_t stop = lexTokens(tokens, from, end == source.size(), SIZE_MAX);
+    if (stop < end) {
+        chunk.openString = stop;
+    }
+}
+
+// appends the chunk's tokens, moving its identifiers and numbers over to the ids of the merged tables
+// chunks are appended in source order and each table numbers its entries by first appearance,
+// so the merged ids come out the same as a serial run
+void appendChunk(TokenBuffer& tokens, const TokenBuffer& chunk, std::vector<uint32_t>& symbols, std::vector<uint32_t>& numbers) {
+    symbols.resize(chunk.symbols.size());
+    for (uint32_t symbol = 0; symbol < chunk.symbols.size(); ++symbol) {
+        symbols[symbol] = tokens.symbols.intern(chunk.symbols.name(symbol));
+    }
+    numbers.resize(chunk.numbers.size());
+    for (uint32_t number = 0; number < chunk.numbers.size(); ++number) {
+        numbers[number] = tokens.numbers.add(chunk.numbers[number]);
+    }
+
+    tokens.kinds.insert(tokens.kinds.end(), chunk.kinds.begin(), chunk.kinds.end());
+    tokens.offsets.insert(tokens.offsets.end(), chunk.offsets.begin(), chunk.offsets.end());
+    tokens.lengths.insert(tokens.lengths.end(), chunk.lengths.begin(), chunk.lengths.end());
+
+    // payloads and tokens are both sorted by offset, walk them side by side to find each payload's token
+    size_t index = 0;
+    for (TokenBuffer::Payload payload : chunk.payloads) {
+        while (chunk.offsets[index] < payload.offset) {
+            ++index;
+        }
+        payload.value = chunk.type(index) == TOK_IDENTIFIER ? symbols[payload.value] : numbers[payload.value];
+        tokens.payloads.push_back(payload);
+    }
+}
+
+}
+
+TokenBuffer tokenizeParallel(const std::string_view source, ThreadPool& pool, size_t minChunkSize) {
+    if (source.size() > UINT32_MAX) {
+        throw std::runtime_error("Source too large: " + std::to_string(source.size()) + " bytes");
+    }
+    minChunkSize = std::max<size_t>(minChunkSize, 1);
+    if (pool.size() < 2 || source.size() < 2 * minChunkSize) {
+        return tokenize(source);
+    }
+
+    // a few chunks per thread, so stealing can even out chunks that lex slower than others
+    const size_t chunkSize = std::max(minChunkSize, source.size() / (pool.size() * 4));
+    std::vector<size_t> bounds{0};
+    while (bounds.back() < source.size()) {
+        const size_t target = std::min(bounds.back() + chunkSize, source.size());
+        const size_t newline = findNewline(source.data(), target, source.size());
+        bounds.push_back(newline == source.size() ? newline : newline + 1);
+    }
+    const size_t chunkCount = bounds.size() - 1;
+    if (chunkCount < 2) {
+        return tokenize(source);
+    }
+
+    // results[2 * chunk + insideString], the first chunk always starts between tokens
+    std::vector<ChunkLex> results(2 * chunkCount);
+    std::vector<size_t> tasks;
+    tasks.reserve(2 * chunkCount - 1);
+    for (size_t task = 0; task < 2 * chunkCount; ++task) {
+        if (task != 1) {
+            tasks.push_back(task);
+        }
+    }
+    pool.forEach(tasks, [&](const size_t task) {
+        const size_t chunk = task / 2;
+        lexChunk(results[task], source, bounds[chunk], bounds[chunk + 1], task % 2 == 1);
+    });
+
+    TokenBuffer tokens;
+    tokens.source = source;
+    size_t total = 1;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        total += std::max(results[2 * chunk].tokens.size(), results[2 * chunk + 1].tokens.size()) + 1;
+    }
+    tokens.reserve(total);
+
+    std::vector<uint32_t> symbols;
+    std::vector<uint32_t> numbers;
+    bool insideString = false;
+    size_t openString = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        const ChunkLex& result = results[2 * chunk + (insideString ? 1 : 0)];
+        if (insideString && result.stringEnd != none) {
+            tokens.push(TOK_STRING, openString, result.stringEnd - openString);
+        }
+        appendChunk(tokens, result.tokens, symbols, numbers);
+        const bool endsInside = result.endsInsideString(insideString);
+        if (result.openString != none) {
+            openString = result.openString;
+        }
+        insideString = endsInside;
+    }
+    if (insideString) {
+        // unterminated, same as the serial lexer
+        tokens.push(TOK_UNKNOWN, openString, source.size() - openString);
+    }
+
+    tokens.push(TOK_EOF, source.size(), 0);
+    return tokens;
+}
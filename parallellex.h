@@ -0,0 +1,18 @@
+#ifndef PARALLELLEX_H
+#define PARALLELLEX_H
+
+#include <cstddef>
+#include <string_view>
+
+#include "threadpool.h"
+#include "tokenize.h"
+
+// tokenizes one large source on the pool, the result is identical to tokenize(source)
+// the source is cut into chunks right after a newline, where the lexer can only be in one of two states:
+// between tokens, or inside a string that an earlier chunk opened (comments end at the newline)
+// every chunk after the first is lexed speculatively under both states at once, then a serial
+// stitch pass walks the chunks in order and keeps whichever result matches the real state
+// sources smaller than two chunks are handed to tokenize() directly
+TokenBuffer tokenizeParallel(std::string_view source, ThreadPool& pool, size_t minChunkSize = 256 * 1024);
+
+#endif //PARALLELLEX_H
@@ -3,271 +3,816 @@
 //
 
 #include "parser.h"
+#include "stats.h"
 
-#include <unordered_set>
+#include <string>
+#include <string_view>
 
-const std::unordered_set<std::string> rightNeededExpressionSet = {
-    "=", "+", "-", "*", "/", "%", "+=", "-=", "*=", "/=", "%=",
-    "==", "!=", ">", "<", ">=", "<=", "&&", "||",
-    "&", "|", "^", "<<", ">>"
-};
+namespace {
 
-std::shared_ptr<ASTNode> Parser::parsePrimary()
-{
-    Token token = currentToken();
-    std::shared_ptr<ASTNode> expression;
+// appends the text of a string literal between its quotes to out with its escapes decoded,
+// false when a backslash is followed by something that is no escape (it is then kept as it is)
+bool decodeEscapes(const std::string_view text, std::string& out) {
+    bool valid = true;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            out += text[i];
+            continue;
+        }
+        switch (text[++i]) {
+        case 'n':  out += '\n'; break;
+        case 't':  out += '\t'; break;
+        case 'r':  out += '\r'; break;
+        case '0':  out += '\0'; break;
+        case '\\': out += '\\'; break;
+        case '"':  out += '"'; break;
+        case '\'': out += '\''; break;
+        default:
+            out += '\\';
+            out += text[i];
+            valid = false;
+            break;
+        }
+    }
+    return valid;
+}
 
-    switch (token.type) {
-    case TOK_IDENTIFIER:
-        expression = std::make_shared<VariableNode>(token.value);
-        consume(TOK_IDENTIFIER);
+}
 
-        while (lookCurrent(TOK_DOT)) {
-            consume(TOK_DOT);
-            const Token nextToken = currentToken();
-            expect(TOK_IDENTIFIER);
+// binary operators that need a right hand expression
+constexpr bool isRightNeededOperator(const TokenType type) {
+    switch (type) {
+    case TOK_ASSIGNMENT: case TOK_ADDITION: case TOK_SUBTRACTION: case TOK_MULTIPLICATION:
+    case TOK_DIVISION: case TOK_MODULUS: case TOK_ADDITION_ASSIGNMENT: case TOK_SUBTRACTION_ASSIGNMENT:
+    case TOK_MULTIPLICATION_ASSIGNMENT: case TOK_DIVISION_ASSIGNMENT: case TOK_MODULUS_ASSIGNMENT:
+    case TOK_EQUAL: case TOK_NOT_EQUAL: case TOK_GREATER: case TOK_LESS: case TOK_GREATER_EQUAL:
+    case TOK_LESS_EQUAL: case TOK_AND: case TOK_OR: case TOK_BITWISE_AND: case TOK_BITWISE_OR:
+    case TOK_BITWISE_XOR: case TOK_LEFT_SHIFT: case TOK_RIGHT_SHIFT:
+        return true;
+    default:
+        return false;
+    }
+}
 
-            std::string nextTokenValue = nextToken.value;
-            consume(TOK_IDENTIFIER);
+// the binary operator a compound assignment or a '++' / '--' applies, TOK_EOF for any other token
+constexpr TokenType compoundOperation(const TokenType type) {
+    switch (type) {
+    case TOK_ADDITION_ASSIGNMENT: case TOK_INCREMENT:
+        return TOK_ADDITION;
+    case TOK_SUBTRACTION_ASSIGNMENT: case TOK_DECREMENT:
+        return TOK_SUBTRACTION;
+    case TOK_MULTIPLICATION_ASSIGNMENT:
+        return TOK_MULTIPLICATION;
+    case TOK_DIVISION_ASSIGNMENT:
+        return TOK_DIVISION;
+    case TOK_MODULUS_ASSIGNMENT:
+        return TOK_MODULUS;
+    default:
+        return TOK_EOF;
+    }
+}
 
-            expression = std::make_shared<MemberAccessNode>(expression, nextTokenValue);
+void Parser::report(const DiagnosticCode code, const TokenType expected) {
+    const auto token = static_cast<uint32_t>(discarded + current);
+    if (!diagnostics->empty() && diagnostics->back().token == token) {
+        return;
+    }
+    const bool valid = current < tokens.size();
+    diagnostics->report({code, static_cast<uint8_t>(expected), static_cast<uint8_t>(typeAt(current)), token,
+                         valid ? tokens.offsets[current] : static_cast<uint32_t>(tokens.sourceBase + tokens.source.size()),
+                         valid ? tokens.lengths[current] : 0});
+}
 
-            if (lookCurrent(TOK_OPEN_PAREN)) {
-                std::vector<std::shared_ptr<ASTNode>> arguments;
-                consume(TOK_OPEN_PAREN);
+bool Parser::canNest() {
+    if (bodies.size() + openBrackets < nestingLimit) {
+        return true;
+    }
+    report(DIAG_NESTING_TOO_DEEP);
+    return false;
+}
 
-                while (!lookCurrent(TOK_CLOSE_PAREN)) {
-                    arguments.push_back(parseExpression());
-                    if (lookCurrent(TOK_COMMA)) {
-                        consume(TOK_COMMA);
-                    }
-                }
+Parsed<ASTNode*> Parser::parseOperand()
+{
+    const Token token = currentToken();
+    ASTNode* expression;
 
-                consume(TOK_CLOSE_PAREN);
-                expression = std::make_shared<FunctionCallNode>(expression, arguments);
-            }
+    switch (token.type) {
+    case TOK_IDENTIFIER:
+        expression = makeVariable();
+        advance();
+        return parseMembers(expression);
+
+    case TOK_NUMBER: {
+        // the lexer already decoded the value, the payload is its id in the token buffer's pool
+        const std::optional<uint32_t> value = tokens.payload(current);
+        if (!value) {
+            report(DIAG_INVALID_NUMBER);
+            return failed();
         }
-
-        break;
-
-    case TOK_NUMBER:
-        expression = std::make_shared<LiteralNode>(LITERAL_NUMBER, std::make_shared<NumberNode>(std::stoi(token.value)));
-        consume(TOK_NUMBER);
+        expression = make<LiteralNode>(LITERAL_NUMBER, make<NumberNode>(numbers->add(tokens.numbers[*value])));
+        advance();
         break;
+    }
 
-    case TOK_STRING:
-        expression = std::make_shared<LiteralNode>(LITERAL_STRING, std::make_shared<StringNode>(token.value));
-        consume(TOK_STRING);
+    case TOK_STRING: {
+        // the node holds the string's value, the quotes are dropped and the escapes decoded here
+        const std::string_view text = token.value.substr(1, token.value.size() - 2);
+        std::string_view value;
+        if (text.find('\\') == std::string_view::npos) {
+            value = arena->copyString(text);
+        } else {
+            std::string decoded;
+            if (!decodeEscapes(text, decoded)) {
+                report(DIAG_INVALID_ESCAPE);
+            }
+            value = arena->copyString(decoded);
+        }
+        expression = make<LiteralNode>(LITERAL_STRING, make<StringNode>(value));
+        advance();
         break;
+    }
 
     case TOK_TRUE:
-        expression = std::make_shared<LiteralNode>(LITERAL_TRUE, std::make_shared<BooleanNode>(true));
-        consume(TOK_TRUE);
+        expression = make<LiteralNode>(LITERAL_TRUE, make<BooleanNode>(true));
+        advance();
         break;
 
     case TOK_FALSE:
-        expression = std::make_shared<LiteralNode>(LITERAL_FALSE, std::make_shared<BooleanNode>(false));
-        consume(TOK_FALSE);
+        expression = make<LiteralNode>(LITERAL_FALSE, make<BooleanNode>(false));
+        advance();
         break;
 
-    case TOK_OPEN_PAREN: { // Handle '(' for sub-expressions
-            consume(TOK_OPEN_PAREN); // Consume '('
+    default:
+        report(DIAG_EXPECTED_EXPRESSION);
+        return failed();
+    }
 
-            // Parse the sub-expression inside the parentheses
-            auto subExpr = parseExpression(0); // Reset precedence to 0 inside the parentheses
+    return expression;
+}
 
-            // Ensure we have a matching ')'
-            if (currentToken().type != TOK_CLOSE_PAREN) {
-                throw std::runtime_error("Expected ')' after sub-expression");
-            }
-            consume(TOK_CLOSE_PAREN); // Consume ')'
+Parsed<ASTNode*> Parser::parseMembers(ASTNode* expression) {
+    while (lookCurrent(TOK_DOT)) {
+        advance();
+        if (!expect(TOK_IDENTIFIER)) {
+            return failed();
+        }
 
-            return subExpr; // Return the result of the sub-expression
-    }
+        const std::string_view nextTokenValue = arena->copyString(currentToken().value);
+        const uint32_t memberSymbol = symbolAt(current);
+        advance();
 
-    case TOK_EOF:
-        throw std::runtime_error("Unexpected end of file");
+        expression = make<MemberAccessNode>(expression, nextTokenValue, memberSymbol);
 
-    default:
-        throw std::runtime_error("Unexpected token: " + tokenTypeToString(currentToken().type) +
-            + " Position: " + std::to_string(currentToken().position) + " | String: " + currentToken().value);
+        if (lookCurrent(TOK_OPEN_PAREN)) {
+            if (!openBracket(FRAME_CALL, expression)) {
+                return failed();
+            }
+            if (!lookCurrent(TOK_CLOSE_PAREN)) {
+                return nullptr;
+            }
+            advance();
+            expression = closeCall();
+        }
     }
-
     return expression;
 }
 
-std::shared_ptr<ASTNode> Parser::parseExpression(int precedence) {
-    auto left = parsePrimary();
+bool Parser::openBracket(const ExpressionFrameKind kind, ASTNode* callee) {
+    if (!canNest()) {
+        return false;
+    }
+    ++openBrackets;
+    expressionStack.push_back({kind, TOK_EOF, 0, callee, scratch.size()});
+    deepestExpression = std::max(deepestExpression, static_cast<uint32_t>(expressionStack.size()));
+    advance();
+    return true;
+}
+
+ASTNode* Parser::closeCall() {
+    const ExpressionFrame frame = expressionStack.back();
+    expressionStack.pop_back();
+    --openBrackets;
+    return make<FunctionCallNode>(frame.node, takeList(frame.arguments));
+}
 
-    while (true) {
-        Token token = currentToken();
-        int currentPrecedence = getOperatorPrecedence(token.type);
+Parsed<ASTNode*> Parser::parseExpression(const bool primaryOnly) {
+    // expressions never contain statements, so only one uses the stack at a time
+    expressionStack.clear();
+    openBrackets = 0;
 
+    while (true) {
+        // an operand, behind any number of '('
+        while (lookCurrent(TOK_OPEN_PAREN)) {
+            if (!openBracket(FRAME_PAREN, nullptr)) {
+                return failed();
+            }
+        }
+        const Parsed<ASTNode*> operand = parseOperand();
+        if (!operand) {
+            return failed();
+        }
+        ASTNode* node = *operand;
+
+        // fold operands into the frames until the next operand is needed
+        while (node != nullptr) {
+            const TokenType type = typeAt(current);
+            if (isRightNeededOperator(type) && !(primaryOnly && expressionStack.empty())) {
+                // operators of the same precedence group to the left
+                const int precedence = getOperatorPrecedence(type);
+                while (!expressionStack.empty() && expressionStack.back().kind == FRAME_OPERATOR &&
+                       expressionStack.back().precedence >= precedence) {
+                    node = make<BinaryOperationNode>(expressionStack.back().node, expressionStack.back().operation, node);
+                    expressionStack.pop_back();
+                }
+                expressionStack.push_back({FRAME_OPERATOR, type, precedence, node, 0});
+                deepestExpression = std::max(deepestExpression, static_cast<uint32_t>(expressionStack.size()));
+                advance();
+                break;
+            }
 
-        if (rightNeededExpressionSet.contains(token.value) && currentPrecedence >= precedence) {
-            consume(token.type);
+            // anything else ends every operator waiting in front of it
+            while (!expressionStack.empty() && expressionStack.back().kind == FRAME_OPERATOR) {
+                node = make<BinaryOperationNode>(expressionStack.back().node, expressionStack.back().operation, node);
+                expressionStack.pop_back();
+            }
+            if (expressionStack.empty()) {
+                return node;
+            }
 
-            auto right = parseExpression(currentPrecedence + 1); // recurse into expression to find if theres more
+            if (expressionStack.back().kind == FRAME_PAREN) {
+                if (!consume(TOK_CLOSE_PAREN)) {
+                    return failed();
+                }
+                expressionStack.pop_back();
+                --openBrackets;
+                continue;
+            }
 
-            left = std::make_shared<BinaryOperationNode>(left, token.type, right);
-        } else {
-            break;
+            // an argument of the call on top
+            scratch.push_back(node);
+            if (lookCurrent(TOK_COMMA)) {
+                advance();
+            }
+            if (!lookCurrent(TOK_CLOSE_PAREN)) {
+                break;
+            }
+            advance();
+            const Parsed<ASTNode*> members = parseMembers(closeCall());
+            if (!members) {
+                return failed();
+            }
+            node = *members;
         }
     }
-
-    return left;
 }
 
-std::shared_ptr<ASTNode> Parser::parseAssignmentStatement(std::shared_ptr<ASTNode> primary)
+Parsed<ASTNode*> Parser::parseAssignmentStatement(ASTNode* primary)
 {
-    consume(TOK_ASSIGNMENT);
-    auto valueNode = parseExpression();
-    return std::make_shared<AssignmentStatementNode>(primary, valueNode);
+    advance();
+    const Parsed<ASTNode*> valueNode = parseExpression();
+    if (!valueNode) {
+        return valueNode;
+    }
+    return make<AssignmentStatementNode>(primary, *valueNode);
 }
 
-std::shared_ptr<ASTNode> Parser::parseVariableDeclarationStatement()
+Parsed<ASTNode*> Parser::parseCompoundAssignment(ASTNode* target, const TokenType operation)
 {
-
-    consume(TOK_VAR);
-    Token variableToken = currentToken();
-    auto variableNode = std::make_shared<VariableNode>(variableToken.value);
-    // check if its var<identifier>
-    if (lookCurrent(TOK_ELSEIF_STATEMENT)) {
-        consume(TOK_IDENTIFIER);
+    const bool step = lookCurrent(TOK_INCREMENT) || lookCurrent(TOK_DECREMENT);
+    advance();
+    if (step) {
+        return lowerCompoundAssignment(target, operation, makeOne());
     }
-    consume(TOK_IDENTIFIER);
-    consume(TOK_ASSIGNMENT);
-    auto valueNode = parseExpression();
-    consume(TOK_SEMICOLON);
-    return std::make_shared<VariableDeclarationStatementNode>(variableNode, valueNode);
+    const Parsed<ASTNode*> valueNode = parseExpression();
+    if (!valueNode) {
+        return valueNode;
+    }
+    return lowerCompoundAssignment(target, operation, *valueNode);
 }
 
-std::shared_ptr<ASTNode> Parser::parseGlobalDeclarationStatement()
+ASTNode* Parser::lowerCompoundAssignment(ASTNode* target, const TokenType operation, ASTNode* value)
 {
-    consume(TOK_GLOBAL_VAR);
-    Token variableToken = currentToken();
-    auto variableNode = std::make_shared<VariableNode>(variableToken.value);
-    consume(TOK_IDENTIFIER);
-    consume(TOK_ASSIGNMENT);
-    auto valueNode = parseExpression();
-    consume(TOK_SEMICOLON);
-    return std::make_shared<GlobalDeclarationStatementNode>(variableNode, valueNode);
+    // the read gets a node of its own, checkTypes() gives it the type from before the store
+    ASTNode* read = target;
+    if (target->kind == NODE_VARIABLE) {
+        const auto* variable = static_cast<const VariableNode*>(target);
+        read = make<VariableNode>(variable->name, variable->symbol);
+    }
+    return make<AssignmentStatementNode>(target, make<BinaryOperationNode>(read, operation, value));
 }
 
-std::shared_ptr<ASTNode> Parser::parseIfStatement()
+Parsed<VariableType> Parser::parseDeclaredType()
 {
-    consume(TOK_IF_STATEMENT);
-    consume(TOK_OPEN_PAREN);
-    auto condition = parseExpression(); // parse the condition
-    consume(TOK_CLOSE_PAREN);
-    consume(TOK_OPEN_BRACE);
-    if (lookCurrent(TOK_CLOSE_BRACE)) {
-        // empty body
+    // var<number>, var<string> or var<bool>
+    if (!lookCurrent(TOK_LESS)) {
+        return VARIABLE_GENERIC;
     }
-    auto body = parseStatement(true); // parse body
-    consume(TOK_CLOSE_BRACE);
+    advance();
+    if (!expect(TOK_VAR_TYPE)) {
+        return failed();
+    }
+    const std::string_view name = currentToken().value;
+    const VariableType declared = name == "number" ? VARIABLE_NUMBER : name == "string" ? VARIABLE_STRING : VARIABLE_BOOLEAN;
+    advance();
+    if (!consume(TOK_GREATER)) {
+        return failed();
+    }
+    return declared;
+}
 
-    // look for elseif statemets, can be more than one
-    auto elseifBodies = std::vector<std::shared_ptr<ASTNode>>();
-    while (lookCurrent(TOK_ELSEIF_STATEMENT)) {
-        consume(TOK_ELSEIF_STATEMENT);
-        consume(TOK_OPEN_PAREN);
-        auto elseifCondition = parseExpression(); // parse the condition
-        consume(TOK_CLOSE_PAREN);
-        consume(TOK_OPEN_BRACE);
-        auto elseifBody = parseStatement(true); // parse body
-        consume(TOK_CLOSE_BRACE);
-        elseifBodies.push_back(std::make_shared<ElseIfStatementNode>(elseifCondition, elseifBody));
+Parsed<ASTNode*> Parser::parseVariableDeclarationStatement()
+{
+    advance();
+    const Parsed<VariableType> declared = parseDeclaredType();
+    if (!declared) {
+        return failed();
+    }
+    auto variableNode = makeVariable();
+    if (!consume(TOK_IDENTIFIER) || !consume(TOK_ASSIGNMENT)) {
+        return failed();
     }
+    const Parsed<ASTNode*> valueNode = parseExpression();
+    if (!valueNode || !consume(TOK_SEMICOLON)) {
+        return failed();
+    }
+    return make<VariableDeclarationStatementNode>(variableNode, *valueNode, *declared);
+}
 
-    // look for else statement
-    std::shared_ptr<ASTNode> elseBody = nullptr;
-    if (lookCurrent(TOK_ELSE_STATEMENT)) {
-        consume(TOK_ELSE_STATEMENT);
-        consume(TOK_OPEN_BRACE);
-        elseBody = parseStatement(true); // parse body
-        consume(TOK_CLOSE_BRACE);
+Parsed<ASTNode*> Parser::parseGlobalDeclarationStatement()
+{
+    advance();
+    // global var name = ..., global var<number> name = ... or just global name = ...
+    VariableType declared = VARIABLE_GENERIC;
+    if (lookCurrent(TOK_VAR)) {
+        advance();
+        const Parsed<VariableType> type = parseDeclaredType();
+        if (!type) {
+            return failed();
+        }
+        declared = *type;
+    }
+    auto variableNode = makeVariable();
+    if (!consume(TOK_IDENTIFIER) || !consume(TOK_ASSIGNMENT)) {
+        return failed();
+    }
+    const Parsed<ASTNode*> valueNode = parseExpression();
+    if (!valueNode || !consume(TOK_SEMICOLON)) {
+        return failed();
     }
+    return make<GlobalDeclarationStatementNode>(variableNode, *valueNode, declared);
+}
 
-    return std::make_shared<IfStatementNode>(condition, body, elseifBodies, elseBody);
+Parsed<ASTNode*> Parser::parseIfStatement(const StatementMark& mark)
+{
+    advance();
+    if (!consume(TOK_OPEN_PAREN)) {
+        return failed();
+    }
+    const Parsed<ASTNode*> condition = parseExpression(); // parse the condition
+    if (!condition || !consume(TOK_CLOSE_PAREN) || !expect(TOK_OPEN_BRACE) || !canNest()) {
+        return failed();
+    }
+    advance();
+    openBody(BODY_IF, mark, *condition);
+    return nullptr;
 }
 
-std::shared_ptr<ASTNode> Parser::parseForStatement()
+Parsed<ASTNode*> Parser::parseForStatement()
 {
-    throw std::runtime_error("for loop not implemented");
+    report(DIAG_NOT_IMPLEMENTED);
+    return failed();
 }
 
 
-std::shared_ptr<ASTNode> Parser::parseWhileStatement()
+Parsed<ASTNode*> Parser::parseWhileStatement(const StatementMark& mark)
+{
+    advance();
+    if (!consume(TOK_OPEN_PAREN)) {
+        return failed();
+    }
+    const Parsed<ASTNode*> condition = parseExpression(); // parse the condition
+    if (!condition || !consume(TOK_CLOSE_PAREN) || !expect(TOK_OPEN_BRACE) || !canNest()) {
+        return failed();
+    }
+    advance();
+    openBody(BODY_WHILE, mark, *condition);
+    return nullptr;
+}
+
+Parsed<ASTNode*> Parser::parseSwitchStatement(const StatementMark& mark)
 {
-    consume(TOK_WHILE_STATEMENT);
-    consume(TOK_OPEN_PAREN);
-    auto condition = parseExpression(); // parse the condition
-    consume(TOK_CLOSE_PAREN);
-    consume(TOK_OPEN_BRACE);
-    auto body = parseStatement(true); // parse body
-    consume(TOK_CLOSE_BRACE);
-    return std::make_shared<WhileStatementNode>(condition, body);
+    advance();
+    if (!consume(TOK_OPEN_PAREN)) {
+        return failed();
+    }
+    const Parsed<ASTNode*> value = parseExpression();
+    if (!value || !consume(TOK_CLOSE_PAREN) || !expect(TOK_OPEN_BRACE) || !canNest()) {
+        return failed();
+    }
+    advance();
+    // a switch without cases only evaluates its value
+    if (lookCurrent(TOK_CLOSE_BRACE)) {
+        advance();
+        return make<SwitchStatementNode>(*value, NodeList(), nullptr);
+    }
+    openBody(BODY_CASE, mark, *value);
+    bodies.back().elseIfs = scratch.size();
+    if (!openCase()) {
+        // skip to the switch's own '}' instead of stopping in front of it
+        bodies.pop_back();
+        rollback(mark, 1);
+    }
+    return nullptr;
+}
+
+bool Parser::openCase() {
+    OpenBody& body = bodies.back();
+    LiteralNode* label = nullptr;
+    if (lookCurrent(TOK_DEFAULT_STATEMENT)) {
+        if (body.body != nullptr) {
+            report(DIAG_DUPLICATE_DEFAULT);
+        }
+        advance();
+    } else {
+        if (!consume(TOK_CASE_STATEMENT)) {
+            return false;
+        }
+        const TokenType type = typeAt(current);
+        if (type != TOK_NUMBER && type != TOK_STRING) {
+            report(type == TOK_EOF ? DIAG_EXPECTED_EXPRESSION : DIAG_INVALID_CASE_LABEL);
+            return false;
+        }
+        // the compiler builds one table per switch, keyed by either integers or strings
+        const LiteralType kind = type == TOK_NUMBER ? LITERAL_NUMBER : LITERAL_STRING;
+        const std::optional<uint32_t> number = type == TOK_NUMBER ? tokens.payload(current) : std::nullopt;
+        const bool isFloat = number && tokens.numbers[*number].kind == NUMBER_FLOAT;
+        const bool mixed = scratch.size() > body.elseIfs && static_cast<SwitchCaseNode*>(scratch[body.elseIfs])->label->type != kind;
+        if (isFloat || mixed) {
+            report(DIAG_INVALID_CASE_LABEL);
+        }
+        const Parsed<ASTNode*> literal = parseOperand();
+        if (!literal) {
+            return false;
+        }
+        label = static_cast<LiteralNode*>(*literal);
+    }
+    if (!consume(TOK_COLON)) {
+        return false;
+    }
+    body.elseIfCondition = label;
+    body.first = current;
+    body.statements = scratch.size();
+    body.starts = spanStarts.size();
+    return true;
 }
 
 
-std::shared_ptr<ASTNode> Parser::parseReturnStatement()
+Parsed<ASTNode*> Parser::parseReturnStatement()
 {
-    consume(TOK_RETURN_STATEMENT);
-    auto expression = parseExpression();
-    consume(TOK_SEMICOLON);
-    return std::make_shared<ReturnStatementNode>(expression);
+    advance();
+    const Parsed<ASTNode*> expression = parseExpression();
+    if (!expression || !consume(TOK_SEMICOLON)) {
+        return failed();
+    }
+    return make<ReturnStatementNode>(*expression);
 }
 
-std::shared_ptr<ASTNode> Parser::parseStatement(const bool isBody) {
-    std::vector<std::shared_ptr<ASTNode>> statements;
+Parsed<ASTNode*> Parser::parseNextStatement(const StatementMark& mark) {
+    switch (typeAt(current)) {
+    case TOK_VAR:
+        return parseVariableDeclarationStatement();
+    case TOK_GLOBAL_VAR:
+        return parseGlobalDeclarationStatement();
+    case TOK_FOR_STATEMENT:
+        return parseForStatement();
+    case TOK_WHILE_STATEMENT:
+        return parseWhileStatement(mark);
+    case TOK_IF_STATEMENT:
+        return parseIfStatement(mark);
+    case TOK_SWITCH_STATEMENT:
+        return parseSwitchStatement(mark);
+    case TOK_CASE_STATEMENT:
+    case TOK_DEFAULT_STATEMENT:
+        // the cases of a switch are picked up by closeBody(), one here is out of place
+        report(DIAG_CASE_OUTSIDE_SWITCH);
+        return failed();
+    case TOK_RETURN_STATEMENT:
+        return parseReturnStatement();
+    case TOK_IDENTIFIER: {
+        const Parsed<ASTNode*> primaryExpression = parseExpression(true);
+        if (!primaryExpression) {
+            return primaryExpression;
+        }
+
+        // check if current is assignment
+        if (lookCurrent(TOK_ASSIGNMENT)) {
+            return parseAssignmentStatement(*primaryExpression);
+        }
+        if (const TokenType operation = compoundOperation(typeAt(current)); operation != TOK_EOF) {
+            return parseCompoundAssignment(*primaryExpression, operation);
+        }
+        // if not, its a standalone function call or expression
+        return primaryExpression;
+    }
+    case TOK_INCREMENT:
+    case TOK_DECREMENT: {
+        const TokenType operation = compoundOperation(typeAt(current));
+        advance();
+        if (!expect(TOK_IDENTIFIER)) {
+            return failed();
+        }
+        const Parsed<ASTNode*> target = parseExpression(true);
+        if (!target) {
+            return target;
+        }
+        return lowerCompoundAssignment(*target, operation, makeOne());
+    }
+    case TOK_BREAK_STATEMENT:
+        advance();
+        if (!consume(TOK_SEMICOLON)) {
+            return failed();
+        }
+        return make<BreakStatementNode>();
+    case TOK_CONTINUE_STATEMENT:
+        advance();
+        if (!consume(TOK_SEMICOLON)) {
+            return failed();
+        }
+        return make<ContinueStatementNode>();
+    case TOK_ADDITION_ASSIGNMENT:
+    case TOK_SUBTRACTION_ASSIGNMENT:
+    case TOK_MULTIPLICATION_ASSIGNMENT:
+    case TOK_DIVISION_ASSIGNMENT:
+    case TOK_MODULUS_ASSIGNMENT:
+        // only a variable can be updated, anything else in front of the operator ended a statement
+        report(DIAG_UNEXPECTED_TOKEN, TOK_SEMICOLON);
+        return failed();
+    case TOK_SEMICOLON:
+        // an empty statement, or the end of an expression statement
+        advance();
+        return nullptr;
+    default:
+        report(DIAG_EXPECTED_STATEMENT);
+        return failed();
+    }
+}
 
-    while (isBody) {
-        if (lookCurrent(TOK_EOF) || lookCurrent(TOK_CLOSE_BRACE)) {
+void Parser::synchronize(const size_t start, uint32_t depth) {
+    // a statement ends at a ';' outside of braces or at the '}' closing a block it opened;
+    // a '}' closing the enclosing block or EOF stop in front of them
+    while (!lookCurrent(TOK_EOF)) {
+        const TokenType type = typeAt(current);
+        if (type == TOK_CLOSE_BRACE && depth == 0) {
             break;
         }
+        advance();
+        if (type == TOK_OPEN_BRACE) {
+            ++depth;
+        } else if (type == TOK_CLOSE_BRACE && --depth == 0) {
+            return;
+        } else if (type == TOK_SEMICOLON && depth == 0) {
+            return;
+        }
+    }
+    // every statement consumes its first token, this only guards against looping in place
+    if (current == start && !lookCurrent(TOK_EOF) && !lookCurrent(TOK_CLOSE_BRACE)) {
+        advance();
+    }
+}
 
-        if (lookCurrent(TOK_VAR)) {
-            statements.push_back(parseVariableDeclarationStatement());
-        } else if (lookCurrent(TOK_GLOBAL_VAR)) {
-            statements.push_back(parseGlobalDeclarationStatement());
-        } else if (lookCurrent(TOK_FOR_STATEMENT)) {
-            statements.push_back(parseForStatement());
-        } else if (lookCurrent(TOK_WHILE_STATEMENT)) {
-            statements.push_back(parseWhileStatement());
-        } else if (lookCurrent(TOK_IF_STATEMENT)) {
-            statements.push_back(parseIfStatement());
-        } else if (lookCurrent(TOK_RETURN_STATEMENT)) {
-            statements.push_back(parseReturnStatement());
-        } else if (lookCurrent(TOK_IDENTIFIER)) {
-            auto primaryExpression = parsePrimary();
-
-            // check if current is assignment
-            if (lookCurrent(TOK_ASSIGNMENT)) {
-                statements.push_back(parseAssignmentStatement(primaryExpression));
-            } else {
-                // if not, its a standalone function call or expression
-                statements.push_back(primaryExpression);
-            }
-        } else if (lookCurrent(TOK_BREAK_STATEMENT)) {
-            consume(TOK_BREAK_STATEMENT);
-            consume(TOK_SEMICOLON);
-            statements.push_back(std::make_shared<BreakStatementNode>());
-        } else if (lookCurrent(TOK_CONTINUE_STATEMENT)) {
-            consume(TOK_CONTINUE_STATEMENT);
-            consume(TOK_SEMICOLON);
-            statements.push_back(std::make_shared<ContinueStatementNode>());
+Parser::StatementMark Parser::markStatement() const {
+    return {current, scratch.size(), spanStarts.size(), spans != nullptr ? spans->size() : 0};
+}
+
+void Parser::addStatement(ASTNode* statement, const size_t start) {
+    scratch.push_back(statement);
+    if (spans != nullptr) {
+        spanStarts.push_back(static_cast<uint32_t>(start));
+    }
+}
+
+void Parser::rollback(const StatementMark& mark, const uint32_t depth) {
+    scratch.resize(mark.statements);
+    spanStarts.resize(mark.starts);
+    if (spans != nullptr) {
+        spans->resize(mark.blocks);
+    }
+    synchronize(mark.start, depth);
+}
+
+void Parser::openBody(const BodyKind kind, const StatementMark& mark, ASTNode* condition) {
+    bodies.push_back({kind, mark, current, scratch.size(), spanStarts.size(), condition, nullptr});
+    // the statements of a whole program count as the first level
+    deepestStatement = std::max(deepestStatement, static_cast<uint32_t>(bodies.size() + 1));
+}
+
+void Parser::closeBody() {
+    OpenBody& body = bodies.back();
+    ASTNode* block = finishBlock(body.first, body.statements, body.starts);
+    const auto fail = [&](const uint32_t depth = 0) {
+        const StatementMark mark = body.mark;
+        bodies.pop_back();
+        rollback(mark, depth);
+    };
+    const auto finish = [&](ASTNode* statement) {
+        const size_t start = body.mark.start;
+        bodies.pop_back();
+        addStatement(statement, start);
+    };
+
+    // a case's body ends at the next case, the cases collect on scratch like else ifs and the
+    // switch's entry is reused for each of them
+    if (body.kind == BODY_CASE) {
+        if (body.elseIfCondition != nullptr) {
+            scratch.push_back(make<SwitchCaseNode>(static_cast<LiteralNode*>(body.elseIfCondition), block));
         } else {
-            consume(currentToken().type);
+            body.body = block;
+        }
+        if (lookCurrent(TOK_CASE_STATEMENT) || lookCurrent(TOK_DEFAULT_STATEMENT)) {
+            if (!openCase()) {
+                fail(1);
+            }
+            return;
+        }
+        if (!consume(TOK_CLOSE_BRACE)) {
+            fail();
+            return;
+        }
+        finish(make<SwitchStatementNode>(body.condition, takeList(body.elseIfs), body.body));
+        return;
+    }
+
+    if (!consume(TOK_CLOSE_BRACE)) {
+        fail();
+        return;
+    }
+
+    switch (body.kind) {
+    case BODY_WHILE:
+        finish(make<WhileStatementNode>(body.condition, block));
+        return;
+    case BODY_ELSE:
+        finish(make<IfStatementNode>(body.condition, body.body, takeList(body.elseIfs), block));
+        return;
+    case BODY_IF:
+        body.body = block;
+        body.elseIfs = scratch.size();
+        break;
+    case BODY_ELSE_IF:
+        scratch.push_back(make<ElseIfStatementNode>(body.elseIfCondition, block));
+        break;
+    case BODY_CASE:
+        // closed above, before the '}'
+        return;
+    }
+
+    // look for elseif statemets, can be more than one, and a final else
+    // they reuse the if's entry, so they do not nest any deeper than its body
+    if (lookCurrent(TOK_ELSEIF_STATEMENT)) {
+        advance();
+        if (!consume(TOK_OPEN_PAREN)) {
+            fail();
+            return;
+        }
+        const Parsed<ASTNode*> elseifCondition = parseExpression(); // parse the condition
+        if (!elseifCondition || !consume(TOK_CLOSE_PAREN) || !consume(TOK_OPEN_BRACE)) {
+            fail();
+            return;
+        }
+        body.kind = BODY_ELSE_IF;
+        body.elseIfCondition = *elseifCondition;
+    } else if (lookCurrent(TOK_ELSE_STATEMENT)) {
+        advance();
+        if (!consume(TOK_OPEN_BRACE)) {
+            fail();
+            return;
+        }
+        body.kind = BODY_ELSE;
+    } else {
+        finish(make<IfStatementNode>(body.condition, body.body, takeList(body.elseIfs), nullptr));
+        return;
+    }
+    body.first = current;
+    body.statements = scratch.size();
+    body.starts = spanStarts.size();
+}
+
+BlockStatementNode* Parser::finishBlock(const size_t first, const size_t statements, const size_t starts) {
+    // if empty, add EmptyStatementNode
+    if (scratch.size() == statements) {
+        scratch.push_back(make<EmptyStatementNode>());
+    }
+    auto* block = make<BlockStatementNode>(takeList(statements));
+    if (spans != nullptr) {
+        spans->push_back({block, static_cast<uint32_t>(first), static_cast<uint32_t>(current),
+                          std::vector<uint32_t>(spanStarts.begin() + static_cast<ptrdiff_t>(starts), spanStarts.end())});
+        spanStarts.resize(starts);
+    }
+    return block;
+}
+
+void Parser::parseStatementList(const size_t end) {
+    // bodies opened below base belong to whoever called us
+    const size_t base = bodies.size();
+    while (true) {
+        const bool nested = bodies.size() > base;
+        // the body of a case also ends where the next case of its switch starts
+        const bool caseEnds = nested && bodies.back().kind == BODY_CASE &&
+                              (lookCurrent(TOK_CASE_STATEMENT) || lookCurrent(TOK_DEFAULT_STATEMENT));
+        // nested bodies run to their '}' whatever end says
+        if ((!nested && current >= end) || lookCurrent(TOK_EOF) || lookCurrent(TOK_CLOSE_BRACE) || caseEnds) {
+            if (!nested) {
+                return;
+            }
+            closeBody();
             continue;
         }
 
+        const StatementMark mark = markStatement();
+        const Parsed<ASTNode*> statement = parseNextStatement(mark);
+        if (!statement) {
+            // drop whatever the broken statement left behind and go on with the next one
+            rollback(mark);
+            continue;
+        }
+        if (*statement != nullptr) {
+            addStatement(*statement, mark.start);
+        }
         //consume(TOK_SEMICOLON);
     }
+}
+
+ASTNode* Parser::parseStatement(const bool isBody) {
+    const size_t statements = scratch.size();
+    const size_t starts = spanStarts.size();
+    const size_t first = current;
+
+    if (isBody) {
+        parseStatementList(SIZE_MAX);
+    }
+    deepestStatement = std::max(deepestStatement, uint32_t{1});
+    return finishBlock(first, statements, starts);
+}
 
-    // if empty, add EmptyStatementNode
-    if (statements.empty()) {
-        statements.push_back(std::make_shared<EmptyStatementNode>());
+bool Parser::parseRange(ParseResult& result, const size_t first, const size_t end,
+                        std::vector<ASTNode*>& statements, std::vector<uint32_t>& starts) {
+    if (lexer != nullptr) {
+        throw std::runtime_error("Range parsing needs a parser over a whole token buffer");
+    }
+    // errors only tell the caller to parse more, they do not end up in the result
+    Diagnostics errors;
+    arena = &result.arena;
+    diagnostics = &errors;
+    numbers = &result.numbers;
+    current = first;
+    const size_t mark = scratch.size();
+    const size_t startMark = spanStarts.size();
+    parseStatementList(end);
+    statements.assign(scratch.begin() + static_cast<ptrdiff_t>(mark), scratch.end());
+    starts.assign(spanStarts.begin() + static_cast<ptrdiff_t>(startMark), spanStarts.end());
+    scratch.resize(mark);
+    spanStarts.resize(startMark);
+    result.symbolCount = tokens.symbols.size();
+    arena = nullptr;
+    diagnostics = nullptr;
+    numbers = nullptr;
+    if (stats != nullptr) {
+        reportDepths();
+    }
+    return current == end && errors.empty();
+}
+
+void Parser::reportDepths() const {
+    stats->maxExpressionDepth = std::max(stats->maxExpressionDepth, deepestExpression);
+    stats->maxStatementDepth = std::max(stats->maxStatementDepth, deepestStatement);
+}
+
+std::string nodeTypeToString(const NodeType type) {
+    switch (type) {
+    case NODE_VARIABLE: return "NODE_VARIABLE";
+    case NODE_LITERAL: return "NODE_LITERAL";
+    case NODE_NUMBER: return "NODE_NUMBER";
+    case NODE_STRING: return "NODE_STRING";
+    case NODE_BOOLEAN: return "NODE_BOOLEAN";
+    case EXPRESSION_FUNCTION_CALL: return "EXPRESSION_FUNCTION_CALL";
+    case EXPRESSION_MEMBER_ACCESS: return "EXPRESSION_MEMBER_ACCESS";
+    case EXPRESSION_BINARY_OPERATION: return "EXPRESSION_BINARY_OPERATION";
+    case STATEMENT_EMPTY: return "STATEMENT_EMPTY";
+    case STATEMENT_BLOCK: return "STATEMENT_BLOCK";
+    case STATEMENT_ASSIGNMENT: return "STATEMENT_ASSIGNMENT";
+    case STATEMENT_VARIABLE_DECLARATION: return "STATEMENT_VARIABLE_DECLARATION";
+    case STATEMENT_GLOBAL_DECLARATION: return "STATEMENT_GLOBAL_DECLARATION";
+    case STATEMENT_IF: return "STATEMENT_IF";
+    case STATEMENT_ELSE_IF: return "STATEMENT_ELSE_IF";
+    case STATEMENT_ELSE: return "STATEMENT_ELSE";
+    case STATEMENT_WHILE: return "STATEMENT_WHILE";
+    case STATEMENT_RETURN: return "STATEMENT_RETURN";
+    case STATEMENT_FUNCTION_CALL: return "STATEMENT_FUNCTION_CALL";
+    case STATEMENT_BREAK: return "STATEMENT_BREAK";
+    case STATEMENT_CONTINUE: return "STATEMENT_CONTINUE";
+    case STATEMENT_SWITCH: return "STATEMENT_SWITCH";
+    case STATEMENT_CASE: return "STATEMENT_CASE";
     }
-    return std::make_shared<BlockStatementNode>(statements);
+    return "UNKNOWN";
 }
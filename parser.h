@@ -5,16 +5,21 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <algorithm>
+#include <expected>
 #include <fstream>
 #include <iostream>
-#include <memory>
 #include <utility>
 #include <vector>
 #include <stdexcept>
 #include <string>
+#include "arena.h"
+#include "diagnostics.h"
+#include "lexer.h"
 #include "tokenize.h"
 
 class Token;
+class Stats;
 
 enum LiteralType {
     LITERAL_NUMBER,
@@ -23,16 +28,32 @@ enum LiteralType {
     LITERAL_FALSE
 };
 
-enum VariableType {
+// declared type of a var<number>, var<string> or var<bool>, plain var is generic
+enum VariableType : uint8_t {
     VARIABLE_NUMBER,
     VARIABLE_STRING,
     VARIABLE_BOOLEAN,
     VARIABLE_GENERIC
 };
 
+// what checkTypes() knows about the values an expression or variable can have
+// TYPE_NONE is no value at all (not assigned yet while inferring), TYPE_NUMBER is an integer or a float
+enum StaticType : uint8_t {
+    TYPE_NONE,
+    TYPE_INTEGER,
+    TYPE_FLOAT,
+    TYPE_NUMBER,
+    TYPE_BOOLEAN,
+    TYPE_STRING,
+    TYPE_ANY
+};
+
 enum NodeType {
     NODE_VARIABLE,
     NODE_LITERAL,
+    NODE_NUMBER,
+    NODE_STRING,
+    NODE_BOOLEAN,
     EXPRESSION_FUNCTION_CALL,
     EXPRESSION_MEMBER_ACCESS,
     EXPRESSION_BINARY_OPERATION,
@@ -48,169 +69,290 @@ enum NodeType {
     STATEMENT_RETURN,
     STATEMENT_FUNCTION_CALL,
     STATEMENT_BREAK,
-    STATEMENT_CONTINUE
+    STATEMENT_CONTINUE,
+    STATEMENT_SWITCH,
+    STATEMENT_CASE
 };
 
+constexpr size_t nodeTypeCount = STATEMENT_CASE + 1;
+
+std::string nodeTypeToString(NodeType type);
+
+// nodes live in the ParseResult arena, children are plain pointers into the same arena
+// and strings are copies in it, so nodes never own anything and are never destroyed one by one
+// kind tells the concrete class, passes switch on it instead of using dynamic_cast
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
+    const NodeType kind;
+    explicit ASTNode(const NodeType kind) : kind(kind) {}
+
+    // the node as T when it is one, nullptr otherwise
+    template <class T>
+    T* as() { return kind == T::Kind ? static_cast<T*>(this) : nullptr; }
+    template <class T>
+    const T* as() const { return kind == T::Kind ? static_cast<const T*>(this) : nullptr; }
+};
+
+using NodeList = ArenaList<ASTNode*>;
+
+enum VariableScope : uint8_t {
+    SCOPE_UNRESOLVED,
+    SCOPE_LOCAL,
+    SCOPE_GLOBAL
 };
 
 class VariableNode final : public ASTNode {
 public:
-    std::string name;
-    explicit VariableNode(std::string name) : name(std::move(name)) { }
+    static constexpr NodeType Kind = NODE_VARIABLE;
+    std::string_view name;
+    uint32_t symbol;                            // interned name, see TokenBuffer::symbols
+    VariableScope scope = SCOPE_UNRESOLVED;     // slot and scope are filled in by resolve()
+    uint32_t slot = 0;
+    StaticType type = TYPE_ANY;                 // type and declared are filled in by checkTypes()
+    VariableType declared = VARIABLE_GENERIC;
+    VariableNode(const std::string_view name, const uint32_t symbol) : ASTNode(Kind), name(name), symbol(symbol) { }
 };
 
 class NumberNode final : public ASTNode {
 public:
-    int value;
-    explicit NumberNode(const int value) : value(value) {}
+    static constexpr NodeType Kind = NODE_NUMBER;
+    uint32_t constant;                          // index into ParseResult::numbers
+    explicit NumberNode(const uint32_t constant) : ASTNode(Kind), constant(constant) {}
 };
 
 class StringNode final : public ASTNode {
 public:
-    std::string value;
-    explicit StringNode(std::string value) : value(std::move(value)) {}
+    static constexpr NodeType Kind = NODE_STRING;
+    std::string_view value;
+    explicit StringNode(const std::string_view value) : ASTNode(Kind), value(value) {}
 };
 
 class BooleanNode final : public ASTNode {
 public:
+    static constexpr NodeType Kind = NODE_BOOLEAN;
     bool value;
-    explicit BooleanNode(const bool value) : value(value) {}
+    explicit BooleanNode(const bool value) : ASTNode(Kind), value(value) {}
 };
 
 class LiteralNode final : public ASTNode {
 public:
+    static constexpr NodeType Kind = NODE_LITERAL;
     LiteralType type;
-    std::shared_ptr<ASTNode> value;
-    explicit LiteralNode(const LiteralType type, std::shared_ptr<ASTNode> value) : type(type), value(std::move(value)) {}
+    ASTNode* value;
+    explicit LiteralNode(const LiteralType type, ASTNode* value) : ASTNode(Kind), type(type), value(value) {}
 };
 
 // Expressions
 class FunctionCallNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> object;
-    std::vector<std::shared_ptr<ASTNode>> arguments;
-    FunctionCallNode(std::shared_ptr<ASTNode> object, std::vector<std::shared_ptr<ASTNode>> arguments)
-        : object(std::move(object)), arguments(std::move(arguments)) {}
+    static constexpr NodeType Kind = EXPRESSION_FUNCTION_CALL;
+    ASTNode* object;
+    NodeList arguments;
+    FunctionCallNode(ASTNode* object, NodeList arguments)
+        : ASTNode(Kind), object(object), arguments(arguments) {}
 };
 
 class MemberAccessNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> object;
-    std::string member;
-    MemberAccessNode(std::shared_ptr<ASTNode> object, std::string member)
-        : object(std::move(object)), member(std::move(member)) {}
+    static constexpr NodeType Kind = EXPRESSION_MEMBER_ACCESS;
+    ASTNode* object;
+    std::string_view member;
+    uint32_t memberSymbol;
+    MemberAccessNode(ASTNode* object, const std::string_view member, const uint32_t memberSymbol)
+        : ASTNode(Kind), object(object), member(member), memberSymbol(memberSymbol) {}
 };
 
 class BinaryOperationNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> left;
-    std::shared_ptr<ASTNode> right;
+    static constexpr NodeType Kind = EXPRESSION_BINARY_OPERATION;
+    ASTNode* left;
+    ASTNode* right;
     TokenType operation; // This could represent the operator
+    StaticType type = TYPE_ANY;     // of the result, filled in by checkTypes()
 
-    BinaryOperationNode(std::shared_ptr<ASTNode> left, const TokenType operation, std::shared_ptr<ASTNode> right)
-        : left(std::move(left)), right(std::move(right)), operation(operation) {}
+    BinaryOperationNode(ASTNode* left, const TokenType operation, ASTNode* right)
+        : ASTNode(Kind), left(left), right(right), operation(operation) {}
 };
 
 // Statements
 class EmptyStatementNode final : public ASTNode {
 public:
-    EmptyStatementNode() = default;
+    static constexpr NodeType Kind = STATEMENT_EMPTY;
+    EmptyStatementNode() : ASTNode(Kind) {}
 };
 
 class BlockStatementNode final : public ASTNode {
 public:
-    std::vector<std::shared_ptr<ASTNode>> statements;
-    explicit BlockStatementNode(std::vector<std::shared_ptr<ASTNode>> statements) : statements(std::move(statements)) {}
+    static constexpr NodeType Kind = STATEMENT_BLOCK;
+    NodeList statements;
+    explicit BlockStatementNode(NodeList statements) : ASTNode(Kind), statements(statements) {}
 };
 
 class AssignmentStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> variable;
-    std::shared_ptr<ASTNode> value;
-    AssignmentStatementNode(std::shared_ptr<ASTNode> var, std::shared_ptr<ASTNode> val)
-        : variable(std::move(var)), value(std::move(val)) {}
+    static constexpr NodeType Kind = STATEMENT_ASSIGNMENT;
+    ASTNode* variable;
+    ASTNode* value;
+    AssignmentStatementNode(ASTNode* var, ASTNode* val)
+        : ASTNode(Kind), variable(var), value(val) {}
 };
 
 class VariableDeclarationStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<VariableNode> variable;
-    std::shared_ptr<ASTNode> value;
-    VariableDeclarationStatementNode(std::shared_ptr<VariableNode> var, std::shared_ptr<ASTNode> val)
-        : variable(std::move(var)), value(std::move(val)) {}
+    static constexpr NodeType Kind = STATEMENT_VARIABLE_DECLARATION;
+    VariableNode* variable;
+    ASTNode* value;
+    VariableType declared;
+    VariableDeclarationStatementNode(VariableNode* var, ASTNode* val, const VariableType declared = VARIABLE_GENERIC)
+        : ASTNode(Kind), variable(var), value(val), declared(declared) {}
 };
 
 class GlobalDeclarationStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<VariableNode> variable;
-    std::shared_ptr<ASTNode> value;
-    GlobalDeclarationStatementNode(std::shared_ptr<VariableNode> var, std::shared_ptr<ASTNode> val)
-        : variable(std::move(var)), value(std::move(val)) {}
+    static constexpr NodeType Kind = STATEMENT_GLOBAL_DECLARATION;
+    VariableNode* variable;
+    ASTNode* value;
+    VariableType declared;
+    GlobalDeclarationStatementNode(VariableNode* var, ASTNode* val, const VariableType declared = VARIABLE_GENERIC)
+        : ASTNode(Kind), variable(var), value(val), declared(declared) {}
 };
 
 class IfStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> condition;
-    std::shared_ptr<ASTNode> body;
-    std::vector<std::shared_ptr<ASTNode>> elseifBodies;
-    std::shared_ptr<ASTNode> elseBody;
-    IfStatementNode(std::shared_ptr<ASTNode> cond, std::shared_ptr<ASTNode> body,
-                    std::vector<std::shared_ptr<ASTNode>> elseifBodies, std::shared_ptr<ASTNode> elseBody)
-        : condition(std::move(cond)), body(std::move(body)), elseifBodies(std::move(elseifBodies)), elseBody(std::move(elseBody)) {}
+    static constexpr NodeType Kind = STATEMENT_IF;
+    ASTNode* condition;
+    ASTNode* body;
+    NodeList elseifBodies;
+    ASTNode* elseBody;
+    IfStatementNode(ASTNode* cond, ASTNode* body,
+                    NodeList elseifBodies, ASTNode* elseBody)
+        : ASTNode(Kind), condition(cond), body(body), elseifBodies(elseifBodies), elseBody(elseBody) {}
 };
 
 class ElseIfStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> condition;
-    std::shared_ptr<ASTNode> body;
-    ElseIfStatementNode(std::shared_ptr<ASTNode> cond, std::shared_ptr<ASTNode> body)
-        : condition(std::move(cond)), body(std::move(body)) {}
+    static constexpr NodeType Kind = STATEMENT_ELSE_IF;
+    ASTNode* condition;
+    ASTNode* body;
+    ElseIfStatementNode(ASTNode* cond, ASTNode* body)
+        : ASTNode(Kind), condition(cond), body(body) {}
 };
 
 class ElseStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> body;
-    explicit ElseStatementNode(std::shared_ptr<ASTNode> body) : body(std::move(body)) {}
+    static constexpr NodeType Kind = STATEMENT_ELSE;
+    ASTNode* body;
+    explicit ElseStatementNode(ASTNode* body) : ASTNode(Kind), body(body) {}
 };
 
 class WhileStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> condition;
-    std::shared_ptr<ASTNode> body;
-    WhileStatementNode(std::shared_ptr<ASTNode> cond, std::shared_ptr<ASTNode> body)
-        : condition(std::move(cond)), body(std::move(body)) {}
+    static constexpr NodeType Kind = STATEMENT_WHILE;
+    ASTNode* condition;
+    ASTNode* body;
+    WhileStatementNode(ASTNode* cond, ASTNode* body)
+        : ASTNode(Kind), condition(cond), body(body) {}
+};
+
+// cases do not fall through, each body ends at the next case and break leaves the switch
+class SwitchStatementNode final : public ASTNode {
+public:
+    static constexpr NodeType Kind = STATEMENT_SWITCH;
+    ASTNode* value;
+    NodeList cases;
+    ASTNode* defaultBody;
+    SwitchStatementNode(ASTNode* value, NodeList cases, ASTNode* defaultBody)
+        : ASTNode(Kind), value(value), cases(cases), defaultBody(defaultBody) {}
+};
+
+// label is an integer or string LiteralNode, every case of a switch has the same kind of label
+class SwitchCaseNode final : public ASTNode {
+public:
+    static constexpr NodeType Kind = STATEMENT_CASE;
+    LiteralNode* label;
+    ASTNode* body;
+    SwitchCaseNode(LiteralNode* label, ASTNode* body) : ASTNode(Kind), label(label), body(body) {}
 };
 
 class ReturnStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> expressions;
-    explicit ReturnStatementNode(std::shared_ptr<ASTNode> expressions) : expressions(std::move(expressions)) {}
+    static constexpr NodeType Kind = STATEMENT_RETURN;
+    ASTNode* expressions;
+    explicit ReturnStatementNode(ASTNode* expressions) : ASTNode(Kind), expressions(expressions) {}
 };
 
 class FunctionCallStatementNode final : public ASTNode {
 public:
-    std::shared_ptr<ASTNode> object;
-    std::vector<std::shared_ptr<ASTNode>> arguments;
-    FunctionCallStatementNode(std::shared_ptr<ASTNode> object, std::vector<std::shared_ptr<ASTNode>> arguments)
-        : object(std::move(object)), arguments(std::move(arguments)) {}
+    static constexpr NodeType Kind = STATEMENT_FUNCTION_CALL;
+    ASTNode* object;
+    NodeList arguments;
+    FunctionCallStatementNode(ASTNode* object, NodeList arguments)
+        : ASTNode(Kind), object(object), arguments(arguments) {}
 };
 
 class BreakStatementNode final : public ASTNode {
 public:
-    BreakStatementNode() = default;
+    static constexpr NodeType Kind = STATEMENT_BREAK;
+    BreakStatementNode() : ASTNode(Kind) {}
 };
 
 class ContinueStatementNode final : public ASTNode {
 public:
-    ContinueStatementNode() = default;
+    static constexpr NodeType Kind = STATEMENT_CONTINUE;
+    ContinueStatementNode() : ASTNode(Kind) {}
+};
+
+// owns every node of a parsed program, dropping it frees the whole tree in one go
+class ParseResult {
+public:
+    Arena arena;
+    NodeList statements;
+    uint32_t symbolCount = 0;   // every symbol id in the tree is below this
+    // values of the number literals, each distinct value once
+    NumberPool numbers;
+    // syntax errors, the tree leaves out every statement that had one
+    Diagnostics diagnostics;
+
+    // set by resolve()
+    bool resolved = false;
+    uint32_t localCount = 0;
+    uint32_t globalCount = 0;
+    // set by checkTypes()
+    bool typed = false;
+
+    ParseResult() = default;
+    explicit ParseResult(const size_t arenaBlockSize) : arena(arenaBlockSize) {}
+
+    [[nodiscard]] bool hasErrors() const { return !diagnostics.empty(); }
+};
+
+// a parse step that failed, its diagnostic has already been reported
+struct ParseError {};
+
+template <class T>
+using Parsed = std::expected<T, ParseError>;
+
+// where the statements of one block sit in the token stream, recorded on request for incremental re-parsing
+// a statement runs from its start up to the next statement's start (or end), tokens the parser
+// skipped in front of the first statement count towards it
+struct BlockSpan {
+    BlockStatementNode* block;
+    uint32_t first;                 // token index where the block's statement list begins
+    uint32_t end;                   // token index where it stops, the closing '}' or EOF
+    std::vector<uint32_t> starts;   // token index of each statement, empty when the block only holds an EmptyStatementNode
 };
 
 class Parser {
 private:
-    std::vector<Token> tokens;
+    // borrowed, the token buffer (and the source it points into) must outlive the parser
+    // when streaming it is the lexer's window and current is relative to the start of the window
+    const TokenBuffer& tokens;
+    Lexer* lexer = nullptr;
     size_t current;
+    size_t discarded = 0;   // tokens dropped from the front of the lexer window so far
+
+    // tokens kept buffered in front of current, enough for lookAhead()
+    static constexpr size_t lookaheadTokens = 4;
 
     static int getOperatorPrecedence(const TokenType type) {
         switch (type) {
@@ -248,96 +390,322 @@ private:
         }
     }
 
-    Token getTokenAt(const int offset) {
+    [[nodiscard]] Token getTokenAt(const size_t offset) const {
         if (offset >= tokens.size()) {
-            return Token("", TOK_EOF, -1);
+            return {"", TOK_EOF, static_cast<uint32_t>(tokens.sourceBase + tokens.source.size())};
         }
-        return tokens[offset];
+        return tokens.at(offset);
     }
 
-    Token previousToken() {
-        if (current == 0) {
-            throw std::runtime_error("Unexpected start of tokens");
-        }
-        return tokens[current - 1];
+    // an EOF token once the tokens run out
+    [[nodiscard]] Token currentToken() const {
+        return getTokenAt(current);
     }
 
-    Token currentToken() {
-        if (current >= tokens.size()) {
-            throw std::runtime_error("Unexpected end of tokens");
-        }
-        return tokens[current];
+    // symbol id the lexer gave the identifier at index
+    [[nodiscard]] uint32_t symbolAt(const size_t index) const {
+        return tokens.payload(index).value_or(UINT32_MAX);
+    }
+
+    VariableNode* makeVariable() {
+        return make<VariableNode>(arena->copyString(currentToken().value), symbolAt(current));
     }
 
-    Token nextToken() {
-        if (current + 1 >= tokens.size()) {
-            return Token("", TOK_EOF, -1);
+    // the 1 that x++ and x-- add or subtract
+    LiteralNode* makeOne() {
+        return make<LiteralNode>(LITERAL_NUMBER, make<NumberNode>(numbers->add(Number::fromInteger(1))));
+    }
+
+    [[nodiscard]] Token nextToken() const {
+        return getTokenAt(current + 1);
+    }
+
+    // moves past the current token, which the caller already looked at
+    void advance() {
+        current++;
+        if (lexer != nullptr && tokens.size() - current < lookaheadTokens) {
+            refill();
         }
-        return tokens[current + 1];
     }
 
-    void consume(const TokenType expectedType) {
-        if (currentToken().type != expectedType) {
-            throw std::runtime_error("Unexpected token: " + tokenTypeToString(currentToken().type) +
-                ", expected: " + tokenTypeToString(expectedType) + " Position: " + std::to_string(currentToken().position) + " | String: " + currentToken().value);
+    [[nodiscard]] bool consume(const TokenType expectedType) {
+        if (!expect(expectedType)) {
+            return false;
         }
-        current++;
+        advance();
+        return true;
+    }
+
+    // drops the consumed tokens from the lexer window (keeping the previous token) and lexes more
+    void refill() {
+        const size_t consumed = current > 0 ? current - 1 : 0;
+        lexer->discard(consumed);
+        discarded += consumed;
+        current -= consumed;
+        lexer->fill(current + lookaheadTokens);
     }
 
-    void expect(const TokenType expectedType) {
-        if (currentToken().type != expectedType) {
-            throw std::runtime_error("Unexpected token: " + tokenTypeToString(currentToken().type) +
-                ", expected: " + tokenTypeToString(expectedType) + " Position: " + std::to_string(currentToken().position) + " | String: " + currentToken().value);
+    // reports an unexpected token when the current one is not of the expected type
+    [[nodiscard]] bool expect(const TokenType expectedType) {
+        if (lookCurrent(expectedType)) {
+            return true;
         }
+        report(DIAG_UNEXPECTED_TOKEN, expectedType);
+        return false;
+    }
+
+    // records a diagnostic at the current token, a second one at the same token is dropped since it
+    // only follows from the first (every enclosing block missing its '}' at EOF, say)
+    void report(DiagnosticCode code, TokenType expected = TOK_EOF);
+
+    static std::unexpected<ParseError> failed() {
+        return std::unexpected(ParseError{});
+    }
+
+    // lookahead only touches the dense kind array
+    [[nodiscard]] TokenType typeAt(const size_t index) const
+    {
+        return index < tokens.size() ? tokens.type(index) : TOK_EOF;
     }
 
     [[nodiscard]] bool lookCurrent(const TokenType expectedType) const
     {
-        return tokens[current].type == expectedType;
+        return typeAt(current) == expectedType;
     }
 
     [[nodiscard]] bool lookAhead(const TokenType expectedType, const int offset = 1) const
     {
-        return tokens[current + offset].type == expectedType;
+        return typeAt(current + offset) == expectedType;
+    }
+
+
+    // arena, diagnostics and number pool of the ParseResult being built
+    Arena* arena = nullptr;
+    Diagnostics* diagnostics = nullptr;
+    NumberPool* numbers = nullptr;
+    // child lists are collected here and copied into the arena once complete,
+    // nested lists stack on top of each other so no per list vector is allocated
+    std::vector<ASTNode*> scratch;
+
+    // when set every block is recorded here as it is finished, so children come before their parents
+    std::vector<BlockSpan>* spans = nullptr;
+    // statement starts of the blocks being built, stacked like scratch
+    std::vector<uint32_t> spanStarts;
+
+    // where a statement began, everything it added is dropped again when it fails
+    struct StatementMark {
+        size_t start;       // token index of its first token
+        size_t statements;  // scratch size
+        size_t starts;      // spanStarts size
+        size_t blocks;      // spans size
+    };
+
+    enum BodyKind : uint8_t {
+        BODY_IF,
+        BODY_ELSE_IF,
+        BODY_ELSE,
+        BODY_WHILE,
+        BODY_CASE
+    };
+
+    // a compound statement whose body is being parsed, bodies stack here instead of on the call stack
+    struct OpenBody {
+        BodyKind kind;
+        StatementMark mark;         // of the whole if, while or switch
+        size_t first;               // token index where the body's statements begin
+        size_t statements;          // scratch index of the body's first statement
+        size_t starts;              // spanStarts index of the body's first statement
+        ASTNode* condition;         // of the if or while, the switch's value
+        ASTNode* elseIfCondition;   // of the else if, the label of the case (nullptr for default)
+        ASTNode* body = nullptr;    // the if's body once it is closed, the switch's default body
+        size_t elseIfs = 0;         // scratch index of the if's first else if or the switch's first case
+    };
+
+    enum ExpressionFrameKind : uint8_t {
+        FRAME_OPERATOR,     // node is the left operand of operation
+        FRAME_PAREN,        // a '(' waiting for its ')'
+        FRAME_CALL          // node is the member being called, its arguments start at scratch[arguments]
+    };
+
+    // the part of an expression still waiting for operands, see parseExpression()
+    struct ExpressionFrame {
+        ExpressionFrameKind kind;
+        TokenType operation;
+        int precedence;
+        ASTNode* node;
+        size_t arguments;
+    };
+
+    std::vector<OpenBody> bodies;
+    std::vector<ExpressionFrame> expressionStack;
+    size_t openBrackets = 0;    // FRAME_PAREN and FRAME_CALL entries of expressionStack
+    size_t nestingLimit = defaultNestingLimit;
+
+    Stats* stats = nullptr;
+    uint32_t deepestExpression = 0;
+    uint32_t deepestStatement = 0;
+
+    // hands the deepest nesting seen to stats
+    void reportDepths() const;
+
+    // reports instead of returning true when one more body or bracket would go past the nesting limit
+    [[nodiscard]] bool canNest();
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+
+    // moves scratch[start, end) into the arena
+    NodeList takeList(const size_t start) {
+        const NodeList list = NodeList::copy(*arena, scratch.data() + start, scratch.data() + scratch.size());
+        scratch.resize(start);
+        return list;
     }
 
+    // a number, string, boolean or variable with its member accesses and calls
+    // nullptr when a call was opened and its first argument comes next
+    Parsed<ASTNode*> parseOperand();
+
+    // the '.member' and '.member(...)' following expression, nullptr when a call was opened
+    Parsed<ASTNode*> parseMembers(ASTNode* expression);
+
+    // pushes a '(' or a call onto the expression stack and moves past the '('
+    [[nodiscard]] bool openBracket(ExpressionFrameKind kind, ASTNode* callee);
+
+    // the call on top of the expression stack with the arguments collected for it
+    ASTNode* closeCall();
+
+    // precedence climbing on expressionStack instead of the call stack, so nesting costs heap and not stack
+    // with primaryOnly it stops after the first operand, like a statement that starts with a variable
+    Parsed<ASTNode*> parseExpression(bool primaryOnly = false);
+
+    // the optional <number>, <string> or <bool> behind var, VARIABLE_GENERIC without one
+    Parsed<VariableType> parseDeclaredType();
 
-    std::shared_ptr<ASTNode> parsePrimary(); // parse primary expressions
+    Parsed<ASTNode*> parseVariableDeclarationStatement();
 
-    std::shared_ptr<ASTNode> parseExpression(int precedence = 0);
+    Parsed<ASTNode*> parseGlobalDeclarationStatement();
 
-    std::shared_ptr<ASTNode> parseVariableDeclarationStatement();
+    Parsed<ASTNode*> parseAssignmentStatement(ASTNode* primary);
 
-    std::shared_ptr<ASTNode> parseGlobalDeclarationStatement();
+    // x += e and x++ after the target was parsed, current is the operator
+    Parsed<ASTNode*> parseCompoundAssignment(ASTNode* target, TokenType operation);
 
-    std::shared_ptr<ASTNode> parseAssignmentStatement(std::shared_ptr<ASTNode> primary);
+    // x = x <operation> value, which is what x += value, x++ and ++x are lowered to
+    ASTNode* lowerCompoundAssignment(ASTNode* target, TokenType operation, ASTNode* value);
 
-    std::shared_ptr<ASTNode> parseIfStatement();
+    // parses up to the '{' of the body and opens it, the rest is done by closeBody()
+    Parsed<ASTNode*> parseIfStatement(const StatementMark& mark);
 
-    std::shared_ptr<ASTNode> parseForStatement();
+    Parsed<ASTNode*> parseForStatement();
 
-    std::shared_ptr<ASTNode> parseWhileStatement();
+    Parsed<ASTNode*> parseWhileStatement(const StatementMark& mark);
 
-    std::shared_ptr<ASTNode> parseSwitchStatement();
+    // parses up to the first case like parseIfStatement(), every case is a body of its own
+    Parsed<ASTNode*> parseSwitchStatement(const StatementMark& mark);
 
-    std::shared_ptr<ASTNode> parseBreakStatement();
+    // the 'case label:' or 'default:' starting the next body of the switch on top of bodies
+    [[nodiscard]] bool openCase();
 
-    std::shared_ptr<ASTNode> parseContinueStatement();
+    Parsed<ASTNode*> parseBreakStatement();
 
-    std::shared_ptr<ASTNode> parseReturnStatement();
+    Parsed<ASTNode*> parseContinueStatement();
 
-    std::shared_ptr<ASTNode> parseStatement(bool isBody);
+    Parsed<ASTNode*> parseReturnStatement();
+
+    // one statement of a list, nullptr when only a stray token was skipped or a body was opened
+    Parsed<ASTNode*> parseNextStatement(const StatementMark& mark);
+
+    [[nodiscard]] StatementMark markStatement() const;
+
+    // adds a finished statement to the list being built
+    void addStatement(ASTNode* statement, size_t start);
+
+    // skips the rest of a statement that failed to parse, see parseStatementList
+    // depth is how many of the statement's braces are already open
+    void synchronize(size_t start, uint32_t depth = 0);
+
+    // drops what the failed statement at mark added and skips its remaining tokens
+    void rollback(const StatementMark& mark, uint32_t depth = 0);
+
+    // pushes a body of kind onto bodies, the '{' has been consumed
+    void openBody(BodyKind kind, const StatementMark& mark, ASTNode* condition);
+
+    // ends the innermost body at its '}' and goes on with the statement it belongs to
+    void closeBody();
+
+    // the statements from scratch[statements] on as a block, an EmptyStatementNode when there are none
+    BlockStatementNode* finishBlock(size_t first, size_t statements, size_t starts);
+
+    // parses statements onto scratch until '}', EOF or the token index end
+    // a statement with an error is left out and parsing picks up again behind it
+    // nested bodies are parsed in the same loop, see OpenBody
+    void parseStatementList(size_t end);
+
+    // the statements up to the closing '}' as a block, errors inside are recovered from so it never fails
+    ASTNode* parseStatement(bool isBody);
 
 public:
+    // open bodies plus open brackets, deep enough for any hand written program but far from the
+    // depths where later passes, which do recurse, run out of stack
+    static constexpr size_t defaultNestingLimit = 1000;
+
+    explicit Parser(const TokenBuffer& tokens) : tokens(tokens), current(0) {}
+    Parser(TokenBuffer&&) = delete;
+
+    // streams tokens from the lexer, only a small window of them is alive at any time
+    explicit Parser(Lexer& lexer) : tokens(lexer.tokens()), lexer(&lexer), current(0) {
+        lexer.fill(lookaheadTokens);
+    }
 
-    explicit Parser(const std::vector<Token>& tokens) : tokens(tokens), current(0) {}
+    // records a BlockSpan for every block parsed from now on, token indices are only absolute
+    // when the parser reads a whole TokenBuffer, so it cannot be combined with a Lexer
+    void recordSpans(std::vector<BlockSpan>* spans) {
+        if (spans != nullptr && lexer != nullptr) {
+            throw std::runtime_error("Block spans need a parser over a whole token buffer");
+        }
+        this->spans = spans;
+    }
 
-    std::vector<std::shared_ptr<ASTNode>> parse() {
-        std::vector<std::shared_ptr<ASTNode>> statements;
-        while (current < tokens.size()-1) { // last is EOF
-            statements.push_back(parseStatement(true));
+    // collects nesting depths into stats from now on, null turns it off again
+    void collectStats(Stats* stats) { this->stats = stats; }
+
+    // nesting beyond limit is reported as DIAG_NESTING_TOO_DEEP, at least 1
+    void limitNesting(const size_t limit) { nestingLimit = std::max<size_t>(limit, 1); }
+
+    // parses the statements in tokens [first, end) into result's arena, for incremental re-parsing
+    // statements gets the parsed statements and starts their first token indices
+    // returns false when the last statement does not end exactly at end or the range has errors
+    bool parseRange(ParseResult& result, size_t first, size_t end,
+                    std::vector<ASTNode*>& statements, std::vector<uint32_t>& starts);
+
+    // never throws on a syntax error, every error of the input ends up in ParseResult::diagnostics
+    ParseResult parse() {
+        // size the first arena block from the token count when it is known up front,
+        // so a whole program usually fits in a single allocation
+        ParseResult result(lexer == nullptr ? tokens.size() * 48 + 1024 : Arena::defaultBlockSize);
+        arena = &result.arena;
+        diagnostics = &result.diagnostics;
+        numbers = &result.numbers;
+        while (!lookCurrent(TOK_EOF)) {
+            scratch.push_back(parseStatement(true));
+            // a '}' with no block to close ends the statement list without being consumed,
+            // report and skip it so the statements behind it are still checked
+            if (lookCurrent(TOK_CLOSE_BRACE)) {
+                report(DIAG_UNMATCHED_BRACE);
+                advance();
+            }
+        }
+        result.statements = takeList(0);
+        result.symbolCount = tokens.symbols.size();
+        arena = nullptr;
+        diagnostics = nullptr;
+        numbers = nullptr;
+        if (stats != nullptr) {
+            reportDepths();
         }
-        return statements;
+        return result;
     }
 };
 
@@ -0,0 +1,217 @@
+#include "resolver.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t none = UINT32_MAX;
+
+class Resolver {
+private:
+    struct Binding {
+        uint32_t slot = none;
+        uint32_t depth = 0;     // scope depth of the declaration, 0 when the name is not a local
+    };
+
+    // what a declaration replaced, restored when its scope ends
+    struct Shadowed {
+        uint32_t symbol;
+        Binding previous;
+    };
+
+    ParseResult& result;
+    // indexed by symbol id
+    std::vector<Binding> locals;
+    std::vector<uint32_t> globals;
+    std::vector<Shadowed> shadowed;
+    uint32_t depth = 0;
+
+    void declareLocal(VariableNode* variable) {
+        Binding& binding = locals[variable->symbol];
+        if (binding.slot != none && binding.depth == depth) {
+            throw std::runtime_error("Variable already declared: " + std::string(variable->name));
+        }
+        shadowed.push_back({variable->symbol, binding});
+        binding = {result.localCount++, depth};
+        variable->scope = SCOPE_LOCAL;
+        variable->slot = binding.slot;
+    }
+
+    void declareGlobal(VariableNode* variable) {
+        uint32_t& slot = globals[variable->symbol];
+        if (slot != none) {
+            throw std::runtime_error("Global already declared: " + std::string(variable->name));
+        }
+        slot = result.globalCount++;
+        variable->scope = SCOPE_GLOBAL;
+        variable->slot = slot;
+    }
+
+    void bind(VariableNode* variable) {
+        if (const Binding& binding = locals[variable->symbol]; binding.slot != none) {
+            variable->scope = SCOPE_LOCAL;
+            variable->slot = binding.slot;
+        } else if (const uint32_t slot = globals[variable->symbol]; slot != none) {
+            variable->scope = SCOPE_GLOBAL;
+            variable->slot = slot;
+        } else {
+            throw std::runtime_error("Undefined variable: " + std::string(variable->name));
+        }
+    }
+
+    void expression(ASTNode* node) {
+        switch (node->kind) {
+        case NODE_VARIABLE:
+            bind(static_cast<VariableNode*>(node));
+            break;
+        case EXPRESSION_BINARY_OPERATION: {
+            auto* binary = static_cast<BinaryOperationNode*>(node);
+            expression(binary->left);
+            expression(binary->right);
+            break;
+        }
+        case EXPRESSION_MEMBER_ACCESS:
+            expression(static_cast<MemberAccessNode*>(node)->object);
+            break;
+        case EXPRESSION_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallNode*>(node);
+            expression(call->object);
+            for (ASTNode* argument : call->arguments) {
+                expression(argument);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // every block is a scope, a body that is a single statement gets one too
+    void block(ASTNode* node) {
+        const size_t mark = shadowed.size();
+        ++depth;
+        if (auto* body = node->as<BlockStatementNode>()) {
+            for (ASTNode* statement : body->statements) {
+                this->statement(statement);
+            }
+        } else {
+            statement(node);
+        }
+        --depth;
+        while (shadowed.size() > mark) {
+            locals[shadowed.back().symbol] = shadowed.back().previous;
+            shadowed.pop_back();
+        }
+    }
+
+    void statement(ASTNode* node) {
+        switch (node->kind) {
+        case STATEMENT_BLOCK:
+            block(node);
+            break;
+
+        case STATEMENT_VARIABLE_DECLARATION: {
+            auto* declaration = static_cast<VariableDeclarationStatementNode*>(node);
+            // the initializer still sees an outer variable of the same name
+            expression(declaration->value);
+            declareLocal(declaration->variable);
+            break;
+        }
+
+        case STATEMENT_GLOBAL_DECLARATION: {
+            auto* declaration = static_cast<GlobalDeclarationStatementNode*>(node);
+            expression(declaration->value);
+            declareGlobal(declaration->variable);
+            break;
+        }
+
+        case STATEMENT_ASSIGNMENT: {
+            auto* assignment = static_cast<AssignmentStatementNode*>(node);
+            expression(assignment->value);
+            expression(assignment->variable);
+            break;
+        }
+
+        case STATEMENT_IF: {
+            auto* statement = static_cast<IfStatementNode*>(node);
+            expression(statement->condition);
+            block(statement->body);
+            for (ASTNode* item : statement->elseifBodies) {
+                auto* elseif = static_cast<ElseIfStatementNode*>(item);
+                expression(elseif->condition);
+                block(elseif->body);
+            }
+            if (statement->elseBody != nullptr) {
+                block(statement->elseBody);
+            }
+            break;
+        }
+
+        case STATEMENT_WHILE: {
+            auto* statement = static_cast<WhileStatementNode*>(node);
+            expression(statement->condition);
+            block(statement->body);
+            break;
+        }
+
+        case STATEMENT_SWITCH: {
+            auto* statement = static_cast<SwitchStatementNode*>(node);
+            expression(statement->value);
+            for (ASTNode* item : statement->cases) {
+                block(static_cast<SwitchCaseNode*>(item)->body);
+            }
+            if (statement->defaultBody != nullptr) {
+                block(statement->defaultBody);
+            }
+            break;
+        }
+
+        case STATEMENT_RETURN:
+            if (ASTNode* value = static_cast<ReturnStatementNode*>(node)->expressions) {
+                expression(value);
+            }
+            break;
+
+        case STATEMENT_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallStatementNode*>(node);
+            expression(call->object);
+            for (ASTNode* argument : call->arguments) {
+                expression(argument);
+            }
+            break;
+        }
+
+        case STATEMENT_EMPTY:
+        case STATEMENT_BREAK:
+        case STATEMENT_CONTINUE:
+            break;
+
+        default:
+            expression(node);
+            break;
+        }
+    }
+
+public:
+    explicit Resolver(ParseResult& result)
+        : result(result), locals(result.symbolCount), globals(result.symbolCount, none) {}
+
+    void run() {
+        for (ASTNode* statement : result.statements) {
+            block(statement);
+        }
+    }
+};
+
+}
+
+void resolve(ParseResult& result) {
+    result.localCount = 0;
+    result.globalCount = 0;
+    result.typed = false;
+    Resolver resolver(result);
+    resolver.run();
+    result.resolved = true;
+}
@@ -0,0 +1,11 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "parser.h"
+
+// binds every VariableNode to a local or global slot, so the compiler and vm never look names up
+// locals get a fresh slot per declaration, block scopes shadow outer ones and end with their block
+// throws on undefined variables and on declaring a name twice in the same scope
+void resolve(ParseResult& result);
+
+#endif //RESOLVER_H
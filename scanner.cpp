@@ -0,0 +1,260 @@
+#include "scanner.h"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define CUEL_SCANNER_SSE2 1
+#endif
+
+#if defined(CUEL_SCANNER_SSE2) && defined(__GNUC__)
+#define CUEL_SCANNER_AVX2 1
+#define CUEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+// the same byte classes as the lexer table, written out so they can be vectorized
+struct WhitespaceClass {
+    static bool contains(const unsigned char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
+};
+
+struct WordClass {
+    static bool contains(const unsigned char ch) {
+        return ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z') || (ch >= '0' && ch <= '9') || ch == '_';
+    }
+};
+
+struct QuoteClass {
+    static bool contains(const unsigned char ch) { return ch == '"' || ch == '\''; }
+};
+
+struct NewlineClass {
+    static bool contains(const unsigned char ch) { return ch == '\n'; }
+};
+
+// Skip = true stops at the first byte outside the class, Skip = false stops at the first byte inside it
+template <class Class, bool Skip>
+size_t scanScalar(const char* data, size_t i, const size_t size) {
+    while (i < size && Class::contains(static_cast<unsigned char>(data[i])) == Skip) {
+        ++i;
+    }
+    return i;
+}
+
+void newlinesScalar(const char* data, size_t i, const size_t size, std::vector<uint32_t>& positions) {
+    for (; i < size; ++i) {
+        if (data[i] == '\n') {
+            positions.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// every set bit of mask is a newline at base + bit
+void pushMask(uint32_t mask, const size_t base, std::vector<uint32_t>& positions) {
+    while (mask != 0) {
+        positions.push_back(static_cast<uint32_t>(base + std::countr_zero(mask)));
+        mask &= mask - 1;
+    }
+}
+
+#ifdef CUEL_SCANNER_SSE2
+
+// signed compares are fine here, every bound is ascii and bytes >= 0x80 are outside every class
+__m128i inRange(const __m128i c, const char lo, const char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(c, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+__m128i matchSse2(const __m128i c, WhitespaceClass) {
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), inRange(c, '\t', '\r'));
+}
+
+__m128i matchSse2(const __m128i c, WordClass) {
+    const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(inRange(lower, 'a', 'z'), inRange(c, '0', '9')),
+                        _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+}
+
+__m128i matchSse2(const __m128i c, QuoteClass) {
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('"')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\'')));
+}
+
+__m128i matchSse2(const __m128i c, NewlineClass) {
+    return _mm_cmpeq_epi8(c, _mm_set1_epi8('\n'));
+}
+
+template <class Class, bool Skip>
+size_t scanSse2(const char* data, size_t i, const size_t size) {
+    while (i + 16 <= size) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(matchSse2(chunk, Class{})));
+        if constexpr (Skip) {
+            mask = ~mask & 0xFFFFu;
+        }
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+        i += 16;
+    }
+    return scanScalar<Class, Skip>(data, i, size);
+}
+
+void newlinesSse2(const char* data, const size_t size, std::vector<uint32_t>& positions) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        pushMask(static_cast<uint32_t>(_mm_movemask_epi8(matchSse2(chunk, NewlineClass{}))), i, positions);
+    }
+    newlinesScalar(data, i, size, positions);
+}
+
+#endif
+
+#ifdef CUEL_SCANNER_AVX2
+
+CUEL_TARGET_AVX2 __m256i inRange(const __m256i c, const char lo, const char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), c));
+}
+
+CUEL_TARGET_AVX2 __m256i matchAvx2(const __m256i c, WhitespaceClass) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), inRange(c, '\t', '\r'));
+}
+
+CUEL_TARGET_AVX2 __m256i matchAvx2(const __m256i c, WordClass) {
+    const __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(inRange(lower, 'a', 'z'), inRange(c, '0', '9')),
+                           _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+}
+
+CUEL_TARGET_AVX2 __m256i matchAvx2(const __m256i c, QuoteClass) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\'')));
+}
+
+CUEL_TARGET_AVX2 __m256i matchAvx2(const __m256i c, NewlineClass) {
+    return _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'));
+}
+
+template <class Class, bool Skip>
+CUEL_TARGET_AVX2 size_t scanAvx2(const char* data, size_t i, const size_t size) {
+    while (i + 32 <= size) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(matchAvx2(chunk, Class{})));
+        if constexpr (Skip) {
+            mask = ~mask;
+        }
+        if (mask != 0) {
+            return i + std::countr_zero(mask);
+        }
+        i += 32;
+    }
+    // finish the tail 16 bytes at a time
+    return scanSse2<Class, Skip>(data, i, size);
+}
+
+CUEL_TARGET_AVX2 void newlinesAvx2(const char* data, const size_t size, std::vector<uint32_t>& positions) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        pushMask(static_cast<uint32_t>(_mm256_movemask_epi8(matchAvx2(chunk, NewlineClass{}))), i, positions);
+    }
+    newlinesScalar(data, i, size, positions);
+}
+
+#endif
+
+using ScanFunction = size_t (*)(const char*, size_t, size_t);
+using NewlinesFunction = void (*)(const char*, size_t, std::vector<uint32_t>&);
+
+struct ScanFunctions {
+    const char* name;
+    ScanFunction skipWhitespace;
+    ScanFunction skipWord;
+    ScanFunction findQuote;
+    ScanFunction findNewline;
+    NewlinesFunction findNewlines;
+};
+
+ScanFunctions selectScanFunctions() {
+#ifdef CUEL_SCANNER_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {
+            "avx2",
+            scanAvx2<WhitespaceClass, true>,
+            scanAvx2<WordClass, true>,
+            scanAvx2<QuoteClass, false>,
+            scanAvx2<NewlineClass, false>,
+            newlinesAvx2,
+        };
+    }
+#endif
+#ifdef CUEL_SCANNER_SSE2
+    return {
+        "sse2",
+        scanSse2<WhitespaceClass, true>,
+        scanSse2<WordClass, true>,
+        scanSse2<QuoteClass, false>,
+        scanSse2<NewlineClass, false>,
+        newlinesSse2,
+    };
+#else
+    return {
+        "scalar",
+        scanScalar<WhitespaceClass, true>,
+        scanScalar<WordClass, true>,
+        scanScalar<QuoteClass, false>,
+        scanScalar<NewlineClass, false>,
+        [](const char* data, const size_t size, std::vector<uint32_t>& positions) { newlinesScalar(data, 0, size, positions); },
+    };
+#endif
+}
+
+const ScanFunctions& scanFunctions() {
+    static const ScanFunctions functions = selectScanFunctions();
+    return functions;
+}
+
+}
+
+size_t skipWhitespace(const char* data, const size_t from, const size_t size) {
+    return scanFunctions().skipWhitespace(data, from, size);
+}
+
+size_t skipWord(const char* data, const size_t from, const size_t size) {
+    return scanFunctions().skipWord(data, from, size);
+}
+
+size_t findQuote(const char* data, const size_t from, const size_t size) {
+    return scanFunctions().findQuote(data, from, size);
+}
+
+size_t findStringEnd(const char* data, const size_t from, const size_t size) {
+    size_t quote = findQuote(data, from, size);
+    while (quote != size) {
+        // an odd run of backslashes escapes the quote, an even one only escapes itself
+        size_t backslashes = 0;
+        while (quote - backslashes > from && data[quote - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 0) {
+            return quote;
+        }
+        quote = findQuote(data, quote + 1, size);
+    }
+    return size;
+}
+
+size_t findNewline(const char* data, const size_t from, const size_t size) {
+    return scanFunctions().findNewline(data, from, size);
+}
+
+void findNewlines(const char* data, const size_t size, std::vector<uint32_t>& positions) {
+    scanFunctions().findNewlines(data, size, positions);
+}
+
+const char* scannerName() {
+    return scanFunctions().name;
+}
@@ -0,0 +1,33 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// byte run scanners used by the lexer
+// the best implementation (avx2, sse2 or scalar) is picked once at runtime from the cpu features
+// every function returns the index of the first byte at or after `from` that ends the run, or `size`
+
+// skips ' ', \t, \n, \v, \f, \r
+size_t skipWhitespace(const char* data, size_t from, size_t size);
+
+// skips letters, digits and _
+size_t skipWord(const char* data, size_t from, size_t size);
+
+// finds the next " or '
+size_t findQuote(const char* data, size_t from, size_t size);
+
+// finds the next " or ' that is not escaped with a backslash, from is just inside the string
+size_t findStringEnd(const char* data, size_t from, size_t size);
+
+// finds the next \n
+size_t findNewline(const char* data, size_t from, size_t size);
+
+// appends the index of every \n in data[0, size) to positions, a whole vector of them at a time
+void findNewlines(const char* data, size_t size, std::vector<uint32_t>& positions);
+
+// name of the selected implementation, for diagnostics
+const char* scannerName();
+
+#endif //SCANNER_H
@@ -0,0 +1,118 @@
+#include "sourcefile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+SourceFile::SourceFile(const std::string& path) {
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot read the size of " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0) {
+        CloseHandle(file);
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        throw std::runtime_error("Cannot map " + path);
+    }
+}
+
+void SourceFile::unmap() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+    }
+    data = nullptr;
+    mapping = nullptr;
+    size = 0;
+}
+
+#else
+
+SourceFile::SourceFile(const std::string& path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat info{};
+    if (fstat(file, &info) != 0) {
+        const int error = errno;
+        close(file);
+        throw std::runtime_error("Cannot read the size of " + path + ": " + std::strerror(error));
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        // mmap refuses empty mappings
+        close(file);
+        return;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    const int error = errno;
+    // the mapping keeps its own reference to the file
+    close(file);
+    if (mapped == MAP_FAILED) {
+        size = 0;
+        throw std::runtime_error("Cannot map " + path + ": " + std::strerror(error));
+    }
+    // the lexer reads front to back exactly once
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+}
+
+void SourceFile::unmap() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+    data = nullptr;
+    size = 0;
+}
+
+#endif
+
+SourceFile::SourceFile(SourceFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0))
+#ifdef _WIN32
+      , mapping(std::exchange(other.mapping, nullptr))
+#endif
+{
+}
+
+SourceFile& SourceFile::operator=(SourceFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+#ifdef _WIN32
+        mapping = std::exchange(other.mapping, nullptr);
+#endif
+    }
+    return *this;
+}
@@ -0,0 +1,35 @@
+#ifndef SOURCEFILE_H
+#define SOURCEFILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// read only memory mapping of a source file, text() points straight into the page cache
+// so the lexer and parser can borrow it without copying the file into a std::string
+class SourceFile {
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;
+#endif
+
+    void unmap();
+
+public:
+    SourceFile() = default;
+    // throws std::runtime_error when the file cannot be opened or mapped
+    explicit SourceFile(const std::string& path);
+    ~SourceFile() { unmap(); }
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile& operator=(SourceFile&& other) noexcept;
+
+    // stays valid as long as the SourceFile does, empty files map to an empty view
+    [[nodiscard]] std::string_view text() const { return {data, size}; }
+};
+
+#endif //SOURCEFILE_H
@@ -0,0 +1,71 @@
+#include "sourceloc.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include "scanner.h"
+
+LineTable::LineTable(const std::string_view text) {
+    // collects the newlines behind the first line's start, then turns each into the start of the next line
+    starts.reserve(text.size() / 32 + 1);
+    starts.push_back(0);
+    findNewlines(text.data(), text.size(), starts);
+    for (size_t i = 1; i < starts.size(); ++i) {
+        ++starts[i];
+    }
+}
+
+LineColumn LineTable::lineColumn(const uint32_t offset) const {
+    const auto line = std::ranges::upper_bound(starts, offset) - starts.begin();
+    return {static_cast<uint32_t>(line), offset - starts[static_cast<size_t>(line) - 1] + 1};
+}
+
+uint32_t SourceManager::addSource(std::string name, const std::string_view text) {
+    // one position past the end so EOF has a location too
+    if (text.size() >= UINT32_MAX - next) {
+        throw std::runtime_error("Too much source text for 32 bit locations: " + name);
+    }
+    sources.push_back({std::move(name), text, next, std::nullopt});
+    next += static_cast<uint32_t>(text.size()) + 1;
+    return static_cast<uint32_t>(sources.size() - 1);
+}
+
+const SourceManager::Source& SourceManager::sourceOf(const SourceLoc loc) const {
+    const auto after = std::ranges::upper_bound(sources, loc.rawValue(), {}, &Source::base);
+    if (!loc.isValid() || after == sources.begin()) {
+        throw std::out_of_range("Invalid source location");
+    }
+    return *std::prev(after);
+}
+
+SourceLoc SourceManager::location(const uint32_t file, const uint32_t offset) const {
+    const Source& source = sources[file];
+    if (offset > source.text.size()) {
+        throw std::out_of_range("Offset " + std::to_string(offset) + " outside of " + source.name);
+    }
+    return SourceLoc::fromRaw(source.base + offset);
+}
+
+uint32_t SourceManager::fileOf(const SourceLoc loc) const {
+    return static_cast<uint32_t>(&sourceOf(loc) - sources.data());
+}
+
+uint32_t SourceManager::offsetOf(const SourceLoc loc) const {
+    return loc.rawValue() - sourceOf(loc).base;
+}
+
+LineColumn SourceManager::lineColumn(const SourceLoc loc) const {
+    const Source& source = sourceOf(loc);
+    if (!source.lines) {
+        source.lines.emplace(source.text);
+    }
+    return source.lines->lineColumn(loc.rawValue() - source.base);
+}
+
+std::string SourceManager::describe(const SourceLoc loc) const {
+    const Source& source = sourceOf(loc);
+    const LineColumn position = lineColumn(loc);
+    return source.name + ":" + std::to_string(position.line) + ":" + std::to_string(position.column);
+}
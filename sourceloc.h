@@ -0,0 +1,85 @@
+#ifndef SOURCELOC_H
+#define SOURCELOC_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a position in one of the sources of a SourceManager, packed into 32 bits
+// every source owns the range [base, base + size] of one shared offset space (the last position is
+// its end), so file and offset both fit in one number and the file is found by binary search
+class SourceLoc {
+private:
+    uint32_t raw = 0;   // 0 is no location, the first source starts at 1
+
+public:
+    SourceLoc() = default;
+    static SourceLoc fromRaw(const uint32_t raw) { SourceLoc loc; loc.raw = raw; return loc; }
+
+    [[nodiscard]] uint32_t rawValue() const { return raw; }
+    [[nodiscard]] bool isValid() const { return raw != 0; }
+
+    friend bool operator==(SourceLoc, SourceLoc) = default;
+    friend auto operator<=>(SourceLoc, SourceLoc) = default;
+};
+
+static_assert(sizeof(SourceLoc) == 4);
+
+// 1 based, column counts bytes
+struct LineColumn {
+    uint32_t line;
+    uint32_t column;
+};
+
+// start offset of every line of a text, found with the vectorized newline scanner
+class LineTable {
+private:
+    std::vector<uint32_t> starts;
+
+public:
+    explicit LineTable(std::string_view text);
+
+    [[nodiscard]] size_t lineCount() const { return starts.size(); }
+    // offset of the first byte of line (1 based)
+    [[nodiscard]] uint32_t lineStart(const uint32_t line) const { return starts[line - 1]; }
+    // binary search over the line starts
+    [[nodiscard]] LineColumn lineColumn(uint32_t offset) const;
+};
+
+// the sources of one run, hands out their SourceLocs and turns them back into file, line and column
+// texts are borrowed and must outlive the manager; line tables are only built for sources that
+// are asked about, so lookups are not thread safe
+class SourceManager {
+private:
+    struct Source {
+        std::string name;
+        std::string_view text;
+        uint32_t base;
+        mutable std::optional<LineTable> lines;
+    };
+
+    std::vector<Source> sources;    // sorted by base
+    uint32_t next = 1;
+
+    [[nodiscard]] const Source& sourceOf(SourceLoc loc) const;
+
+public:
+    // returns the id of the source, ids are dense and start at 0
+    uint32_t addSource(std::string name, std::string_view text);
+
+    [[nodiscard]] size_t size() const { return sources.size(); }
+    [[nodiscard]] std::string_view name(const uint32_t file) const { return sources[file].name; }
+    [[nodiscard]] std::string_view text(const uint32_t file) const { return sources[file].text; }
+
+    [[nodiscard]] SourceLoc location(uint32_t file, uint32_t offset) const;
+    [[nodiscard]] uint32_t fileOf(SourceLoc loc) const;
+    [[nodiscard]] uint32_t offsetOf(SourceLoc loc) const;
+    [[nodiscard]] LineColumn lineColumn(SourceLoc loc) const;
+
+    // "name:line:column"
+    [[nodiscard]] std::string describe(SourceLoc loc) const;
+};
+
+#endif //SOURCELOC_H
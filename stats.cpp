@@ -0,0 +1,202 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// printf into a std::string, the report is small enough that this never matters
+template <class... Args>
+void appendf(std::string& out, const char* format, Args... args) {
+    char line[256];
+    const int length = std::snprintf(line, sizeof(line), format, args...);
+    out.append(line, static_cast<size_t>(std::clamp(length, 0, static_cast<int>(sizeof(line)) - 1)));
+}
+
+void pushList(std::vector<const ASTNode*>& stack, const NodeList& list) {
+    for (const ASTNode* node : list) {
+        stack.push_back(node);
+    }
+}
+
+// quotes and backslashes are escaped, control characters dropped, enough for file names
+void appendJsonString(std::string& out, const std::string_view text) {
+    out += '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+}
+
+void Stats::countTokens(const TokenBuffer& buffer) {
+    for (const uint8_t kind : buffer.kinds) {
+        ++tokens[kind];
+    }
+}
+
+void Stats::countNodes(const ParseResult& result) {
+    std::vector<const ASTNode*> stack;
+    pushList(stack, result.statements);
+    while (!stack.empty()) {
+        const ASTNode* node = stack.back();
+        stack.pop_back();
+        if (node == nullptr) {
+            continue;
+        }
+        ++nodes[node->kind];
+
+        switch (node->kind) {
+        case NODE_LITERAL:
+            stack.push_back(node->as<LiteralNode>()->value);
+            break;
+        case EXPRESSION_FUNCTION_CALL:
+            stack.push_back(node->as<FunctionCallNode>()->object);
+            pushList(stack, node->as<FunctionCallNode>()->arguments);
+            break;
+        case EXPRESSION_MEMBER_ACCESS:
+            stack.push_back(node->as<MemberAccessNode>()->object);
+            break;
+        case EXPRESSION_BINARY_OPERATION:
+            stack.push_back(node->as<BinaryOperationNode>()->left);
+            stack.push_back(node->as<BinaryOperationNode>()->right);
+            break;
+        case STATEMENT_BLOCK:
+            pushList(stack, node->as<BlockStatementNode>()->statements);
+            break;
+        case STATEMENT_ASSIGNMENT:
+            stack.push_back(node->as<AssignmentStatementNode>()->variable);
+            stack.push_back(node->as<AssignmentStatementNode>()->value);
+            break;
+        case STATEMENT_VARIABLE_DECLARATION:
+            stack.push_back(node->as<VariableDeclarationStatementNode>()->variable);
+            stack.push_back(node->as<VariableDeclarationStatementNode>()->value);
+            break;
+        case STATEMENT_GLOBAL_DECLARATION:
+            stack.push_back(node->as<GlobalDeclarationStatementNode>()->variable);
+            stack.push_back(node->as<GlobalDeclarationStatementNode>()->value);
+            break;
+        case STATEMENT_IF: {
+            const auto* statement = node->as<IfStatementNode>();
+            stack.push_back(statement->condition);
+            stack.push_back(statement->body);
+            pushList(stack, statement->elseifBodies);
+            stack.push_back(statement->elseBody);
+            break;
+        }
+        case STATEMENT_ELSE_IF:
+            stack.push_back(node->as<ElseIfStatementNode>()->condition);
+            stack.push_back(node->as<ElseIfStatementNode>()->body);
+            break;
+        case STATEMENT_ELSE:
+            stack.push_back(node->as<ElseStatementNode>()->body);
+            break;
+        case STATEMENT_WHILE:
+            stack.push_back(node->as<WhileStatementNode>()->condition);
+            stack.push_back(node->as<WhileStatementNode>()->body);
+            break;
+        case STATEMENT_SWITCH:
+            stack.push_back(node->as<SwitchStatementNode>()->value);
+            pushList(stack, node->as<SwitchStatementNode>()->cases);
+            stack.push_back(node->as<SwitchStatementNode>()->defaultBody);
+            break;
+        case STATEMENT_CASE:
+            stack.push_back(node->as<SwitchCaseNode>()->label);
+            stack.push_back(node->as<SwitchCaseNode>()->body);
+            break;
+        case STATEMENT_RETURN:
+            stack.push_back(node->as<ReturnStatementNode>()->expressions);
+            break;
+        case STATEMENT_FUNCTION_CALL:
+            stack.push_back(node->as<FunctionCallStatementNode>()->object);
+            pushList(stack, node->as<FunctionCallStatementNode>()->arguments);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+size_t Stats::tokenTotal() const {
+    size_t total = 0;
+    for (const size_t count : tokens) {
+        total += count;
+    }
+    return total;
+}
+
+size_t Stats::nodeTotal() const {
+    size_t total = 0;
+    for (const size_t count : nodes) {
+        total += count;
+    }
+    return total;
+}
+
+size_t Stats::bytesTotal() const {
+    size_t total = 0;
+    for (const Phase& phase : phases) {
+        total += phase.bytes;
+    }
+    return total;
+}
+
+std::string Stats::report() const {
+    std::string out;
+    out += "phase           time (ms)       bytes  source\n";    uint64_t time = 0;
+    for (const Phase& phase : phases) {
+        appendf(out, "%-12s %12.3f %11zu  ", phase.name.c_str(), static_cast<double>(phase.duration) / 1e6, phase.bytes);
+        out += phase.source;
+        out += '\n';
+        time += phase.duration;
+    }
+    appendf(out, "%-12s %12.3f %11zu\n", "total", static_cast<double>(time) / 1e6, bytesTotal());
+
+    appendf(out, "\ntokens %zu\n", tokenTotal());
+    for (size_t kind = 0; kind < tokens.size(); ++kind) {
+        if (tokens[kind] != 0) {
+            appendf(out, "  %-32s %zu\n", tokenTypeToString(static_cast<TokenType>(kind)).c_str(), tokens[kind]);
+        }
+    }
+
+    appendf(out, "\nnodes %zu\n", nodeTotal());
+    for (size_t kind = 0; kind < nodes.size(); ++kind) {
+        if (nodes[kind] != 0) {
+            appendf(out, "  %-32s %zu\n", nodeTypeToString(static_cast<NodeType>(kind)).c_str(), nodes[kind]);
+        }
+    }
+
+    appendf(out, "\nmax expression depth %u\nmax statement depth %u\n", maxExpressionDepth, maxStatementDepth);
+    return out;
+}
+
+std::string Stats::chromeTrace() const {
+    // "X" events take microseconds, all phases ran on one thread of one process
+    std::string out = "{\"traceEvents\":[";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase& phase = phases[i];
+        if (i > 0) {
+            out += ',';
+        }
+        out += "{\"name\":";
+        appendJsonString(out, phase.name);
+        appendf(out, ",\"cat\":\"cuel\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"bytes\":%zu",
+                static_cast<double>(phase.start) / 1e3, static_cast<double>(phase.duration) / 1e3, phase.bytes);
+        if (!phase.source.empty()) {
+            out += ",\"source\":";
+            appendJsonString(out, phase.source);
+        }
+        out += "}}";
+    }
+    out += "],\"displayTimeUnit\":\"ms\",\"otherData\":{";
+    appendf(out, "\"tokens\":%zu,\"nodes\":%zu,\"maxExpressionDepth\":%u,\"maxStatementDepth\":%u",
+            tokenTotal(), nodeTotal(), maxExpressionDepth, maxStatementDepth);
+    out += "}}\n";
+    return out;
+}
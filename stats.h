@@ -0,0 +1,88 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parser.h"
+#include "tokenize.h"
+
+constexpr size_t tokenTypeCount = TOK_EOF + 1;
+
+// what the pipeline did with one or more sources, filled in only when a Stats is attached
+// every hook is behind a null check, so a run without one pays for nothing but that branch
+// not thread safe, each thread collects into its own Stats
+class Stats {
+public:
+    struct Phase {
+        std::string name;
+        std::string source;     // file the phase worked on, empty when it is not about one file
+        uint64_t start;         // nanoseconds since the Stats was created
+        uint64_t duration;
+        size_t bytes;           // memory the phase allocated for its output (tokens, arena, bytecode)
+    };
+
+    std::vector<Phase> phases;
+    std::array<size_t, tokenTypeCount> tokens{};
+    std::array<size_t, nodeTypeCount> nodes{};
+    uint32_t maxExpressionDepth = 0;    // deepest expression stack of the parser, brackets and pending operators
+    uint32_t maxStatementDepth = 0;     // deepest nesting of blocks, the program's own statements are 1
+
+    Stats() : created(std::chrono::steady_clock::now()) {}
+
+    [[nodiscard]] uint64_t now() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - created).count());
+    }
+
+    void countTokens(const TokenBuffer& buffer);
+    // walks the whole tree, LiteralNode and the value node under it count separately
+    void countNodes(const ParseResult& result);
+
+    [[nodiscard]] size_t tokenTotal() const;
+    [[nodiscard]] size_t nodeTotal() const;
+    [[nodiscard]] size_t bytesTotal() const;
+
+    // human readable summary, phases in the order they ran followed by the counters
+    [[nodiscard]] std::string report() const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto), one complete event per phase
+    [[nodiscard]] std::string chromeTrace() const;
+
+private:
+    std::chrono::steady_clock::time_point created;
+};
+
+// times the enclosing scope as one phase, does nothing when stats is null
+class StatsPhase {
+private:
+    Stats* stats;
+    const char* name;
+    std::string_view source;
+    uint64_t start = 0;
+    size_t allocated = 0;
+
+public:
+    StatsPhase(Stats* stats, const char* name, const std::string_view source = {})
+        : stats(stats), name(name), source(source) {
+        if (stats != nullptr) {
+            start = stats->now();
+        }
+    }
+
+    ~StatsPhase() {
+        if (stats != nullptr) {
+            stats->phases.push_back({name, std::string(source), start, stats->now() - start, allocated});
+        }
+    }
+
+    StatsPhase(const StatsPhase&) = delete;
+    StatsPhase& operator=(const StatsPhase&) = delete;
+
+    void bytes(const size_t count) { allocated = count; }
+};
+
+#endif //STATS_H
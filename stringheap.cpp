@@ -0,0 +1,161 @@
+#include "stringheap.h"
+
+#include <algorithm>
+
+namespace {
+
+// concatenations up to this long are copied right away, a rope node would not save anything
+constexpr uint64_t flatConcatLimit = 64;
+
+// the heap grows to at least this many nodes before it is collected
+constexpr size_t minimumLimit = 4096;
+
+}
+
+void StringHeap::reset(const ProgramView& program) {
+    this->program = program;
+    nodes.clear();
+    limit = minimumLimit;
+}
+
+Value StringHeap::add(Node node) {
+    nodes.push_back(std::move(node));
+    return Value::fromString(static_cast<uint32_t>(fixed() + nodes.size() - 1));
+}
+
+uint64_t StringHeap::length(const Value& string) const {
+    if (string.isShortString()) {
+        return string.shortLength();
+    }
+    const uint32_t id = string.string();
+    return id < fixed() ? program.string(id).size() : nodes[id - fixed()].length;
+}
+
+void StringHeap::flatten(Node& node) {
+    std::string text;
+    text.reserve(node.length);
+    // left halves first, on an explicit stack since a string built in a loop is one long chain
+    std::vector<Value> parts{node.right, node.left};
+    char buffer[Value::shortStringSize];
+    while (!parts.empty()) {
+        const Value part = parts.back();
+        parts.pop_back();
+        if (part.isHeapString() && part.string() >= fixed()) {
+            const Node& child = nodes[part.string() - fixed()];
+            if (child.left.type() != VALUE_NONE) {
+                parts.push_back(child.right);
+                parts.push_back(child.left);
+                continue;
+            }
+        }
+        text += this->text(part, buffer);
+    }
+    node.text = std::move(text);
+    node.left = Value();
+    node.right = Value();
+}
+
+std::string_view StringHeap::text(const Value& string, char* buffer) {
+    if (string.isShortString()) {
+        return {buffer, string.copyShortString(buffer)};
+    }
+    const uint32_t id = string.string();
+    if (id < fixed()) {
+        return program.string(id);
+    }
+    Node& node = nodes[id - fixed()];
+    if (node.left.type() != VALUE_NONE) {
+        flatten(node);
+    }
+    return node.text;
+}
+
+Value StringHeap::concat(const Value& left, const Value& right) {
+    const uint64_t leftLength = length(left);
+    const uint64_t rightLength = length(right);
+    if (leftLength == 0) {
+        return right;
+    }
+    if (rightLength == 0) {
+        return left;
+    }
+
+    const uint64_t total = leftLength + rightLength;
+    if (total > flatConcatLimit) {
+        return add({{}, total, left, right});
+    }
+    char leftBuffer[Value::shortStringSize];
+    char rightBuffer[Value::shortStringSize];
+    const std::string_view leftText = text(left, leftBuffer);
+    const std::string_view rightText = text(right, rightBuffer);
+    if (total <= Value::shortStringSize) {
+        char joined[Value::shortStringSize];
+        std::copy(leftText.begin(), leftText.end(), joined);
+        std::copy(rightText.begin(), rightText.end(), joined + leftLength);
+        return Value::fromShortString({joined, total});
+    }
+    std::string joined;
+    joined.reserve(total);
+    joined += leftText;
+    joined += rightText;
+    return add({std::move(joined), total, {}, {}});
+}
+
+bool StringHeap::equal(const Value& a, const Value& b) {
+    if (a.identical(b)) {
+        return true;
+    }
+    // every string short enough to be inline is, so a short and a long one always differ
+    if (a.isShortString() || b.isShortString() || length(a) != length(b)) {
+        return false;
+    }
+    // neither is short, and flattening one node never moves another
+    return text(a, nullptr) == text(b, nullptr);
+}
+
+void StringHeap::mark(const Value& root) {
+    if (!root.isHeapString() || root.string() < fixed()) {
+        return;
+    }
+    pending.push_back(root.string() - fixed());
+    while (!pending.empty()) {
+        const uint32_t index = pending.back();
+        pending.pop_back();
+        if (forwarding[index] != 0) {
+            continue;
+        }
+        forwarding[index] = 1;
+        for (const Value& half : {nodes[index].left, nodes[index].right}) {
+            if (half.isHeapString() && half.string() >= fixed()) {
+                pending.push_back(half.string() - fixed());
+            }
+        }
+    }
+}
+
+void StringHeap::sweep() {
+    // a node is always made after its halves, so sliding the marked ones down in order moves every
+    // half before the nodes that point at it
+    size_t live = 0;
+    for (size_t index = 0; index < nodes.size(); ++index) {
+        if (forwarding[index] == 0) {
+            continue;
+        }
+        Node& node = nodes[live];
+        if (live != index) {
+            node = std::move(nodes[index]);
+        }
+        node.left = moved(node.left);
+        node.right = moved(node.right);
+        forwarding[index] = static_cast<uint32_t>(live++);
+    }
+    nodes.resize(live);
+    limit = std::max(2 * live, minimumLimit);
+}
+
+Value StringHeap::moved(const Value& value) const {
+    if (!value.isHeapString() || value.string() < fixed()) {
+        return value;
+    }
+    return Value::fromString(fixed() + forwarding[value.string() - fixed()]);
+}
@@ -0,0 +1,66 @@
+#ifndef STRINGHEAP_H
+#define STRINGHEAP_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiler.h"
+#include "value.h"
+
+// the strings of a running program that are too long to live in a Value
+// the program's own strings keep their ids and are read straight from it, strings made at run time
+// come after them; + on long strings makes a rope node that only points at its two halves, so
+// building a string piece by piece in a loop is linear, and the node is flattened into text the
+// first time something needs its characters
+class StringHeap {
+private:
+    struct Node {
+        std::string text;   // the characters, once flattened
+        uint64_t length = 0;
+        Value left;         // halves of a concatenation that has not been flattened yet,
+        Value right;        // both none once it has
+    };
+
+    ProgramView program;
+    // nodes[id - fixed()]
+    std::vector<Node> nodes;
+    size_t limit = 0;
+    // mark bits during a collection, new ids after it
+    std::vector<uint32_t> forwarding;
+    std::vector<uint32_t> pending;
+
+    [[nodiscard]] uint32_t fixed() const { return static_cast<uint32_t>(program.stringEnds.size()); }
+    Value add(Node node);
+    void flatten(Node& node);
+    void mark(const Value& root);
+    void sweep();
+    [[nodiscard]] Value moved(const Value& value) const;
+
+public:
+    // forgets every string made by a previous run
+    void reset(const ProgramView& program);
+
+    [[nodiscard]] uint64_t length(const Value& string) const;
+    // characters of string, buffer has to hold a short string's; a view into the heap stays valid
+    // until the next concat() or collection
+    std::string_view text(const Value& string, char* buffer);
+    Value concat(const Value& left, const Value& right);
+    bool equal(const Value& a, const Value& b);
+
+    [[nodiscard]] bool full() const { return nodes.size() > limit; }
+
+    // drops the strings nothing refers to any more and moves the others down
+    // forEachRoot(visit) has to call visit on every value that is still referenced, it is called
+    // twice and visit updates the values the second time
+    template<typename ForEachRoot>
+    void collect(const ForEachRoot& forEachRoot) {
+        forwarding.assign(nodes.size(), 0);
+        forEachRoot([this](Value& value) { mark(value); });
+        sweep();
+        forEachRoot([this](Value& value) { value = moved(value); });
+    }
+};
+
+#endif //STRINGHEAP_H
@@ -0,0 +1,249 @@
+// applies random edits to Documents and fails when their tokens or tree differ from lexing
+// and parsing the edited text from scratch
+//   CuelIncrementalTest [--documents N] [--edits N] [--seed N]
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "../flatast.h"
+#include "../incremental.h"
+#include "../parser.h"
+#include "../tokenize.h"
+
+namespace {
+
+// whole statements, most documents are built from these
+constexpr std::string_view statements[] = {
+    "var a = 1;\n",
+    "b = a + 2;\n",
+    "while (a < 3) { a += 1; }\n",
+    "if (a) { b = 1; } elseif (b) { c = 2.5; } else { }\n",
+    "switch (a) { case 1: b = 2; case 2: b = 3; default: c = \"s\"; }\n",
+    "return a;\n",
+};
+
+// pieces that break statements apart or glue tokens together
+constexpr std::string_view fragments[] = {
+    "}", "{", "x", " ", ";", "\"s\"", "// c\n", "//", "12", "1.5", "0x1F", "2e3", "1e+", "2.", "5", ".",
+    "e", "+", "-", "=", "(", ")", "\n", "'", "\"", "if (x) {\n", "}\n", "while (b) {\n b -= 1;\n}\n",
+    "break;", "i++;", "++", "case 1:",
+};
+
+// a document and two edits in a row
+struct FixedEdits {
+    std::string_view text;
+    TextEdit first;
+    TextEdit second;
+};
+
+// edits that once left the Document out of step with a fresh lex and parse
+constexpr FixedEdits fixedEdits[] = {
+    {"var a = 2.;", {10, 0, "5"}, {0, 0, ""}},
+    {"var a = 1e+;", {11, 0, "5"}, {0, 0, ""}},
+    {"var a = 1;\nb = a + 2;\n", {0, 21, ""}, {0, 0, ""}},
+    {"var a = 1;", {0, 0, "//"}, {0, 0, ""}},
+    {"(1.5if (x) {\n\n", {0, 0, "return a;\n"}, {20, 0, "2."}},
+};
+
+class Checker {
+private:
+    std::mt19937 random;
+    size_t failures = 0;
+    size_t edits = 0;
+    size_t partial = 0;     // edits that re-parsed less than the whole document
+
+    size_t pick(const size_t count) { return random() % count; }
+
+    std::string_view piece() {
+        return pick(3) == 0 ? statements[pick(std::size(statements))] : fragments[pick(std::size(fragments))];
+    }
+
+    void fail(const std::string_view what, const std::string_view before, const TextEdit& edit) {
+        if (++failures <= 10) {
+            std::cerr << what << " after replacing " << edit.removed << " bytes at " << edit.offset << " with \""
+                      << edit.inserted << "\" in\n" << before << "\n----\n";
+        }
+    }
+
+    static bool sameTokens(const TokenBuffer& expected, const TokenBuffer& tokens) {
+        if (expected.kinds != tokens.kinds || expected.offsets != tokens.offsets || expected.lengths != tokens.lengths ||
+            expected.payloads.size() != tokens.payloads.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < expected.size(); ++i) {
+            const std::optional<uint32_t> a = expected.payload(i);
+            const std::optional<uint32_t> b = tokens.payload(i);
+            if (a.has_value() != b.has_value()) {
+                return false;
+            }
+            if (!a) {
+                continue;
+            }
+            if (expected.type(i) == TOK_IDENTIFIER && expected.symbols.name(*a) != tokens.symbols.name(*b)) {
+                return false;
+            }
+            if (expected.type(i) == TOK_NUMBER && !(expected.numbers[*a] == tokens.numbers[*b])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // number literals are compared by value, the pools of the two trees are filled in different orders
+    static bool sameTree(const FlatAST& expected, const FlatAST& tree) {
+        if (expected.nodes.size() != tree.nodes.size() || expected.lists != tree.lists || expected.chars != tree.chars ||
+            expected.stringEnds != tree.stringEnds || expected.root != tree.root) {
+            return false;
+        }
+        for (size_t i = 0; i < expected.nodes.size(); ++i) {
+            const FlatNode& a = expected.nodes[i];
+            const FlatNode& b = tree.nodes[i];
+            if (a.kind != b.kind || a.op != b.op || a.flags != b.flags || a.lhs != b.lhs || a.rhs != b.rhs) {
+                return false;
+            }
+            const bool number = a.kind == NODE_LITERAL && a.op == LITERAL_NUMBER;
+            if (number ? !(expected.numbers[a.payload] == tree.numbers[b.payload]) : a.payload != b.payload) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit Checker(const uint32_t seed) : random(seed) {}
+
+    [[nodiscard]] size_t failed() const { return failures; }
+    [[nodiscard]] size_t checked() const { return edits; }
+    [[nodiscard]] size_t incremental() const { return partial; }
+
+    void check(Document& document, const TextEdit& edit) {
+        const std::string before(document.source());
+        std::string expected = before;
+        expected.replace(edit.offset, edit.removed, edit.inserted);
+        document.edit(edit);
+        ++edits;
+        if (document.lastReparsed() < document.tokens().size()) {
+            ++partial;
+        }
+        if (document.source() != expected) {
+            fail("text differs", before, edit);
+            return;
+        }
+
+        const TokenBuffer tokens = tokenize(expected);
+        if (!sameTokens(tokens, document.tokens())) {
+            fail("tokens differ", before, edit);
+            return;
+        }
+        Parser parser(tokens);
+        const ParseResult tree = parser.parse();
+        if (tree.hasErrors() == document.isParsed() ||
+            tree.diagnostics.size() != document.result().diagnostics.size()) {
+            fail("diagnostics differ", before, edit);
+            return;
+        }
+        if (!tree.hasErrors() && !sameTree(flatten(tree), flatten(document.result()))) {
+            fail("trees differ", before, edit);
+        }
+    }
+
+    // every other document is only edited a line at a time, so it stays valid and is mostly re-parsed
+    // incrementally; the others get arbitrary edits that break tokens and statements apart
+    void run(const size_t documents, const size_t editsPerDocument) {
+        for (size_t d = 0; d < documents; ++d) {
+            const bool byLine = d % 2 == 0;
+            std::string text;
+            for (int i = 0; i < 20; ++i) {
+                text += statements[pick(std::size(statements))];
+            }
+            Document document(text);
+            for (size_t e = 0; e < editsPerDocument; ++e) {
+                const std::string_view source = document.source();
+                size_t offset = pick(source.size() + 1);
+                size_t removed = 0;
+                std::string_view inserted;
+                if (byLine) {
+                    offset = offset == 0 ? 0 : source.rfind('\n', offset - 1) + 1;
+                    if (pick(2) == 0) {
+                        const size_t line = source.find('\n', offset);
+                        removed = line == std::string_view::npos ? source.size() - offset : line + 1 - offset;
+                    } else {
+                        inserted = statements[pick(std::size(statements))];
+                    }
+                } else {
+                    removed = pick(2) == 0 ? 0 : std::min(pick(8), source.size() - offset);
+                    inserted = pick(5) == 0 ? std::string_view() : piece();
+                }
+                switch (pick(40)) {
+                case 0:
+                    // everything goes
+                    offset = 0;
+                    removed = source.size();
+                    break;
+                case 1:
+                    // the whole program is commented out
+                    offset = 0;
+                    removed = 0;
+                    inserted = "//";
+                    break;
+                default:
+                    break;
+                }
+                check(document, {offset, removed, inserted});
+                if (document.source().size() > 4096) {
+                    break;
+                }
+            }
+        }
+    }
+};
+
+size_t parseCount(const std::string_view text) {
+    size_t value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::runtime_error("Invalid number: " + std::string(text));
+    }
+    return value;
+}
+
+}
+
+int main(const int argc, char** argv) {
+    size_t documents = 300;
+    size_t edits = 60;
+    uint32_t seed = 1;
+    try {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const std::string_view option = argv[i];
+            if (option == "--documents") {
+                documents = parseCount(argv[i + 1]);
+            } else if (option == "--edits") {
+                edits = parseCount(argv[i + 1]);
+            } else if (option == "--seed") {
+                seed = static_cast<uint32_t>(parseCount(argv[i + 1]));
+            } else {
+                throw std::runtime_error("Unknown option: " + std::string(option));
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 2;
+    }
+
+    Checker checker(seed);
+    for (const FixedEdits& fixed : fixedEdits) {
+        Document document{std::string(fixed.text)};
+        checker.check(document, fixed.first);
+        checker.check(document, fixed.second);
+    }
+    checker.run(documents, edits);
+    std::cout << checker.checked() << " edits, " << checker.incremental() << " parsed incrementally, "
+              << checker.failed() << " differ\n";
+    return checker.failed() == 0 ? 0 : 1;
+}
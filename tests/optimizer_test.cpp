@@ -0,0 +1,154 @@
+// runs every program with and without optimize() and fails when the two disagree,
+// in the value returned or in the error raised
+//   CuelOptimizerTest [--count N] [--seed N]
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../compiler.h"
+#include "../optimizer.h"
+#include "../parser.h"
+#include "../resolver.h"
+#include "../tokenize.h"
+#include "../typecheck.h"
+#include "../vm.h"
+
+namespace {
+
+// programs that once folded to something the vm would not have produced
+constexpr std::string_view fixedCases[] = {
+    "var x = \"s\"; var a = x * 1; return a;",
+    "var x = \"s\"; return 1 * x;",
+    "var x = \"s\"; return x + 0;",
+    "var x = \"s\"; return x - 0;",
+    "var x = \"s\"; return x / 1;",
+    "var x = true; var y = x * 1; return y;",
+    "var x = true; return x + 0;",
+    "var x = 2.5; var y = x | 0; return y;",
+    "var x = 2.5; return x ^ 0;",
+    "var x = 2.5; return x << 0;",
+    "var x = 2.5; return x >> 0;",
+    "var x = 2.5; return 0 | x;",
+    "var x = 0.0 * (0.0 - 1.0); var z = (x * 1.0) + 0; return z;",
+    "var x = 3; return (x - 1) * 1;",
+    "var x = 3; return (x & 6) | 0;",
+    "var x = 3; return (x + 0.5) / 1;",
+    "var x = \"s\"; return (x + \"t\") + 0;",
+};
+
+constexpr std::string_view operands[] = {
+    "0", "1", "2", "7", "0.0", "1.0", "2.5", "1e300", "9223372036854775807", "0x8000000000000000",
+    "true", "false", "\"s\"", "\"\"", "i", "f", "s", "b",
+};
+
+constexpr std::string_view operators[] = {
+    "+", "-", "*", "/", "%", "<", ">", "<=", ">=", "==", "!=", "&", "|", "^", "<<", ">>", "&&", "||",
+};
+
+// the result of a program as text, an error is its message
+std::string run(const std::string_view source, const bool fold) {
+    TokenBuffer tokens = tokenize(source);
+    Parser parser(tokens);
+    ParseResult ast = parser.parse();
+    if (ast.hasErrors()) {
+        return "syntax error";
+    }
+    try {
+        if (fold) {
+            optimize(ast);
+        }
+        resolve(ast);
+        checkTypes(ast);
+        Compiler compiler;
+        const Program program = compiler.compile(ast);
+        VM vm(program.view());
+        return vm.toString(vm.run());
+    } catch (const std::runtime_error& error) {
+        return std::string("error: ") + error.what();
+    }
+}
+
+class Generator {
+private:
+    std::mt19937 random;
+
+    size_t pick(const size_t count) { return random() % count; }
+
+public:
+    explicit Generator(const uint32_t seed) : random(seed) {}
+
+    // an expression of depth at most depth, made to hit the identities often
+    std::string expression(const int depth) {
+        if (depth == 0 || pick(4) == 0) {
+            return std::string(operands[pick(std::size(operands))]);
+        }
+        const std::string_view operation = operators[pick(std::size(operators))];
+        std::string left = expression(depth - 1);
+        std::string right = pick(3) == 0 ? std::string(pick(2) == 0 ? "0" : "1") : expression(depth - 1);
+        if (pick(2) == 0) {
+            std::swap(left, right);
+        }
+        return "(" + left + " " + std::string(operation) + " " + right + ")";
+    }
+
+    std::string program() {
+        std::string source = "var i = 3; var f = 0.0 * (0.0 - 1.0); var s = \"x\"; var b = true;\n";
+        source += "var r = " + expression(3) + ";\n";
+        source += "return " + expression(4) + ";\n";
+        return source;
+    }
+};
+
+size_t parseCount(const std::string_view text) {
+    size_t value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+        throw std::runtime_error("Invalid number: " + std::string(text));
+    }
+    return value;
+}
+
+}
+
+int main(const int argc, char** argv) {
+    size_t count = 20000;
+    uint32_t seed = 1;
+    try {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const std::string_view option = argv[i];
+            if (option == "--count") {
+                count = parseCount(argv[i + 1]);
+            } else if (option == "--seed") {
+                seed = static_cast<uint32_t>(parseCount(argv[i + 1]));
+            } else {
+                throw std::runtime_error("Unknown option: " + std::string(option));
+            }
+        }
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 2;
+    }
+
+    std::vector<std::string> programs(std::begin(fixedCases), std::end(fixedCases));
+    Generator generator(seed);
+    for (size_t i = 0; i < count; ++i) {
+        programs.push_back(generator.program());
+    }
+
+    size_t failures = 0;
+    for (const std::string& source : programs) {
+        const std::string plain = run(source, false);
+        const std::string folded = run(source, true);
+        if (plain != folded && ++failures <= 10) {
+            std::cerr << source << "\n  unfolded: " << plain << "\n  folded:   " << folded << "\n";
+        }
+    }
+    std::cout << programs.size() << " programs, " << failures << " differ\n";
+    return failures == 0 ? 0 : 1;
+}
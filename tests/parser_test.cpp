@@ -0,0 +1,125 @@
+// parses programs with known mistakes and fails unless every one of them is reported, once and
+// at the token where it is, and runs every form of global declaration
+//   CuelParserTest
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../compiler.h"
+#include "../diagnostics.h"
+#include "../parser.h"
+#include "../resolver.h"
+#include "../tokenize.h"
+#include "../typecheck.h"
+#include "../vm.h"
+
+namespace {
+
+struct Expected {
+    DiagnosticCode code;
+    uint32_t offset;
+};
+
+struct ErrorCase {
+    std::string_view source;
+    std::vector<Expected> diagnostics;
+};
+
+const ErrorCase errorCases[] = {
+    // tokens that cannot start a statement used to be skipped without a word
+    {"var x = 1; 5; ) @ return x;", {{DIAG_EXPECTED_STATEMENT, 11}, {DIAG_EXPECTED_STATEMENT, 14}}},
+    {"var x = 1; @ x = 2;", {{DIAG_EXPECTED_STATEMENT, 11}}},
+    {"var x = 1; { x = 2; } return x;", {{DIAG_EXPECTED_STATEMENT, 11}}},
+    {"var x = 1; x = 2 3; return x;", {{DIAG_EXPECTED_STATEMENT, 17}}},
+    {"if (true) { ) } var y = 1; ]", {{DIAG_EXPECTED_STATEMENT, 12}, {DIAG_EXPECTED_STATEMENT, 27}}},
+    {"else { } var y = 1;", {{DIAG_EXPECTED_STATEMENT, 0}}},
+    // empty statements and the ';' ending an expression statement are fine
+    {"var x = 1;; ; x; return x;", {}},
+    {"var x = 1; x = ; return x;", {{DIAG_EXPECTED_EXPRESSION, 15}}},
+    {"}", {{DIAG_UNMATCHED_BRACE, 0}}},
+    {"global var<num> g = 1;", {{DIAG_UNEXPECTED_TOKEN, 11}}},
+    {"global var = 1;", {{DIAG_UNEXPECTED_TOKEN, 11}}},
+};
+
+bool check(const ErrorCase& test) {
+    const TokenBuffer tokens = tokenize(test.source);
+    Parser parser(tokens);
+    const ParseResult result = parser.parse();
+    bool same = result.diagnostics.size() == test.diagnostics.size();
+    for (size_t i = 0; same && i < test.diagnostics.size(); ++i) {
+        same = result.diagnostics[i].code == test.diagnostics[i].code &&
+               result.diagnostics[i].offset == test.diagnostics[i].offset;
+    }
+    if (!same) {
+        std::cerr << test.source << "\n  expected " << test.diagnostics.size() << " diagnostics, got\n"
+                  << result.diagnostics.formatAll(test.source, "    ");
+    }
+    return same;
+}
+
+struct GlobalCase {
+    std::string_view source;
+    VariableType declared;
+    std::string_view result;    // what the program returns, or the error it raises
+};
+
+// the first statement of each is a global declaration, the documented form has a var behind global
+const GlobalCase globalCases[] = {
+    {"global var g = 1; return g;", VARIABLE_GENERIC, "1"},
+    {"global g = 2; g += 3; return g;", VARIABLE_GENERIC, "5"},
+    {"global var<number> g = 1; g = g * 5; return g;", VARIABLE_NUMBER, "5"},
+    {"global var<string> g = \"a\"; var x = 1; while (x < 3) { g = g + \"b\"; x++; } return g;", VARIABLE_STRING, "abb"},
+    {"global var<bool> g = true; g = g && false; return g;", VARIABLE_BOOLEAN, "false"},
+    {"global var<number> g = 1; g = \"s\"; return g;", VARIABLE_NUMBER,
+     "error: Cannot assign a string to number variable g"},
+    {"global var<string> g = \"a\"; var x = 1; if (x) { x = 2; } else { x = \"s\"; } g = x; return g;",
+     VARIABLE_STRING, "error: Value does not match the declared type"},
+};
+
+bool check(const GlobalCase& test) {
+    const TokenBuffer tokens = tokenize(test.source);
+    Parser parser(tokens);
+    ParseResult result = parser.parse();
+    std::string outcome;
+    const auto* block = result.hasErrors() ? nullptr : result.statements[0]->as<BlockStatementNode>();
+    const auto* declaration = block != nullptr ? block->statements[0]->as<GlobalDeclarationStatementNode>() : nullptr;
+    if (declaration == nullptr || declaration->declared != test.declared) {
+        outcome = "no global declaration of the expected type";
+    } else {
+        try {
+            resolve(result);
+            checkTypes(result);
+            Compiler compiler;
+            const Program program = compiler.compile(result);
+            VM vm(program.view());
+            outcome = program.globalCount == 1 ? vm.toString(vm.run()) : "no global slot";
+        } catch (const std::runtime_error& error) {
+            outcome = std::string("error: ") + error.what();
+        }
+    }
+    if (outcome != test.result) {
+        std::cerr << test.source << "\n  expected " << test.result << ", got " << outcome << "\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main() {
+    size_t failures = 0;
+    for (const ErrorCase& test : errorCases) {
+        if (!check(test)) {
+            ++failures;
+        }
+    }
+    for (const GlobalCase& test : globalCases) {
+        if (!check(test)) {
+            ++failures;
+        }
+    }
+    std::cout << std::size(errorCases) + std::size(globalCases) << " programs, " << failures << " failed\n";
+    return failures == 0 ? 0 : 1;
+}
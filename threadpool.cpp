@@ -0,0 +1,120 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    workers.reserve(threads - 1);
+    for (size_t i = 0; i + 1 < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        const std::lock_guard guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::take(const size_t queue, size_t& item) {
+    {
+        Queue& own = *queues[queue];
+        const std::lock_guard guard(own.lock);
+        if (!own.items.empty()) {
+            item = own.items.front();
+            own.items.pop_front();
+            return true;
+        }
+    }
+    // steal from the back, where the victim will get to last
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(queue + offset) % queues.size()];
+        const std::lock_guard guard(victim.lock);
+        if (!victim.items.empty()) {
+            item = victim.items.back();
+            victim.items.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(const size_t queue) {
+    size_t item = 0;
+    while (take(queue, item)) {
+        try {
+            (*job)(item);
+        } catch (...) {
+            const std::lock_guard guard(lock);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const std::lock_guard guard(lock);
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(const size_t queue) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work(queue);
+    }
+}
+
+void ThreadPool::forEach(const std::vector<size_t>& order, const std::function<void(size_t)>& task) {
+    if (order.empty()) {
+        return;
+    }
+    {
+        const std::lock_guard guard(lock);
+        job = &task;
+        failure = nullptr;
+        pending.store(order.size(), std::memory_order_relaxed);
+        // deal the items out round robin, so every queue starts with a share of the front of the order
+        for (size_t i = 0; i < order.size(); ++i) {
+            Queue& queue = *queues[i % queues.size()];
+            const std::lock_guard queueGuard(queue.lock);
+            queue.items.push_back(order[i]);
+        }
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(queues.size() - 1);
+
+    std::unique_lock guard(lock);
+    done.wait(guard, [&] { return pending.load(std::memory_order_acquire) == 0; });
+    job = nullptr;
+    if (failure) {
+        std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+}
+
+void ThreadPool::forEach(const size_t count, const std::function<void(size_t)>& task) {
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), size_t{0});
+    forEach(order, task);
+}
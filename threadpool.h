@@ -0,0 +1,60 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads with one task queue each
+// a thread takes work from the front of its own queue and, once that is empty,
+// steals from the back of the others, so uneven tasks still keep every core busy
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> items;
+    };
+
+    std::vector<std::thread> workers;
+    // one per worker, the last one belongs to the thread calling forEach()
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* job = nullptr;
+    uint64_t generation = 0;
+    bool stopping = false;
+    std::atomic<size_t> pending{0};
+    std::exception_ptr failure;
+
+    bool take(size_t queue, size_t& item);
+    void work(size_t queue);
+    void workerLoop(size_t queue);
+
+public:
+    // threads counts the calling thread, 0 picks one per hardware thread
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    [[nodiscard]] size_t size() const { return queues.size(); }
+
+    // runs task(i) for every i in order, spread over the pool, and returns once all of them finished
+    // the calling thread works too, the first exception a task throws is rethrown here
+    // tasks must not call forEach() themselves
+    void forEach(const std::vector<size_t>& order, const std::function<void(size_t)>& task);
+    void forEach(size_t count, const std::function<void(size_t)>& task);
+};
+
+#endif //THREADPOOL_H
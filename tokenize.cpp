@@ -1,234 +1,334 @@
 #include "tokenize.h"
+#include "scanner.h"
 #include <algorithm>
-#include <sstream>
-#include <cctype>
-#include <unordered_set>
+#include <array>
+#include <stdexcept>
+#include <string_view>
 
-bool isNumber(const std::string& word);
-bool isBoolean(const std::string& word);
-bool isDataType(const std::string& str);
-bool isOperator(char ch);
-bool isSpecialChar(char ch);
-TokenType getTokenType(const std::string& keyword);
-TokenType getOperatorType(const std::string& op);
-TokenType getStatementType(const std::string& word);
-TokenType getDataType(const std::string& word);
-TokenType getBooleanType(const std::string& word);
-TokenType checkTypedVariable(const std::string& word);
+// character classes for the main loop, one lookup per byte instead of locale aware <cctype> calls
+enum CharClass : uint8_t {
+    CHAR_OTHER = 0,
+    CHAR_SPACE = 1 << 0,
+    CHAR_WORD = 1 << 1,      // letters, digits, _
+    CHAR_DIGIT = 1 << 2,
+    CHAR_QUOTE = 1 << 3,
+    CHAR_PUNCT = 1 << 4,     // single character tokens ( ) { } [ ] ; . , :
+    CHAR_OPERATOR = 1 << 5,  // characters that can start an operator
+};
 
-bool isNumber(const std::string& word) {
-    return !word.empty() && std::ranges::all_of(word, ::isdigit);
-}
+constexpr std::array<uint8_t, 256> charClasses = [] {
+    std::array<uint8_t, 256> table{};
+    for (const char ch : std::string_view(" \t\n\v\f\r")) table[static_cast<unsigned char>(ch)] = CHAR_SPACE;
+    for (int ch = 'a'; ch <= 'z'; ++ch) table[ch] = CHAR_WORD;
+    for (int ch = 'A'; ch <= 'Z'; ++ch) table[ch] = CHAR_WORD;
+    for (int ch = '0'; ch <= '9'; ++ch) table[ch] = CHAR_WORD | CHAR_DIGIT;
+    table['_'] = CHAR_WORD;
+    table['"'] = CHAR_QUOTE;
+    table['\''] = CHAR_QUOTE;
+    for (const char ch : std::string_view("(){}[];.,:")) table[static_cast<unsigned char>(ch)] = CHAR_PUNCT;
+    for (const char ch : std::string_view("=+-*/%!<>&|^~")) table[static_cast<unsigned char>(ch)] = CHAR_OPERATOR;
+    return table;
+}();
 
-bool isBoolean(const std::string& word) {
-    return word == "true" || word == "false";
-}
+constexpr std::array<uint8_t, 256> punctTypes = [] {
+    std::array<uint8_t, 256> table{};
+    table['('] = TOK_OPEN_PAREN;
+    table[')'] = TOK_CLOSE_PAREN;
+    table['{'] = TOK_OPEN_BRACE;
+    table['}'] = TOK_CLOSE_BRACE;
+    table['['] = TOK_OPEN_BRACKET;
+    table[']'] = TOK_CLOSE_BRACKET;
+    table[';'] = TOK_SEMICOLON;
+    table['.'] = TOK_DOT;
+    table[','] = TOK_COMMA;
+    table[':'] = TOK_COLON;
+    return table;
+}();
 
-bool isOperator(const std::string& word) {
-    static const std::unordered_set<std::string> operators = {
-        "=", "+", "-", "*", "/", "%", "+=", "-=", "*=", "/=", "%=",
-        "++", "--",
-        "==", "!=", ">", "<", ">=", "<=",
-        "&&", "||", "!", "&", "|", "^", "~", "<<", ">>"
-    };
-    return operators.contains(word);
+inline uint8_t charClass(const char ch) {
+    return charClasses[static_cast<unsigned char>(ch)];
 }
 
-bool isSpecialChar(const char ch) {
-    return ch == '(' || ch == ')' || ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ';' || ch == '.';
+// keywords are matched by length first, then by first character, so an identifier costs
+// at most one or two compares
+constexpr TokenType getKeywordType(const std::string_view word) {
+    switch (word.size()) {
+    case 2:
+        if (word == "if") return TOK_IF_STATEMENT;
+        break;
+    case 3:
+        switch (word[0]) {
+        case 'v': if (word == "var") return TOK_VAR; break;
+        case 'f': if (word == "for") return TOK_FOR_STATEMENT; break;
+        default: break;
+        }
+        break;
+    case 4:
+        switch (word[0]) {
+        case 'e': if (word == "else") return TOK_ELSE_STATEMENT; break;
+        case 'c': if (word == "case") return TOK_CASE_STATEMENT; break;
+        case 't': if (word == "true") return TOK_TRUE; break;
+        case 'b': if (word == "bool") return TOK_VAR_TYPE; break;
+        default: break;
+        }
+        break;
+    case 5:
+        switch (word[0]) {
+        case 'w': if (word == "while") return TOK_WHILE_STATEMENT; break;
+        case 'b': if (word == "break") return TOK_BREAK_STATEMENT; break;
+        case 'f': if (word == "false") return TOK_FALSE; break;
+        case 'c': if (word == "const") return TOK_VAR_CONST; break;
+        default: break;
+        }
+        break;
+    case 6:
+        switch (word[0]) {
+        case 'e': if (word == "elseif") return TOK_ELSEIF_STATEMENT; break;
+        case 's':
+            if (word == "switch") return TOK_SWITCH_STATEMENT;
+            if (word == "string") return TOK_VAR_TYPE;
+            break;
+        case 'r': if (word == "return") return TOK_RETURN_STATEMENT; break;
+        case 'g': if (word == "global") return TOK_GLOBAL_VAR; break;
+        case 'n': if (word == "number") return TOK_VAR_TYPE; break;
+        default: break;
+        }
+        break;
+    case 7:
+        if (word == "default") return TOK_DEFAULT_STATEMENT;
+        break;
+    case 8:
+        if (word == "continue") return TOK_CONTINUE_STATEMENT;
+        break;
+    default:
+        break;
+    }
+    return TOK_IDENTIFIER;
 }
 
-TokenType getTokenType(const std::string& keyword) {
-    if (keyword == "=") return TOK_ASSIGNMENT;
-    if (keyword == "+") return TOK_ADDITION;
-    if (keyword == "-") return TOK_SUBTRACTION;
-    if (keyword == "*") return TOK_MULTIPLICATION;
-    if (keyword == "/") return TOK_DIVISION;
-    if (keyword == "%") return TOK_MODULUS;
-    if (keyword == "+=") return TOK_ADDITION_ASSIGNMENT;
-    if (keyword == "-=") return TOK_SUBTRACTION_ASSIGNMENT;
-    if (keyword == "*=") return TOK_MULTIPLICATION_ASSIGNMENT;
-    if (keyword == "/=") return TOK_DIVISION_ASSIGNMENT;
-    if (keyword == "%=") return TOK_MODULUS_ASSIGNMENT;
-    if (keyword == "++") return TOK_INCREMENT;
-    if (keyword == "--") return TOK_DECREMENT;
-    if (keyword == "==") return TOK_EQUAL;
-    if (keyword == "!=") return TOK_NOT_EQUAL;
-    if (keyword == ">") return TOK_GREATER;
-    if (keyword == "<") return TOK_LESS;
-    if (keyword == ">=") return TOK_GREATER_EQUAL;
-    if (keyword == "<=") return TOK_LESS_EQUAL;
-    if (keyword == "&&") return TOK_AND;
-    if (keyword == "||") return TOK_OR;
-    if (keyword == "!") return TOK_NOT;
-    if (keyword == "&") return TOK_BITWISE_AND;
-    if (keyword == "|") return TOK_BITWISE_OR;
-    if (keyword == "^") return TOK_BITWISE_XOR;
-    if (keyword == "~") return TOK_BITWISE_NOT;
-    if (keyword == "<<") return TOK_LEFT_SHIFT;
-    if (keyword == ">>") return TOK_RIGHT_SHIFT;
-
-    if (keyword == ";") return TOK_SEMICOLON;
+// second is the character after first, or '\0' at the end of the input
+// the returned length is 0 when first does not start an operator
+constexpr std::pair<TokenType, size_t> getOperatorType(const char first, const char second) {
+    switch (first) {
+    case '=': return second == '=' ? std::pair(TOK_EQUAL, 2) : std::pair(TOK_ASSIGNMENT, 1);
+    case '+':
+        if (second == '=') return {TOK_ADDITION_ASSIGNMENT, 2};
+        if (second == '+') return {TOK_INCREMENT, 2};
+        return {TOK_ADDITION, 1};
+    case '-':
+        if (second == '=') return {TOK_SUBTRACTION_ASSIGNMENT, 2};
+        if (second == '-') return {TOK_DECREMENT, 2};
+        return {TOK_SUBTRACTION, 1};
+    case '*': return second == '=' ? std::pair(TOK_MULTIPLICATION_ASSIGNMENT, 2) : std::pair(TOK_MULTIPLICATION, 1);
+    case '/': return second == '=' ? std::pair(TOK_DIVISION_ASSIGNMENT, 2) : std::pair(TOK_DIVISION, 1);
+    case '%': return second == '=' ? std::pair(TOK_MODULUS_ASSIGNMENT, 2) : std::pair(TOK_MODULUS, 1);
+    case '!': return second == '=' ? std::pair(TOK_NOT_EQUAL, 2) : std::pair(TOK_NOT, 1);
+    case '>':
+        if (second == '=') return {TOK_GREATER_EQUAL, 2};
+        if (second == '>') return {TOK_RIGHT_SHIFT, 2};
+        return {TOK_GREATER, 1};
+    case '<':
+        if (second == '=') return {TOK_LESS_EQUAL, 2};
+        if (second == '<') return {TOK_LEFT_SHIFT, 2};
+        return {TOK_LESS, 1};
+    case '&': return second == '&' ? std::pair(TOK_AND, 2) : std::pair(TOK_BITWISE_AND, 1);
+    case '|': return second == '|' ? std::pair(TOK_OR, 2) : std::pair(TOK_BITWISE_OR, 1);
+    case '^': return {TOK_BITWISE_XOR, 1};
+    case '~': return {TOK_BITWISE_NOT, 1};
+    default: return {TOK_UNKNOWN, 0};
+    }
+}
 
-    if (keyword == "if") return TOK_IF_STATEMENT;
-    if (keyword == "elseif") return TOK_ELSEIF_STATEMENT;
-    if (keyword == "else") return TOK_ELSE_STATEMENT;
-    if (keyword == "for") return TOK_FOR_STATEMENT;
-    if (keyword == "while") return TOK_WHILE_STATEMENT;
-    if (keyword == "switch") return TOK_SWITCH_STATEMENT;
-    if (keyword == "case") return TOK_CASE_STATEMENT;
-    if (keyword == "default") return TOK_DEFAULT_STATEMENT;
-    if (keyword == "break") return TOK_BREAK_STATEMENT;
-    if (keyword == "continue") return TOK_CONTINUE_STATEMENT;
-    if (keyword == "return") return TOK_RETURN_STATEMENT;
-    if (keyword == "true") return TOK_TRUE;
-    if (keyword == "false") return TOK_FALSE;
-    if (keyword == "var") return TOK_VAR;
+static_assert(getKeywordType("elseif") == TOK_ELSEIF_STATEMENT && getKeywordType("elsei") == TOK_IDENTIFIER);
+static_assert(getOperatorType('<', '<').first == TOK_LEFT_SHIFT && getOperatorType('<', ' ').first == TOK_LESS);
 
-    return TOK_UNKNOWN;
+inline bool isDigit(const char* begin, const size_t i, const size_t size) {
+    return i < size && (charClass(begin[i]) & CHAR_DIGIT);
 }
 
-TokenType getOperatorType(const std::string& op) {
-    return isOperator(op) ? getTokenType(op) : TOK_UNKNOWN;
+// end of the number literal starting at i: 0x hex, or digits with an optional .fraction and exponent
+// word characters stuck to the literal belong to it, so 12ab is one invalid number and not 12 then ab
+// truncated is set when the literal may go on past size
+size_t skipNumber(const char* begin, size_t i, const size_t size, bool& truncated) {
+    if (begin[i] == '0' && i + 1 < size && (begin[i + 1] == 'x' || begin[i + 1] == 'X')) {
+        i = skipWord(begin, i + 2, size);
+        truncated = i == size;
+        return i;
+    }
+    while (isDigit(begin, i, size)) {
+        ++i;
+    }
+    // the '.' only belongs to the number with a digit behind it, 1.x stays a member access
+    if (i + 1 < size && begin[i] == '.' && isDigit(begin, i + 1, size)) {
+        i += 2;
+        while (isDigit(begin, i, size)) {
+            ++i;
+        }
+    }
+    if (i < size && (begin[i] == 'e' || begin[i] == 'E')) {
+        const size_t sign = i + 1 < size && (begin[i + 1] == '+' || begin[i + 1] == '-') ? i + 2 : i + 1;
+        if (isDigit(begin, sign, size)) {
+            i = sign + 1;
+            while (isDigit(begin, i, size)) {
+                ++i;
+            }
+        } else if (sign >= size) {
+            truncated = true;
+            return size;
+        }
+    }
+    if (i + 1 == size && begin[i] == '.') {
+        // a fraction may follow in the next chunk
+        truncated = true;
+        return size;
+    }
+    i = skipWord(begin, i, size);
+    truncated = i == size;
+    return i;
 }
 
-TokenType getStatementType(const std::string& word) {
-    if (word == "if") return TOK_IF_STATEMENT;
-    if (word == "elseif") return TOK_ELSEIF_STATEMENT;
-    if (word == "else") return TOK_ELSE_STATEMENT;
-    if (word == "for") return TOK_FOR_STATEMENT;
-    if (word == "while") return TOK_WHILE_STATEMENT;
-    if (word == "switch") return TOK_SWITCH_STATEMENT;
-    if (word == "case") return TOK_CASE_STATEMENT;
-    if (word == "default") return TOK_DEFAULT_STATEMENT;
-    if (word == "break") return TOK_BREAK_STATEMENT;
-    if (word == "continue") return TOK_CONTINUE_STATEMENT;
-    if (word == "return") return TOK_RETURN_STATEMENT;
+// start is an index into tokens.source
+void pushNumber(TokenBuffer& tokens, const size_t start, const size_t length) {
+    const size_t offset = tokens.sourceBase + start;
+    tokens.push(TOK_NUMBER, offset, length);
+    // numbers that cannot be decoded get no payload, the parser reports them
+    if (const std::optional<Number> number = parseNumber(tokens.source.substr(start, length))) {
+        tokens.pushPayload(offset, tokens.numbers.add(*number));
+    }
+}
 
-    return TOK_UNKNOWN;
+// start is an index into tokens.source
+void pushWord(TokenBuffer& tokens, const size_t start, const size_t length) {
+    const std::string_view word = tokens.source.substr(start, length);
+    const size_t offset = tokens.sourceBase + start;
+    const TokenType type = getKeywordType(word);
+    tokens.push(type, offset, length);
+    if (type == TOK_IDENTIFIER) {
+        tokens.pushPayload(offset, tokens.symbols.intern(word));
+    }
 }
 
-TokenType getDataType(const std::string& word) {
-    if (word == "var") return TOK_VAR;
-    if (word == "const") return TOK_VAR_CONST;
-    if (word == "global") return TOK_GLOBAL_VAR;
-    if (word == "number" || word == "string" || word == "bool") return TOK_VAR_TYPE;
+std::optional<uint32_t> TokenBuffer::payload(const size_t index) const {
+    const uint32_t offset = offsets[index];
+    const auto it = std::ranges::lower_bound(payloads, offset, {}, &Payload::offset);
+    if (it == payloads.end() || it->offset != offset) {
+        return std::nullopt;
+    }
+    return it->value;
+}
 
-    return TOK_UNKNOWN;
+void TokenBuffer::reserve(const size_t count) {
+    kinds.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
 }
 
-TokenType getBooleanType(const std::string& word) {
-    return isBoolean(word) ? (word == "true" ? TOK_TRUE : TOK_FALSE) : TOK_UNKNOWN;
+size_t TokenBuffer::bytesReserved() const {
+    return kinds.capacity() * sizeof(uint8_t) + offsets.capacity() * sizeof(uint32_t) +
+           lengths.capacity() * sizeof(uint32_t) + payloads.capacity() * sizeof(Payload);
 }
 
-TokenType checkTypedVariable(const std::string& word) {
-    const size_t angleBracketPos = word.find('<');
-    if (angleBracketPos != std::string::npos && word.back() == '>') {
-        const std::string type = word.substr(angleBracketPos + 1, word.size() - angleBracketPos - 2);
-        if (type == "number" || type == "string" || type == "bool") {
-            return TOK_VAR;
-        }
+void TokenBuffer::dropFront(const size_t count) {
+    if (count == 0) {
+        return;
     }
-    return TOK_UNKNOWN;
+    const uint32_t firstKept = count < size() ? offsets[count] : UINT32_MAX;
+    kinds.erase(kinds.begin(), kinds.begin() + static_cast<ptrdiff_t>(count));
+    offsets.erase(offsets.begin(), offsets.begin() + static_cast<ptrdiff_t>(count));
+    lengths.erase(lengths.begin(), lengths.begin() + static_cast<ptrdiff_t>(count));
+    const auto firstPayload = std::ranges::lower_bound(payloads, firstKept, {}, &Payload::offset);
+    payloads.erase(payloads.begin(), firstPayload);
 }
 
-std::vector<Token> tokenize(const std::string& sourceCode) {
-    std::vector<Token> tokens;
-    std::string currentWord;
-    bool insideString = false;
-    std::string currentString;
+void TokenBuffer::clear() {
+    kinds.clear();
+    offsets.clear();
+    lengths.clear();
+    payloads.clear();
+}
+
+size_t lexTokens(TokenBuffer& tokens, const size_t from, const bool final, const size_t limit) {
+    const char* const begin = tokens.source.data();
+    const size_t size = tokens.source.size();
+    size_t i = from;
 
-    for (size_t i = 0; i < sourceCode.size(); ++i) {
-        const char ch = sourceCode[i];
+    while (i < size && tokens.size() < limit) {
+        const char ch = begin[i];
+        const uint8_t cls = charClass(ch);
 
-        if (ch == '"' || ch == '\'') {
-            if (insideString) {
-                currentString += ch;
-                tokens.emplace_back(currentString, TOK_STRING, i);
-                insideString = false;
-                currentString.clear();
-            } else {
-                insideString = true;
-                currentString += ch;
+        if (cls & CHAR_SPACE) {
+            // single spaces are the common case, only hand longer runs to the vector scanner
+            ++i;
+            if (i < size && (charClass(begin[i]) & CHAR_SPACE)) {
+                i = skipWhitespace(begin, i, size);
             }
-        } else if (insideString) {
-            currentString += ch;
-        } else if (std::isspace(ch)) {
-            if (!currentWord.empty()) {
-                TokenType type = checkTypedVariable(currentWord);
-                if (type == TOK_UNKNOWN) {
-                    type = getDataType(currentWord);
-                    if (type == TOK_UNKNOWN) {
-                        type = isNumber(currentWord) ? TOK_NUMBER : getStatementType(currentWord);
-                        if (type == TOK_UNKNOWN) {
-                            type = isBoolean(currentWord) ? getBooleanType(currentWord) : TOK_IDENTIFIER;
-                        }
-                    }
-                }
-                tokens.emplace_back(currentWord, type, i);
-                currentWord.clear();
+        } else if (cls & CHAR_DIGIT) {
+            const size_t start = i;
+            bool truncated = false;
+            i = skipNumber(begin, i, size, truncated);
+            if (truncated && !final) {
+                return start;
             }
-        } else if (std::isalnum(ch) || ch == '_') {
-            currentWord += ch;
-        } else {
-            if (!currentWord.empty()) {
-                TokenType type = checkTypedVariable(currentWord);
-                if (type == TOK_UNKNOWN) {
-                    type = getDataType(currentWord);
-                    if (type == TOK_UNKNOWN) {
-                        type = isNumber(currentWord) ? TOK_NUMBER : getStatementType(currentWord);
-                        if (type == TOK_UNKNOWN) {
-                            type = isBoolean(currentWord) ? getBooleanType(currentWord) : TOK_IDENTIFIER;
-                        }
-                    }
+            pushNumber(tokens, start, i - start);
+        } else if (cls & CHAR_WORD) {
+            const size_t start = i;
+            i = skipWord(begin, i + 1, size);
+            if (i == size && !final) {
+                return start;
+            }
+            pushWord(tokens, start, i - start);
+        } else if (cls & CHAR_QUOTE) {
+            // a string runs to the next quote of either kind that is not escaped
+            const size_t start = i;
+            i = findStringEnd(begin, i + 1, size);
+            if (i == size) {
+                if (!final) {
+                    return start;
                 }
-                tokens.emplace_back(currentWord, type, i);
-                currentWord.clear();
+                // unterminated, leave it to the parser to complain
+                tokens.push(TOK_UNKNOWN, tokens.sourceBase + start, size - start);
+                break;
             }
-
-            switch (ch) {
-                case '(': tokens.emplace_back("(", TOK_OPEN_PAREN, i); break;
-                case ')': tokens.emplace_back(")", TOK_CLOSE_PAREN, i); break;
-                case '{': tokens.emplace_back("{", TOK_OPEN_BRACE, i); break;
-                case '}': tokens.emplace_back("}", TOK_CLOSE_BRACE, i); break;
-                case '[': tokens.emplace_back("[", TOK_OPEN_BRACKET, i); break;
-                case ']': tokens.emplace_back("]", TOK_CLOSE_BRACKET, i); break;
-                case ';': tokens.emplace_back(";", TOK_SEMICOLON, i); break;
-                case '.': tokens.emplace_back(".", TOK_DOT, i); break;
-                case ',': tokens.emplace_back(",", TOK_COMMA, i); break;
-                default: {
-                    std::string op(1, ch);
-                    if (i + 1 < sourceCode.size()) {
-                        const char nextChar = sourceCode[i + 1];
-                        std::string potentialOp = op + nextChar;
-                        if (getOperatorType(potentialOp) != TOK_UNKNOWN) {
-                            tokens.emplace_back(potentialOp, getOperatorType(potentialOp), i);
-                            ++i;  // skip next ^^^^^^^
-                            continue;
-                        }
-                    }
-                    tokens.emplace_back(std::string(1, ch), getOperatorType(op), i);
-                } break;
+            ++i;
+            tokens.push(TOK_STRING, tokens.sourceBase + start, i - start);
+        } else if (cls & CHAR_PUNCT) {
+            tokens.push(static_cast<TokenType>(punctTypes[static_cast<unsigned char>(ch)]), tokens.sourceBase + i, 1);
+            ++i;
+        } else if (i + 1 == size && !final) {
+            // an operator or comment start, the next chunk decides which one
+            return i;
+        } else if (ch == '/' && i + 1 < size && begin[i + 1] == '/') {
+            // line comment
+            const size_t start = i;
+            i = findNewline(begin, i + 2, size);
+            if (i == size && !final) {
+                return start;
             }
+        } else if (cls & CHAR_OPERATOR) {
+            const auto [type, length] = getOperatorType(ch, i + 1 < size ? begin[i + 1] : '\0');
+            tokens.push(type, tokens.sourceBase + i, length);
+            i += length;
+        } else {
+            tokens.push(TOK_UNKNOWN, tokens.sourceBase + i, 1);
+            ++i;
         }
     }
 
-    if (!currentWord.empty()) {
-        TokenType type = checkTypedVariable(currentWord);
-        if (type == TOK_UNKNOWN) {
-            type = getDataType(currentWord);
-            if (type == TOK_UNKNOWN) {
-                type = isNumber(currentWord) ? TOK_NUMBER : getStatementType(currentWord);
-                if (type == TOK_UNKNOWN) {
-                    type = isBoolean(currentWord) ? getBooleanType(currentWord) : TOK_IDENTIFIER;
-                }
-            }
-        }
-        tokens.emplace_back(currentWord, type, sourceCode.size());
+    return i;
+}
+
+TokenBuffer tokenize(const std::string_view sourceCode) {
+    if (sourceCode.size() > UINT32_MAX) {
+        throw std::runtime_error("Source too large: " + std::to_string(sourceCode.size()) + " bytes");
     }
 
+    TokenBuffer tokens;
+    tokens.source = sourceCode;
+    tokens.reserve(sourceCode.size() / 8 + 16);
+    lexTokens(tokens, 0, true, SIZE_MAX);
+
     // add empty token at the end
-    tokens.emplace_back("", TOK_EOF, sourceCode.size());
+    tokens.push(TOK_EOF, sourceCode.size(), 0);
     return tokens;
 }
 
@@ -249,6 +349,7 @@ std::string tokenTypeToString(const TokenType type)
         case TOK_CLOSE_BRACKET: return "TOK_CLOSE_BRACKET";
         case TOK_SEMICOLON: return "TOK_SEMICOLON";
         case TOK_DOT: return "TOK_DOT";
+        case TOK_COLON: return "TOK_COLON";
         case TOK_IDENTIFIER: return "TOK_IDENTIFIER";
         case TOK_COMMENT: return "TOK_COMMENT";
         case TOK_WHITESPACE: return "TOK_WHITESPACE";
@@ -260,6 +361,7 @@ std::string tokenTypeToString(const TokenType type)
         case TOK_WHILE_STATEMENT: return "TOK_WHILE_STATEMENT";
         case TOK_SWITCH_STATEMENT: return "TOK_SWITCH_STATEMENT";
         case TOK_CASE_STATEMENT: return "TOK_CASE_STATEMENT";
+        case TOK_DEFAULT_STATEMENT: return "TOK_DEFAULT_STATEMENT";
         case TOK_BREAK_STATEMENT: return "TOK_BREAK_STATEMENT";
         case TOK_CONTINUE_STATEMENT: return "TOK_CONTINUE_STATEMENT";
         case TOK_RETURN_STATEMENT: return "TOK_RETURN_STATEMENT";
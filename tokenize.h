@@ -1,10 +1,15 @@
 #ifndef TOKENIZE_H
 #define TOKENIZE_H
 
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <utility>
+#include <string_view>
 #include <vector>
 
+#include "interner.h"
+#include "numberpool.h"
+
 enum TokenType
 {
     // constant tokens
@@ -77,22 +82,85 @@ enum TokenType
     TOK_COMMENT,
     TOK_DOT,
     TOK_COMMA,
+    TOK_COLON,
     TOK_WHITESPACE,
     TOK_UNKNOWN,
     TOK_EOF,
 };
 
+// value is a slice of the source buffer passed to tokenize(), the caller keeps it alive
+// position is the byte offset of the first character of the token, for every kind of token
+// (SourceManager::location() turns it into a SourceLoc)
 class Token {
 public:
-    std::string value;
+    std::string_view value;
     TokenType type;
-    int position;
+    uint32_t position;
 
-    Token(std::string  val, const TokenType t, const int i) : value(std::move(val)), type(t), position(i){}
+    Token(const std::string_view val, const TokenType t, const uint32_t i) : value(val), type(t), position(i){}
 
 };
 
-std::vector<Token> tokenize(const std::string& sourceCode);
+static_assert(TOK_EOF <= UINT8_MAX, "token kinds are stored in one byte");
+
+// struct-of-arrays token stream, kinds/offsets/lengths are parallel arrays indexed by token
+class TokenBuffer {
+public:
+    // token payloads keyed by token offset, kept in a side table so the hot arrays stay small
+    // a TOK_NUMBER carries its id in numbers and a TOK_IDENTIFIER its symbol id
+    struct Payload {
+        uint32_t offset;
+        uint32_t value;
+    };
+
+    // offsets are absolute positions in the whole input, source holds the text starting at sourceBase
+    // (sourceBase is only non zero while a Lexer streams the input in chunks)
+    std::string_view source;
+    size_t sourceBase = 0;
+    std::vector<uint8_t> kinds;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<Payload> payloads; // sorted by offset, tokens are appended in source order
+    // identifiers seen so far, outlives dropFront() and clear() so ids stay stable across lexer windows
+    Interner symbols;
+    // values of the number literals seen so far, kept the same way
+    NumberPool numbers;
+
+    [[nodiscard]] size_t size() const { return kinds.size(); }
+    [[nodiscard]] bool empty() const { return kinds.empty(); }
+
+    [[nodiscard]] TokenType type(const size_t index) const { return static_cast<TokenType>(kinds[index]); }
+    [[nodiscard]] std::string_view text(const size_t index) const { return source.substr(offsets[index] - sourceBase, lengths[index]); }
+    [[nodiscard]] Token at(const size_t index) const {
+        return {text(index), type(index), offsets[index]};
+    }
+
+    [[nodiscard]] std::optional<uint32_t> payload(size_t index) const;
+
+    void push(const TokenType type, const size_t offset, const size_t length) {
+        kinds.push_back(static_cast<uint8_t>(type));
+        offsets.push_back(static_cast<uint32_t>(offset));
+        lengths.push_back(static_cast<uint32_t>(length));
+    }
+
+    void pushPayload(const size_t offset, const uint32_t value) {
+        payloads.push_back({static_cast<uint32_t>(offset), value});
+    }
+
+    void reserve(size_t count);
+    // heap memory held by the arrays, for statistics
+    [[nodiscard]] size_t bytesReserved() const;
+    // forgets the first count tokens (and their payloads), used by the streaming lexer
+    void dropFront(size_t count);
+    void clear();
+};
+
+TokenBuffer tokenize(std::string_view sourceCode);
+
+// lexes tokens.source from index `from` until it ends or tokens holds `limit` tokens, no EOF token is added
+// when final is false the text may continue in a later chunk, so a token touching the end is left alone
+// returns the index lexing stopped at
+size_t lexTokens(TokenBuffer& tokens, size_t from, bool final, size_t limit);
 std::string tokenTypeToString(TokenType type);
 
 #endif //TOKENIZE_H
@@ -0,0 +1,368 @@
+#include "typecheck.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool isNumeric(const StaticType type) {
+    return type == TYPE_INTEGER || type == TYPE_FLOAT || type == TYPE_NUMBER;
+}
+
+// smallest type covering both
+StaticType join(const StaticType a, const StaticType b) {
+    if (a == b || b == TYPE_NONE) {
+        return a;
+    }
+    if (a == TYPE_NONE) {
+        return b;
+    }
+    return isNumeric(a) && isNumeric(b) ? TYPE_NUMBER : TYPE_ANY;
+}
+
+std::string typeName(const StaticType type) {
+    switch (type) {
+    case TYPE_INTEGER: return "an integer";
+    case TYPE_FLOAT:   return "a float";
+    case TYPE_NUMBER:  return "a number";
+    case TYPE_BOOLEAN: return "a bool";
+    case TYPE_STRING:  return "a string";
+    default:           return "a value";
+    }
+}
+
+std::string declaredName(const VariableType declared) {
+    switch (declared) {
+    case VARIABLE_NUMBER:  return "number";
+    case VARIABLE_STRING:  return "string";
+    case VARIABLE_BOOLEAN: return "bool";
+    default:               return "var";
+    }
+}
+
+// false when no value of type can ever be stored in a variable declared as declared
+bool canFit(const StaticType type, const VariableType declared) {
+    return type == TYPE_ANY || fitsDeclared(type, declared);
+}
+
+// what a declared variable holds after the compiler's check let a value of type through
+StaticType narrow(const StaticType type, const VariableType declared) {
+    if (type == TYPE_NONE) {
+        return type;
+    }
+    switch (declared) {
+    case VARIABLE_NUMBER:  return isNumeric(type) ? type : TYPE_NUMBER;
+    case VARIABLE_STRING:  return TYPE_STRING;
+    case VARIABLE_BOOLEAN: return TYPE_BOOLEAN;
+    default:               return type;
+    }
+}
+
+// type of left op right, following the vm: two integers stay integers and a float on either side
+// makes it float arithmetic; an operation the vm throws on never produces a value, so any type
+// covers that case
+StaticType binaryType(const TokenType operation, const StaticType left, const StaticType right) {
+    switch (operation) {
+    case TOK_EQUAL:
+    case TOK_NOT_EQUAL:
+    case TOK_GREATER:
+    case TOK_LESS:
+    case TOK_GREATER_EQUAL:
+    case TOK_LESS_EQUAL:
+    case TOK_AND:
+    case TOK_OR:
+        return TYPE_BOOLEAN;
+    case TOK_BITWISE_AND:
+    case TOK_BITWISE_OR:
+    case TOK_BITWISE_XOR:
+    case TOK_LEFT_SHIFT:
+    case TOK_RIGHT_SHIFT:
+        return TYPE_INTEGER;
+    case TOK_ASSIGNMENT:
+        return right;
+    case TOK_ADDITION:
+    case TOK_ADDITION_ASSIGNMENT:
+    case TOK_SUBTRACTION:
+    case TOK_SUBTRACTION_ASSIGNMENT:
+    case TOK_MULTIPLICATION:
+    case TOK_MULTIPLICATION_ASSIGNMENT:
+    case TOK_DIVISION:
+    case TOK_DIVISION_ASSIGNMENT:
+    case TOK_MODULUS:
+    case TOK_MODULUS_ASSIGNMENT:
+        break;
+    default:
+        return TYPE_ANY;
+    }
+
+    if (left == TYPE_NONE || right == TYPE_NONE) {
+        return TYPE_NONE;
+    }
+    if (left == TYPE_FLOAT || right == TYPE_FLOAT) {
+        return TYPE_FLOAT;
+    }
+    if (left == TYPE_INTEGER && right == TYPE_INTEGER) {
+        return TYPE_INTEGER;
+    }
+    // + also joins two strings, everything else only makes numbers
+    const bool addition = operation == TOK_ADDITION || operation == TOK_ADDITION_ASSIGNMENT;
+    if (!addition || isNumeric(left) || isNumeric(right)) {
+        return TYPE_NUMBER;
+    }
+    return left == TYPE_STRING || right == TYPE_STRING ? TYPE_STRING : TYPE_ANY;
+}
+
+// walks the program until the types of the locals stop growing
+// a local's type only ever widens, so this ends after a few passes even for loops that feed a
+// variable back into itself; one more pass with the final types checks the declarations
+class Checker {
+private:
+    ParseResult& result;
+    // indexed by local slot, every declaration has a slot of its own
+    std::vector<StaticType> locals;
+    std::vector<VariableType> declared;
+    // indexed by global slot, a global's type is never inferred but its declaration is checked
+    std::vector<VariableType> globalsDeclared;
+    bool changed = false;
+    bool checking = false;
+
+    StaticType variable(VariableNode* variable) {
+        if (variable->scope != SCOPE_LOCAL) {
+            variable->type = TYPE_ANY;
+            if (variable->scope == SCOPE_GLOBAL) {
+                variable->declared = globalsDeclared[variable->slot];
+            }
+            return TYPE_ANY;
+        }
+        variable->type = locals[variable->slot];
+        variable->declared = declared[variable->slot];
+        return variable->type;
+    }
+
+    // a value of type is stored into target
+    void assign(ASTNode* target, const StaticType type) {
+        auto* local = target->as<VariableNode>();
+        if (local == nullptr || local->scope == SCOPE_UNRESOLVED) {
+            return;
+        }
+        const bool global = local->scope == SCOPE_GLOBAL;
+        const VariableType declaredType = global ? globalsDeclared[local->slot] : declared[local->slot];
+        if (checking && !canFit(type, declaredType)) {
+            throw std::runtime_error("Cannot assign " + typeName(type) + " to " + declaredName(declaredType) +
+                                     " variable " + std::string(local->name));
+        }
+        if (global) {
+            variable(local);
+            return;
+        }
+        StaticType& slot = locals[local->slot];
+        const StaticType joined = join(slot, narrow(type, declaredType));
+        if (joined != slot) {
+            slot = joined;
+            changed = true;
+        }
+        variable(local);
+    }
+
+    StaticType binary(BinaryOperationNode* node) {
+        const StaticType left = expression(node->left);
+        const StaticType right = expression(node->right);
+        node->type = binaryType(node->operation, left, right);
+        switch (node->operation) {
+        case TOK_ASSIGNMENT:
+        case TOK_ADDITION_ASSIGNMENT:
+        case TOK_SUBTRACTION_ASSIGNMENT:
+        case TOK_MULTIPLICATION_ASSIGNMENT:
+        case TOK_DIVISION_ASSIGNMENT:
+        case TOK_MODULUS_ASSIGNMENT:
+            assign(node->left, node->type);
+            break;
+        default:
+            break;
+        }
+        return node->type;
+    }
+
+    StaticType expression(ASTNode* node) {
+        switch (node->kind) {
+        case NODE_LITERAL:
+            return typeOf(node, result);
+        case NODE_VARIABLE:
+            return variable(static_cast<VariableNode*>(node));
+        case EXPRESSION_BINARY_OPERATION:
+            return binary(static_cast<BinaryOperationNode*>(node));
+        case EXPRESSION_MEMBER_ACCESS:
+            expression(static_cast<MemberAccessNode*>(node)->object);
+            return TYPE_ANY;
+        case EXPRESSION_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallNode*>(node);
+            expression(call->object);
+            for (ASTNode* argument : call->arguments) {
+                expression(argument);
+            }
+            return TYPE_ANY;
+        }
+        default:
+            return TYPE_ANY;
+        }
+    }
+
+    void statement(ASTNode* node) {
+        switch (node->kind) {
+        case STATEMENT_BLOCK:
+            for (ASTNode* child : static_cast<BlockStatementNode*>(node)->statements) {
+                statement(child);
+            }
+            break;
+
+        case STATEMENT_VARIABLE_DECLARATION: {
+            auto* declaration = static_cast<VariableDeclarationStatementNode*>(node);
+            const StaticType type = expression(declaration->value);
+            if (declaration->variable->scope == SCOPE_LOCAL) {
+                declared[declaration->variable->slot] = declaration->declared;
+            }
+            assign(declaration->variable, type);
+            break;
+        }
+
+        case STATEMENT_GLOBAL_DECLARATION: {
+            auto* declaration = static_cast<GlobalDeclarationStatementNode*>(node);
+            const StaticType type = expression(declaration->value);
+            if (declaration->variable->scope == SCOPE_GLOBAL) {
+                globalsDeclared[declaration->variable->slot] = declaration->declared;
+            }
+            assign(declaration->variable, type);
+            break;
+        }
+
+        case STATEMENT_ASSIGNMENT: {
+            auto* assignment = static_cast<AssignmentStatementNode*>(node);
+            const StaticType type = expression(assignment->value);
+            expression(assignment->variable);
+            assign(assignment->variable, type);
+            break;
+        }
+
+        case STATEMENT_IF: {
+            auto* statement = static_cast<IfStatementNode*>(node);
+            expression(statement->condition);
+            this->statement(statement->body);
+            for (ASTNode* item : statement->elseifBodies) {
+                auto* elseif = static_cast<ElseIfStatementNode*>(item);
+                expression(elseif->condition);
+                this->statement(elseif->body);
+            }
+            if (statement->elseBody != nullptr) {
+                this->statement(statement->elseBody);
+            }
+            break;
+        }
+
+        case STATEMENT_WHILE: {
+            auto* statement = static_cast<WhileStatementNode*>(node);
+            expression(statement->condition);
+            this->statement(statement->body);
+            break;
+        }
+
+        case STATEMENT_SWITCH: {
+            auto* statement = static_cast<SwitchStatementNode*>(node);
+            expression(statement->value);
+            for (ASTNode* item : statement->cases) {
+                this->statement(static_cast<SwitchCaseNode*>(item)->body);
+            }
+            if (statement->defaultBody != nullptr) {
+                this->statement(statement->defaultBody);
+            }
+            break;
+        }
+
+        case STATEMENT_RETURN:
+            if (ASTNode* value = static_cast<ReturnStatementNode*>(node)->expressions) {
+                expression(value);
+            }
+            break;
+
+        case STATEMENT_FUNCTION_CALL: {
+            auto* call = static_cast<FunctionCallStatementNode*>(node);
+            expression(call->object);
+            for (ASTNode* argument : call->arguments) {
+                expression(argument);
+            }
+            break;
+        }
+
+        case STATEMENT_EMPTY:
+        case STATEMENT_BREAK:
+        case STATEMENT_CONTINUE:
+            break;
+
+        default:
+            expression(node);
+            break;
+        }
+    }
+
+    void pass() {
+        for (ASTNode* node : result.statements) {
+            statement(node);
+        }
+    }
+
+public:
+    explicit Checker(ParseResult& result)
+        : result(result), locals(result.localCount, TYPE_NONE), declared(result.localCount, VARIABLE_GENERIC),
+          globalsDeclared(result.globalCount, VARIABLE_GENERIC) {}
+
+    void run() {
+        do {
+            changed = false;
+            pass();
+        } while (changed);
+        checking = true;
+        pass();
+    }
+};
+
+}
+
+bool fitsDeclared(const StaticType type, const VariableType declared) {
+    switch (declared) {
+    case VARIABLE_NUMBER:  return type == TYPE_NONE || isNumeric(type);
+    case VARIABLE_STRING:  return type == TYPE_NONE || type == TYPE_STRING;
+    case VARIABLE_BOOLEAN: return type == TYPE_NONE || type == TYPE_BOOLEAN;
+    default:               return true;
+    }
+}
+
+StaticType typeOf(const ASTNode* node, const ParseResult& result) {
+    switch (node->kind) {
+    case NODE_LITERAL: {
+        const auto* literal = static_cast<const LiteralNode*>(node);
+        switch (literal->type) {
+        case LITERAL_NUMBER:
+            return result.numbers[static_cast<const NumberNode*>(literal->value)->constant].kind == NUMBER_FLOAT ? TYPE_FLOAT : TYPE_INTEGER;
+        case LITERAL_STRING:
+            return TYPE_STRING;
+        default:
+            return TYPE_BOOLEAN;
+        }
+    }
+    case NODE_VARIABLE:
+        return static_cast<const VariableNode*>(node)->type;
+    case EXPRESSION_BINARY_OPERATION:
+        return static_cast<const BinaryOperationNode*>(node)->type;
+    default:
+        return TYPE_ANY;
+    }
+}
+
+void checkTypes(ParseResult& result) {
+    if (!result.resolved) {
+        throw std::runtime_error("Program has not been resolved");
+    }
+    Checker checker(result);
+    checker.run();
+    result.typed = true;
+}
@@ -0,0 +1,20 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "parser.h"
+
+// infers the type of every local and of every binary operation, and checks var<type> declarations
+// a local's type covers every value assigned to it anywhere in the program, loops included, so the
+// compiler can use integer, float and boolean instructions wherever the types are known
+// globals and anything the compiler cannot lower stay TYPE_ANY
+// the result must have gone through resolve(), throws when a declared variable is assigned a value
+// that can never be of its type
+void checkTypes(ParseResult& result);
+
+// type of an expression of a checked program, from the annotations checkTypes() left on its nodes
+[[nodiscard]] StaticType typeOf(const ASTNode* node, const ParseResult& result);
+
+// true when every value of type fits a variable declared as declared
+[[nodiscard]] bool fitsDeclared(StaticType type, VariableType declared);
+
+#endif //TYPECHECK_H
@@ -0,0 +1,143 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum ValueType : uint8_t {
+    VALUE_NONE,
+    VALUE_NUMBER,       // 64 bit integer
+    VALUE_FLOAT,
+    VALUE_BOOLEAN,
+    VALUE_STRING
+};
+
+// runtime value of the vm, one 64 bit word that is copied like an integer
+// a double is stored as it is, every other value is a nan with the sign and quiet bit set, a tag in
+// bits 48 to 50 and a 48 bit payload; nans produced by arithmetic are turned into the one positive
+// quiet nan so they never look like a tagged value
+// integers that fit 48 bits and strings of up to 5 bytes are stored inline, wider integers and longer
+// strings are indices into tables of the vm (the payload is wide enough for a pointer once values
+// need to point at objects)
+// integers and floats are both numbers to the language, mixing them gives a float
+class Value {
+private:
+    // inline integers take the highest tag, so every value at or above box(TAG_NUMBER, 0) is one and
+    // a 48 bit two's complement integer only needs its top 16 bits set to become its own box
+    enum Tag : uint64_t {
+        TAG_NONE = 1,
+        TAG_BOOLEAN,
+        TAG_STRING,
+        TAG_WIDE_NUMBER,
+        TAG_SHORT_STRING,
+        TAG_NUMBER = 7
+    };
+
+    static constexpr int payloadBits = 48;
+    static constexpr uint64_t payloadMask = (uint64_t{1} << payloadBits) - 1;
+    static constexpr uint64_t nanBits = 0xFFF8000000000000ull;
+    static constexpr uint64_t canonicalNan = 0x7FF8000000000000ull;
+
+    static constexpr uint64_t box(const Tag tag, const uint64_t payload) {
+        return nanBits | tag << payloadBits | (payload & payloadMask);
+    }
+
+    static constexpr Value fromBits(const uint64_t bits) {
+        Value value;
+        value.bits = bits;
+        return value;
+    }
+
+    [[nodiscard]] constexpr uint64_t header() const { return bits >> payloadBits; }
+    [[nodiscard]] constexpr uint64_t payload() const { return bits & payloadMask; }
+
+    uint64_t bits = box(TAG_NONE, 0);
+
+public:
+    // longest string fromShortString() takes, its length goes in the payload's top byte
+    static constexpr size_t shortStringSize = 5;
+
+    // true when number can be stored inline by fromNumber()
+    [[nodiscard]] static constexpr bool fitsInline(const int64_t number) {
+        return static_cast<int64_t>(static_cast<uint64_t>(number) << (64 - payloadBits)) >> (64 - payloadBits) == number;
+    }
+
+    // number must fit, see fitsInline()
+    static constexpr Value fromNumber(const int64_t number) {
+        return fromBits(static_cast<uint64_t>(number) | box(TAG_NUMBER, 0));
+    }
+
+    // an integer too wide to store inline, index is its slot in the integer table
+    static constexpr Value fromWideNumber(const uint32_t index) {
+        return fromBits(box(TAG_WIDE_NUMBER, index));
+    }
+
+    static constexpr Value fromFloat(const double real) {
+        const uint64_t bits = std::bit_cast<uint64_t>(real);
+        return fromBits(bits >= nanBits ? canonicalNan : bits);
+    }
+
+    static constexpr Value fromBoolean(const bool boolean) {
+        return fromBits(box(TAG_BOOLEAN, boolean));
+    }
+
+    // a string of more than shortStringSize bytes, string is its id in the vm's string heap
+    static constexpr Value fromString(const uint32_t string) {
+        return fromBits(box(TAG_STRING, string));
+    }
+
+    // text must not be longer than shortStringSize
+    static constexpr Value fromShortString(const std::string_view text) {
+        uint64_t payload = static_cast<uint64_t>(text.size()) << (8 * shortStringSize);
+        for (size_t i = 0; i < text.size(); ++i) {
+            payload |= static_cast<uint64_t>(static_cast<unsigned char>(text[i])) << (8 * i);
+        }
+        return fromBits(box(TAG_SHORT_STRING, payload));
+    }
+
+    [[nodiscard]] constexpr ValueType type() const {
+        if (bits < box(TAG_NONE, 0)) {
+            return VALUE_FLOAT;
+        }
+        switch (header() & 7) {
+        case TAG_NUMBER:
+        case TAG_WIDE_NUMBER: return VALUE_NUMBER;
+        case TAG_BOOLEAN:     return VALUE_BOOLEAN;
+        case TAG_STRING:
+        case TAG_SHORT_STRING: return VALUE_STRING;
+        default:              return VALUE_NONE;
+        }
+    }
+
+    // an inline integer, the common case the vm checks for first
+    [[nodiscard]] constexpr bool isNumber() const { return bits >= box(TAG_NUMBER, 0); }
+    [[nodiscard]] constexpr bool isWideNumber() const { return header() == box(TAG_WIDE_NUMBER, 0) >> payloadBits; }
+    [[nodiscard]] constexpr bool isShortString() const { return header() == box(TAG_SHORT_STRING, 0) >> payloadBits; }
+    [[nodiscard]] constexpr bool isHeapString() const { return header() == box(TAG_STRING, 0) >> payloadBits; }
+    // same bits, the same value for everything but floats (where nan is not itself and 0.0 is -0.0)
+    [[nodiscard]] constexpr bool identical(const Value& other) const { return bits == other.bits; }
+
+    // the payload of a value of that type, the caller checks the type first
+    [[nodiscard]] constexpr int64_t number() const {
+        return static_cast<int64_t>(bits << (64 - payloadBits)) >> (64 - payloadBits);
+    }
+    [[nodiscard]] constexpr uint32_t wideNumber() const { return static_cast<uint32_t>(payload()); }
+    [[nodiscard]] constexpr double real() const { return std::bit_cast<double>(bits); }
+    [[nodiscard]] constexpr bool boolean() const { return (bits & 1) != 0; }
+    [[nodiscard]] constexpr uint32_t string() const { return static_cast<uint32_t>(payload()); }
+    [[nodiscard]] constexpr size_t shortLength() const { return static_cast<size_t>(payload() >> (8 * shortStringSize)); }
+    // copies the characters of a short string to out, returns how many there are
+    constexpr size_t copyShortString(char* out) const {
+        const size_t length = shortLength();
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = static_cast<char>(bits >> (8 * i));
+        }
+        return length;
+    }
+};
+
+static_assert(sizeof(Value) == 8, "values stay one machine word");
+
+#endif //VALUE_H
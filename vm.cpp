@@ -0,0 +1,566 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+// gcc and clang can jump straight to the next handler through a label table,
+// which spreads the indirect branch over every handler instead of one switch
+#if defined(__GNUC__) && !defined(CUEL_NO_COMPUTED_GOTO)
+#define CUEL_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+bool isNumeric(const Value& value) {
+    return value.type() == VALUE_NUMBER || value.type() == VALUE_FLOAT;
+}
+
+// operand is a VariableType
+bool fitsDeclared(const Value& value, const uint32_t declared) {
+    switch (declared) {
+    case VARIABLE_NUMBER:  return isNumeric(value);
+    case VARIABLE_STRING:  return value.type() == VALUE_STRING;
+    case VARIABLE_BOOLEAN: return value.type() == VALUE_BOOLEAN;
+    default:               return true;
+    }
+}
+
+// run() lets the integer table grow to at least this many entries before collecting it
+constexpr size_t minimumIntegerLimit = 4096;
+
+// arithmetic wraps around instead of being undefined on overflow
+int64_t wrap(const uint64_t value) {
+    return static_cast<int64_t>(value);
+}
+
+}
+
+VM::VM(const ProgramView& program) : program(program) {}
+
+Value VM::boxInteger(const int64_t number) {
+    integers.push_back(number);
+    return Value::fromWideNumber(static_cast<uint32_t>(integers.size() - 1));
+}
+
+void VM::collect(Value* const top) {
+    const auto forEachRoot = [&](const auto& visit) {
+        for (Value* value = stack.data(); value != top; ++value) {
+            visit(*value);
+        }
+        for (Value& value : locals) {
+            visit(value);
+        }
+        for (Value& value : globals) {
+            visit(value);
+        }
+    };
+    if (strings.full()) {
+        strings.collect(forEachRoot);
+    }
+    if (integers.size() <= integerLimit) {
+        return;
+    }
+
+    // mark, then slide the marked entries down in order so none is overwritten before it moved
+    const size_t fixed = program.integers.size();
+    std::vector<uint32_t> moved(integers.size() - fixed, 0);
+    forEachRoot([&](const Value& value) {
+        if (value.isWideNumber() && value.wideNumber() >= fixed) {
+            moved[value.wideNumber() - fixed] = 1;
+        }
+    });
+    size_t live = fixed;
+    for (size_t i = 0; i < moved.size(); ++i) {
+        if (moved[i] != 0) {
+            integers[live] = integers[fixed + i];
+            moved[i] = static_cast<uint32_t>(live++);
+        }
+    }
+    integers.resize(live);
+    forEachRoot([&](Value& value) {
+        if (value.isWideNumber() && value.wideNumber() >= fixed) {
+            value = Value::fromWideNumber(moved[value.wideNumber() - fixed]);
+        }
+    });
+    integerLimit = std::max(2 * live, fixed + minimumIntegerLimit);
+}
+
+bool VM::caseKey(const Value& value, int64_t& key) const {
+    switch (value.type()) {
+    case VALUE_NUMBER:
+        key = integer(value);
+        return true;
+    case VALUE_FLOAT:
+        // 2.0 matches case 2 like 2.0 == 2, the range check keeps the conversion defined
+        if (value.real() >= -0x1p63 && value.real() < 0x1p63 && std::trunc(value.real()) == value.real()) {
+            key = static_cast<int64_t>(value.real());
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+int64_t VM::integerOperand(const Value& value) const {
+    if (value.type() != VALUE_NUMBER) {
+        throw std::runtime_error(value.type() == VALUE_FLOAT ? "Operand must be an integer" : "Operand must be a number");
+    }
+    return integer(value);
+}
+
+double VM::floatOperand(const Value& value) const {
+    switch (value.type()) {
+    case VALUE_NUMBER: return static_cast<double>(integer(value));
+    case VALUE_FLOAT:  return value.real();
+    default:           throw std::runtime_error("Operand must be a number");
+    }
+}
+
+bool VM::isTruthy(const Value& value) const {
+    switch (value.type()) {
+    case VALUE_NUMBER:  return integer(value) != 0;
+    case VALUE_FLOAT:   return value.real() != 0;
+    case VALUE_BOOLEAN: return value.boolean();
+    case VALUE_STRING:  return strings.length(value) != 0;
+    default:            return false;
+    }
+}
+
+bool VM::equals(const Value& a, const Value& b) {
+    if (a.type() != b.type()) {
+        // 1 == 1.0
+        return isNumeric(a) && isNumeric(b) && floatOperand(a) == floatOperand(b);
+    }
+    switch (a.type()) {
+    case VALUE_NUMBER:  return integer(a) == integer(b);
+    case VALUE_FLOAT:   return a.real() == b.real();
+    case VALUE_BOOLEAN: return a.boolean() == b.boolean();
+    case VALUE_STRING:  return strings.equal(a, b);
+    default:            return true;
+    }
+}
+
+Value VM::add(const Value& a, const Value& b) {
+    if (a.type() == VALUE_STRING && b.type() == VALUE_STRING) {
+        return strings.concat(a, b);
+    }
+    if (a.type() == VALUE_NUMBER && b.type() == VALUE_NUMBER) {
+        return makeInteger(wrap(static_cast<uint64_t>(integer(a)) + static_cast<uint64_t>(integer(b))));
+    }
+    return Value::fromFloat(floatOperand(a) + floatOperand(b));
+}
+
+std::string VM::toString(const Value& value) {
+    switch (value.type()) {
+    case VALUE_NUMBER:  return std::to_string(integer(value));
+    case VALUE_FLOAT: {
+        // shortest text that reads back as the same double, with a ".0" so 2.0 does not print like 2
+        char buffer[32];
+        const auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value.real());
+        std::string text(buffer, end);
+        if (std::isfinite(value.real()) && text.find_first_of(".e") == std::string::npos) {
+            text += ".0";
+        }
+        return text;
+    }
+    case VALUE_BOOLEAN: return value.boolean() ? "true" : "false";
+    case VALUE_STRING: {
+        char buffer[Value::shortStringSize];
+        return std::string(strings.text(value, buffer));
+    }
+    default:            return "none";
+    }
+}
+
+Value VM::run() {
+    stack.assign(program.maxStack, Value());
+    locals.assign(program.localCount, Value());
+    globals.assign(program.globalCount, Value());
+    strings.reset(program);
+    integers.assign(program.integers.begin(), program.integers.end());
+    integerLimit = integers.size() + minimumIntegerLimit;
+
+    const Instruction* const code = program.code.data();
+    const Value* const constants = program.constants.data();
+    const int64_t* const jumpTables = program.jumpTables.data();
+    const Instruction* ip = code;
+    // sp points one past the top of the stack
+    Value* sp = stack.data();
+    Value* const localSlots = locals.data();
+    Value* const globalSlots = globals.data();
+    Instruction instruction{};
+
+    // two integers stay integers, a float on either side turns both into doubles
+#define BINARY_NUMBER(integerExpression, floatExpression) do {                   \
+        --sp;                                                                    \
+        if (sp[-1].type() == VALUE_NUMBER && sp->type() == VALUE_NUMBER) {       \
+            const int64_t a = integer(sp[-1]);                                   \
+            const int64_t b = integer(*sp);                                      \
+            sp[-1] = integerExpression;                                          \
+        } else {                                                                 \
+            const double a = floatOperand(sp[-1]);                       \
+            const double b = floatOperand(*sp);                          \
+            sp[-1] = floatExpression;                                    \
+        }                                                                \
+    } while (false)
+
+#define BINARY_INTEGER(expression) do {                      \
+        const int64_t b = integerOperand(*--sp);             \
+        const int64_t a = integerOperand(sp[-1]);            \
+        sp[-1] = expression;                                 \
+    } while (false)
+
+    // operands the compiler proved to be of one type, so no tag is checked; read is how to get at
+    // the payload of either
+#define TYPED(read, result) do {                             \
+        --sp;                                                \
+        const auto a = read(sp[-1]);                         \
+        const auto b = read(*sp);                            \
+        result;                                              \
+    } while (false)
+#define INTEGER(value) integer(value)
+#define REAL(value) (value).real()
+
+#ifdef CUEL_COMPUTED_GOTO
+    // must list the handlers in OpCode order
+    static const void* const labels[] = {
+        &&L_OP_CONSTANT, &&L_OP_TRUE, &&L_OP_FALSE, &&L_OP_POP, &&L_OP_DUP,
+        &&L_OP_LOAD_LOCAL, &&L_OP_STORE_LOCAL, &&L_OP_LOAD_GLOBAL, &&L_OP_STORE_GLOBAL,
+        &&L_OP_ADD, &&L_OP_SUBTRACT, &&L_OP_MULTIPLY, &&L_OP_DIVIDE, &&L_OP_MODULUS,
+        &&L_OP_EQUAL, &&L_OP_NOT_EQUAL, &&L_OP_GREATER, &&L_OP_LESS, &&L_OP_GREATER_EQUAL, &&L_OP_LESS_EQUAL,
+        &&L_OP_BITWISE_AND, &&L_OP_BITWISE_OR, &&L_OP_BITWISE_XOR, &&L_OP_LEFT_SHIFT, &&L_OP_RIGHT_SHIFT,
+        &&L_OP_ADD_INTEGER, &&L_OP_SUBTRACT_INTEGER, &&L_OP_MULTIPLY_INTEGER, &&L_OP_DIVIDE_INTEGER, &&L_OP_MODULUS_INTEGER,
+        &&L_OP_EQUAL_INTEGER, &&L_OP_NOT_EQUAL_INTEGER, &&L_OP_GREATER_INTEGER, &&L_OP_LESS_INTEGER,
+        &&L_OP_GREATER_EQUAL_INTEGER, &&L_OP_LESS_EQUAL_INTEGER,
+        &&L_OP_ADD_FLOAT, &&L_OP_SUBTRACT_FLOAT, &&L_OP_MULTIPLY_FLOAT, &&L_OP_DIVIDE_FLOAT,
+        &&L_OP_GREATER_FLOAT, &&L_OP_LESS_FLOAT, &&L_OP_GREATER_EQUAL_FLOAT, &&L_OP_LESS_EQUAL_FLOAT,
+        &&L_OP_TO_BOOLEAN, &&L_OP_CHECK_TYPE, &&L_OP_JUMP, &&L_OP_JUMP_IF_FALSE, &&L_OP_JUMP_IF_FALSE_BOOLEAN,
+        &&L_OP_JUMP_IF_FALSE_OR_POP, &&L_OP_JUMP_IF_TRUE_OR_POP,
+        &&L_OP_SWITCH_DENSE, &&L_OP_SWITCH_SPARSE, &&L_OP_SWITCH_STRING,
+        &&L_OP_RETURN, &&L_OP_HALT,
+    };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == OP_COUNT, "every opcode needs a handler");
+
+#define TARGET(op) L_##op:
+#define DISPATCH() do { instruction = *ip++; goto *labels[instruction.op]; } while (false)
+
+    DISPATCH();
+#else
+#define TARGET(op) case op:
+#define DISPATCH() goto dispatch
+
+dispatch:
+    instruction = *ip++;
+    switch (instruction.op) {
+#endif
+
+    TARGET(OP_CONSTANT)
+        *sp++ = constants[instruction.operand];
+        DISPATCH();
+
+    TARGET(OP_TRUE)
+        *sp++ = Value::fromBoolean(true);
+        DISPATCH();
+
+    TARGET(OP_FALSE)
+        *sp++ = Value::fromBoolean(false);
+        DISPATCH();
+
+    TARGET(OP_POP)
+        --sp;
+        DISPATCH();
+
+    TARGET(OP_DUP)
+        *sp = sp[-1];
+        ++sp;
+        DISPATCH();
+
+    TARGET(OP_LOAD_LOCAL)
+        *sp++ = localSlots[instruction.operand];
+        DISPATCH();
+
+    TARGET(OP_STORE_LOCAL)
+        localSlots[instruction.operand] = *--sp;
+        DISPATCH();
+
+    TARGET(OP_LOAD_GLOBAL)
+        *sp++ = globalSlots[instruction.operand];
+        DISPATCH();
+
+    TARGET(OP_STORE_GLOBAL)
+        globalSlots[instruction.operand] = *--sp;
+        DISPATCH();
+
+    TARGET(OP_ADD)
+        if (sp[-1].isNumber() && sp[-2].isNumber()) {
+            // two inline integers never overflow 64 bits
+            --sp;
+            sp[-1] = makeInteger(sp[-1].number() + sp->number());
+        } else {
+            --sp;
+            sp[-1] = add(sp[-1], *sp);
+        }
+        DISPATCH();
+
+    TARGET(OP_SUBTRACT)
+        BINARY_NUMBER(makeInteger(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))), Value::fromFloat(a - b));
+        DISPATCH();
+
+    TARGET(OP_MULTIPLY)
+        BINARY_NUMBER(makeInteger(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))), Value::fromFloat(a * b));
+        DISPATCH();
+
+    TARGET(OP_DIVIDE)
+        BINARY_NUMBER(b == 0 ? throw std::runtime_error("Division by zero")
+                             : makeInteger(b == -1 ? wrap(0 - static_cast<uint64_t>(a)) : a / b),
+                      Value::fromFloat(a / b));
+        DISPATCH();
+
+    TARGET(OP_MODULUS)
+        BINARY_NUMBER(b == 0 ? throw std::runtime_error("Modulus by zero")
+                             : makeInteger(b == -1 ? 0 : a % b),
+                      Value::fromFloat(std::fmod(a, b)));
+        DISPATCH();
+
+    TARGET(OP_EQUAL)
+        --sp;
+        sp[-1] = Value::fromBoolean(equals(sp[-1], *sp));
+        DISPATCH();
+
+    TARGET(OP_NOT_EQUAL)
+        --sp;
+        sp[-1] = Value::fromBoolean(!equals(sp[-1], *sp));
+        DISPATCH();
+
+    TARGET(OP_GREATER)
+        BINARY_NUMBER(Value::fromBoolean(a > b), Value::fromBoolean(a > b));
+        DISPATCH();
+
+    TARGET(OP_LESS)
+        BINARY_NUMBER(Value::fromBoolean(a < b), Value::fromBoolean(a < b));
+        DISPATCH();
+
+    TARGET(OP_GREATER_EQUAL)
+        BINARY_NUMBER(Value::fromBoolean(a >= b), Value::fromBoolean(a >= b));
+        DISPATCH();
+
+    TARGET(OP_LESS_EQUAL)
+        BINARY_NUMBER(Value::fromBoolean(a <= b), Value::fromBoolean(a <= b));
+        DISPATCH();
+
+    TARGET(OP_BITWISE_AND)
+        BINARY_INTEGER(makeInteger(a & b));
+        DISPATCH();
+
+    TARGET(OP_BITWISE_OR)
+        BINARY_INTEGER(makeInteger(a | b));
+        DISPATCH();
+
+    TARGET(OP_BITWISE_XOR)
+        BINARY_INTEGER(makeInteger(a ^ b));
+        DISPATCH();
+
+    // shift counts are taken modulo 64
+    TARGET(OP_LEFT_SHIFT)
+        BINARY_INTEGER(makeInteger(wrap(static_cast<uint64_t>(a) << (b & 63))));
+        DISPATCH();
+
+    TARGET(OP_RIGHT_SHIFT)
+        BINARY_INTEGER(makeInteger(a >> (b & 63)));
+        DISPATCH();
+
+    TARGET(OP_ADD_INTEGER)
+        TYPED(INTEGER, sp[-1] = makeInteger(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b))));
+        DISPATCH();
+
+    TARGET(OP_SUBTRACT_INTEGER)
+        TYPED(INTEGER, sp[-1] = makeInteger(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b))));
+        DISPATCH();
+
+    TARGET(OP_MULTIPLY_INTEGER)
+        TYPED(INTEGER, sp[-1] = makeInteger(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b))));
+        DISPATCH();
+
+    TARGET(OP_DIVIDE_INTEGER)
+        TYPED(INTEGER, sp[-1] = makeInteger(b == 0 ? throw std::runtime_error("Division by zero")
+                                                   : b == -1 ? wrap(0 - static_cast<uint64_t>(a)) : a / b));
+        DISPATCH();
+
+    TARGET(OP_MODULUS_INTEGER)
+        TYPED(INTEGER, sp[-1] = makeInteger(b == 0 ? throw std::runtime_error("Modulus by zero") : b == -1 ? 0 : a % b));
+        DISPATCH();
+
+    TARGET(OP_EQUAL_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a == b));
+        DISPATCH();
+
+    TARGET(OP_NOT_EQUAL_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a != b));
+        DISPATCH();
+
+    TARGET(OP_GREATER_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a > b));
+        DISPATCH();
+
+    TARGET(OP_LESS_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a < b));
+        DISPATCH();
+
+    TARGET(OP_GREATER_EQUAL_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a >= b));
+        DISPATCH();
+
+    TARGET(OP_LESS_EQUAL_INTEGER)
+        TYPED(INTEGER, sp[-1] = Value::fromBoolean(a <= b));
+        DISPATCH();
+
+    TARGET(OP_ADD_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromFloat(a + b));
+        DISPATCH();
+
+    TARGET(OP_SUBTRACT_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromFloat(a - b));
+        DISPATCH();
+
+    TARGET(OP_MULTIPLY_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromFloat(a * b));
+        DISPATCH();
+
+    TARGET(OP_DIVIDE_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromFloat(a / b));
+        DISPATCH();
+
+    TARGET(OP_GREATER_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromBoolean(a > b));
+        DISPATCH();
+
+    TARGET(OP_LESS_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromBoolean(a < b));
+        DISPATCH();
+
+    TARGET(OP_GREATER_EQUAL_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromBoolean(a >= b));
+        DISPATCH();
+
+    TARGET(OP_LESS_EQUAL_FLOAT)
+        TYPED(REAL, sp[-1] = Value::fromBoolean(a <= b));
+        DISPATCH();
+
+    TARGET(OP_TO_BOOLEAN)
+        sp[-1] = Value::fromBoolean(isTruthy(sp[-1]));
+        DISPATCH();
+
+    TARGET(OP_CHECK_TYPE)
+        if (!fitsDeclared(sp[-1], instruction.operand)) {
+            throw std::runtime_error("Value does not match the declared type");
+        }
+        DISPATCH();
+
+    TARGET(OP_JUMP)
+        // every loop goes around through here, so no loop can fill the integer table or the string
+        // heap for good
+        if (integers.size() > integerLimit || strings.full()) [[unlikely]] {
+            collect(sp);
+        }
+        ip = code + instruction.operand;
+        DISPATCH();
+
+    TARGET(OP_JUMP_IF_FALSE)
+        if (!isTruthy(*--sp)) {
+            ip = code + instruction.operand;
+        }
+        DISPATCH();
+
+    TARGET(OP_JUMP_IF_FALSE_BOOLEAN)
+        if (!(--sp)->boolean()) {
+            ip = code + instruction.operand;
+        }
+        DISPATCH();
+
+    TARGET(OP_JUMP_IF_FALSE_OR_POP)
+        if (!isTruthy(sp[-1])) {
+            sp[-1] = Value::fromBoolean(false);
+            ip = code + instruction.operand;
+        } else {
+            --sp;
+        }
+        DISPATCH();
+
+    TARGET(OP_JUMP_IF_TRUE_OR_POP)
+        if (isTruthy(sp[-1])) {
+            sp[-1] = Value::fromBoolean(true);
+            ip = code + instruction.operand;
+        } else {
+            --sp;
+        }
+        DISPATCH();
+
+    // every switch goes to its default unless a label matches, a table's first entry is the default
+    TARGET(OP_SWITCH_DENSE) {
+        const int64_t* const table = jumpTables + instruction.operand;
+        int64_t key;
+        ip = code + table[0];
+        if (caseKey(*--sp, key)) {
+            const uint64_t index = static_cast<uint64_t>(key) - static_cast<uint64_t>(table[1]);
+            if (index < static_cast<uint64_t>(table[2])) {
+                ip = code + table[3 + index];
+            }
+        }
+        DISPATCH();
+    }
+
+    TARGET(OP_SWITCH_SPARSE) {
+        const int64_t* const table = jumpTables + instruction.operand;
+        int64_t key;
+        ip = code + table[0];
+        if (caseKey(*--sp, key)) {
+            const int64_t* const labels = table + 2;
+            const int64_t* const end = labels + table[1];
+            const int64_t* const found = std::lower_bound(labels, end, key);
+            if (found != end && *found == key) {
+                ip = code + found[table[1]];
+            }
+        }
+        DISPATCH();
+    }
+
+    TARGET(OP_SWITCH_STRING) {
+        const int64_t* const table = jumpTables + instruction.operand;
+        const Value value = *--sp;
+        ip = code + table[0];
+        if (value.type() == VALUE_STRING) {
+            char buffer[Value::shortStringSize];
+            const uint64_t hash = caseHash(strings.text(value, buffer));
+            const int64_t* const seeds = table + 3;
+            const uint64_t seed = static_cast<uint64_t>(seeds[(hash >> 32) & static_cast<uint64_t>(table[1])]);
+            const int64_t* const slot = seeds + table[1] + 1 + 2 * (caseSlot(hash, seed) & static_cast<uint64_t>(table[2]));
+            if (slot[0] >= 0 && strings.equal(value, constants[slot[0]])) {
+                ip = code + slot[1];
+            }
+        }
+        DISPATCH();
+    }
+
+    TARGET(OP_RETURN)
+        return *--sp;
+
+    TARGET(OP_HALT)
+        return {};
+
+#ifndef CUEL_COMPUTED_GOTO
+    default:
+        throw std::runtime_error("Unknown opcode: " + std::to_string(instruction.op));
+    }
+#endif
+
+#undef TARGET
+#undef DISPATCH
+#undef BINARY_NUMBER
+#undef BINARY_INTEGER
+#undef TYPED
+#undef INTEGER
+#undef REAL
+}
@@ -0,0 +1,62 @@
+#ifndef VM_H
+#define VM_H
+
+#include <string>
+#include <vector>
+
+#include "compiler.h"
+#include "stringheap.h"
+#include "value.h"
+
+// stack machine running a compiled Program
+class VM {
+private:
+    ProgramView program;
+    std::vector<Value> stack;
+    std::vector<Value> locals;
+    std::vector<Value> globals;
+    StringHeap strings;
+    // program integers first, integers built while running are appended; the ones nothing refers to
+    // any more are dropped by collect() once the table passes integerLimit
+    std::vector<int64_t> integers;
+    size_t integerLimit = 0;
+
+    // value of an integer, inline or wide
+    [[nodiscard]] int64_t integer(const Value& value) const {
+        return value.isNumber() ? value.number() : integers[value.wideNumber()];
+    }
+    // stores number inline when it fits and in the integer table otherwise
+    Value makeInteger(const int64_t number) {
+        if (Value::fitsInline(number)) [[likely]] {
+            return Value::fromNumber(number);
+        }
+        return boxInteger(number);
+    }
+    Value boxInteger(int64_t number);
+    // drops the wide integers and strings that neither the locals, the globals nor the stack below
+    // top refer to any more, the program's own stay where they are
+    void collect(Value* top);
+    // the integer an integer case label has to be to match value, false when no such label can
+    [[nodiscard]] bool caseKey(const Value& value, int64_t& key) const;
+    // bitwise operators and shifts only take integers
+    [[nodiscard]] int64_t integerOperand(const Value& value) const;
+    // either kind of number as a double, for arithmetic that has a float on one side
+    [[nodiscard]] double floatOperand(const Value& value) const;
+
+    [[nodiscard]] bool isTruthy(const Value& value) const;
+    [[nodiscard]] bool equals(const Value& a, const Value& b);
+    Value add(const Value& a, const Value& b);
+
+public:
+    // the program is borrowed and must outlive the vm
+    explicit VM(const ProgramView& program);
+    explicit VM(const Program& program) : VM(program.view()) {}
+
+    // runs the program from the start, returns the value of its return statement
+    // or a VALUE_NONE value when it ends without one
+    Value run();
+
+    [[nodiscard]] std::string toString(const Value& value);
+};
+
+#endif //VM_H